@@ -0,0 +1,19 @@
+﻿#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+
+// 性能基准测试（命令行 bench 子命令使用）
+class Benchmark {
+public:
+    // 在 workDir 下生成不同大小的临时文件，比较各读取策略下的哈希吞吐量
+    static bool RunHashBenchmark(const std::string& workDir,const std::string& algorithm);
+
+    // 在内存中构造整体重命名的新旧快照（最大 maxRenames 个文件），测量差异计算与移动检测耗时
+    static bool RunMoveBenchmark(size_t maxRenames);
+
+    // 对典型修改（覆盖、插入、删除、追加、块重排）生成差分补丁并回放，校验结果摘要与新内容一致
+    static bool RunPatchBenchmark(const std::string& algorithm);
+};
+
+#endif
@@ -0,0 +1,42 @@
+﻿#ifndef CHUNKSTORE_H
+#define CHUNKSTORE_H
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include "Digest.h"
+#include "Chunker.h"
+#include "ObjectStore.h"
+
+struct ChunkRef {
+    Digest hash;
+    uint32_t size = 0;
+};
+
+// 大文件的分块存储：
+//   <root>/data   分块内容，按分块摘要保存（与 ObjectStore 相同的布局）
+//   <root>/lists  分块列表，按整个文件的摘要保存，每行 HASH:SIZE，按文件中的顺序排列
+// 分块摘要使用文件摘要的算法。同一内容的分块列表是确定的，只需计算一次
+class ChunkStore {
+public:
+    explicit ChunkStore(const std::string& rootDir,const ChunkerParams& params=ChunkerParams());
+
+    std::string GetChunkPath(const Digest& digest) const { return chunks.GetObjectPath(digest); }
+    bool ContainsChunk(const Digest& digest) const { return chunks.Contains(digest); }
+    bool HasChunkList(const Digest& fileDigest) const { return lists.Contains(fileDigest); }
+
+    // 切分文件内容，存入尚未保存的分块并写出分块列表
+    bool AddFile(const Digest& fileDigest,const unsigned char* data,size_t size,ObjectStoreStats* stats=nullptr);
+    bool LoadChunkList(const Digest& fileDigest,std::vector<ChunkRef>& result) const;
+
+    // 删除不属于 liveFiles 的分块列表，以及不再被任何列表引用的分块，返回删除的分块数
+    size_t RemoveUnreferenced(const std::unordered_set<Digest,DigestHash>& liveFiles);
+
+private:
+    Chunker chunker;
+    ObjectStore chunks;
+    // 以文件摘要为键（不是列表内容的摘要）
+    ObjectStore lists;
+};
+
+#endif
@@ -0,0 +1,39 @@
+﻿#ifndef CHUNKER_H
+#define CHUNKER_H
+
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// 分块大小参数，平均大小必须是 2 的幂
+struct ChunkerParams {
+    size_t minSize = 16*1024;
+    size_t averageSize = 64*1024;
+    size_t maxSize = 256*1024;
+};
+
+// FastCDC 内容定义分块：Gear 滚动哈希 + 归一化分块（平均大小之前用更严格的掩码，之后用更宽松的掩码），
+// 切点只取决于附近的内容，文件中间插入/删除数据只影响局部的分块。
+// 相同参数下结果在所有平台上一致，分块列表可以持久化并与客户端共享
+class Chunker {
+public:
+    using ChunkCallback=std::function<void(size_t offset,size_t length)>;
+
+    explicit Chunker(const ChunkerParams& params=ChunkerParams());
+
+    // 返回从 data 开始的第一个分块长度，size 为剩余数据长度
+    size_t NextChunk(const unsigned char* data,size_t size) const;
+    // 把整段数据切分为连续的分块
+    void Split(const unsigned char* data,size_t size,const ChunkCallback& callback) const;
+
+    const ChunkerParams& GetParams() const { return params; }
+
+private:
+    ChunkerParams params;
+    uint64_t strictMask;   // 平均大小之前使用，切点更少
+    uint64_t looseMask;    // 平均大小之后使用，尽快切分
+
+    static const uint64_t* GearTable();
+};
+
+#endif
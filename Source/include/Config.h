@@ -29,12 +29,24 @@ public:
     int GetMaxPackageVersions() const { return maxPackageVersions; }
     std::string GetLogFile() const { return logFile; }
     std::string GetLanguage() const { return language; }
+    int GetScanThreads() const { return scanThreads; }
+    bool GetForceRehash() const { return forceRehash; }
+    std::string GetIoStrategy() const { return ioStrategy; }
+    int GetHashBufferKb() const { return hashBufferKb; }
+    int GetMmapThresholdMb() const { return mmapThresholdMb; }
+    bool GetDropPageCache() const { return dropPageCache; }
+    bool GetWatchWorkspace() const { return watchWorkspace; }
+    bool GetDeltaPatches() const { return deltaPatches; }
+    int GetMaxFullPackages() const { return maxFullPackages; }
+    int GetChunkThresholdMb() const { return chunkThresholdMb; }
+    bool GetPrecompress() const { return precompress; }
 
     // 设置配置值
     void SetOutputDir(const std::string& dir) { outputDir=dir; }
     void SetServerHost(const std::string& host) { serverHost=host; }
     void SetServerPort(int port) { serverPort=port; }
     void SetBaseUrl(const std::string& url) { baseUrl=url; }
+    void SetForceRehash(bool rehash) { forceRehash=rehash; }
 
     // 获取默认配置
     static Json::Value GetDefaultConfig();
@@ -48,12 +60,25 @@ private:
     std::string serverHost="127.0.0.1";
     int serverPort=8080;
     std::string baseUrl="http://127.0.0.1:8080";
+    // md5/sha1/sha256/blake3/xxh3-128。blake3 比 sha256 快数倍且仍可用作客户端校验；
+    // xxh3-128 只适合变更检测，客户端需要防篡改校验时不要使用
     std::string hashAlgorithm="sha256";
     bool enableWebServer=true;
     bool enableIncremental=true;
     int maxPackageVersions=10;
     std::string logFile="./logs/server.log";
     std::string language="zh_CN";
+    int scanThreads=0;  // 0 表示按 CPU 核心数自动决定
+    bool forceRehash=false;  // 仅命令行 --rehash 设置，不写入配置文件
+    std::string ioStrategy="auto";  // auto/stream/buffered/mmap
+    int hashBufferKb=1024;
+    int mmapThresholdMb=64;
+    bool dropPageCache=true;
+    bool watchWorkspace=true;  // serve/daemon 下监视工作空间，生成版本时只重扫变更部分
+    bool deltaPatches=true;  // 另外生成以差分补丁代替修改文件的 *.patch.zip（update 信息中的 patch_archive），普通增量包不受影响
+    int maxFullPackages=0;  // 只保留最新几个版本的全量包，历史内容在对象库中；0 表示全部保留（默认，需要时再开启清理）
+    int chunkThresholdMb=8;  // 不小于该大小的文件额外按内容分块发布，客户端可只下载变化的分块；0 表示关闭
+    bool precompress=true;  // 发布时为可压缩的文件生成 .br/.zst/.gz，/files/ 按 Accept-Encoding 返回
 
     Json::Value jsonConfig;
 };
@@ -0,0 +1,27 @@
+﻿#ifndef DELTAPATCH_H
+#define DELTAPATCH_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// 二进制差分补丁。格式：
+//   "MCUDELTA" + 格式版本(1 字节) + varint 旧文件大小 + varint 新文件大小，
+//   之后是指令序列：0x01 COPY(varint 旧文件偏移, varint 长度)、0x02 ADD(varint 长度 + 原始字节)，0x00 结束。
+// 补丁本身不压缩，放进 ZIP 时由 deflate 处理 ADD 中的字面数据
+class DeltaPatch {
+public:
+    // 生成从旧内容到新内容的补丁。补丁不比新内容小（不值得）时返回 false
+    static bool Create(const unsigned char* oldData,size_t oldSize,
+        const unsigned char* newData,size_t newSize,std::string& patch);
+
+    // 应用补丁。旧内容大小不符、补丁损坏或越界时返回 false
+    static bool Apply(const unsigned char* oldData,size_t oldSize,
+        const std::string& patch,std::string& output);
+
+private:
+    // 旧内容建索引时使用的块大小，按文件大小放大以限制索引条目数
+    static size_t BlockSizeFor(size_t oldSize);
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <functional>
 #include <json/json.h>
 #include "FileScanner.h"
 
@@ -20,7 +21,9 @@ struct ChangeRecord {
     ChangeType type = ChangeType::ADDED;
     std::string path;
     std::string oldPath;  // 用于移动操作
-    std::string hash;
+    Digest hash;
+    // MODIFIED 以及内容同时被修改的 MOVED（按相似度配对）记录原文件的摘要，可据此生成差分补丁；其余为空
+    Digest oldHash;
 	//FIXME: 这里的 size 可能会有问题，他没意义
     uint64_t size = 0;
 	//FIXME: 潜在风险,其他类型误设 oldPath 也可能被输出。
@@ -40,7 +43,10 @@ struct ChangeRecord {
         if(!oldPath.empty()) {
             json["old_path"]=oldPath;
         }
-        json["hash"]=hash;
+        json["hash"]=hash.ToHex();
+        if(!oldHash.Empty()) {
+            json["old_hash"]=oldHash.ToHex();
+        }
         json["size"]=static_cast<Json::Int64>(size);
 
         return json;
@@ -48,14 +54,21 @@ struct ChangeRecord {
 };
 class DiffEngine {
 public:
+    // 按摘要返回内容所在的本地文件路径，找不到时返回空字符串
+    using ContentResolver=std::function<std::string(const Digest&)>;
+
     DiffEngine()=default;
 
+    // 提供后，移动+修改的相似度判断会额外比较内容分块的重合度；新旧内容都能找到时才会使用
+    void SetContentResolver(ContentResolver resolver) { contentResolver=std::move(resolver); }
+
+    // 关闭后不再逐条输出变更日志（基准测试、超大变更集时使用）
+    void SetVerbose(bool enable) { verbose=enable; }
+
     // 计算差异
     std::vector<ChangeRecord> CalculateDiff(
-        const std::vector<FileInfo>& oldFiles,
-        const std::vector<FileInfo>& newFiles,
-        const std::vector<DirectoryInfo>& oldDirs,
-        const std::vector<DirectoryInfo>& newDirs);
+        const Snapshot& oldSnapshot,
+        const Snapshot& newSnapshot);
 
     // 生成更新清单
     static std::string GenerateManifest(const std::vector<ChangeRecord>& changes);
@@ -64,15 +77,13 @@ public:
     static std::vector<ChangeRecord> ParseManifest(const std::string& manifest);
 
 private:
-    // 检测文件移动
-    void DetectFileMovements(
-        const std::vector<FileInfo>& oldFiles,
-        const std::vector<FileInfo>& newFiles,
-        std::vector<ChangeRecord>& changes);
+    bool verbose=true;
+    ContentResolver contentResolver;
 
-    // 构建哈希映射
-    std::unordered_map<std::string,std::vector<const FileInfo*>>
-        BuildHashMap(const std::vector<FileInfo>& files);
+    // 检测文件移动：把摘要相同的 DELETED/ADDED 记录合并为 MOVED
+    void DetectFileMovements(std::vector<ChangeRecord>& changes);
+    // 检测移动并修改的文件：按文件名、大小和内容分块重合度为剩余的 DELETED/ADDED 配对
+    void DetectSimilarMovements(std::vector<ChangeRecord>& changes);
 };
 
 #endif
\ No newline at end of file
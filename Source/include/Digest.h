@@ -0,0 +1,62 @@
+﻿#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <array>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// 支持的哈希算法。数值会写入快照，只能追加不能调整顺序
+enum class HashAlgorithm : uint8_t {
+    Unknown=0,
+    MD5=1,
+    SHA1=2,
+    SHA256=3,
+    BLAKE3=4,      // 快速的密码学哈希，可作为客户端校验哈希
+    XXH3_128=5     // 非密码学哈希，仅适合变更检测
+};
+
+// 定长二进制摘要 + 算法标记。
+// 内存中一律使用二进制形式，只在 JSON/HTTP/清单等边界处编码为十六进制。
+struct Digest {
+    static const size_t kMaxLength=32;
+
+    std::array<uint8_t,kMaxLength> bytes{};
+    HashAlgorithm algorithm = HashAlgorithm::Unknown;
+    uint8_t length = 0;
+
+    bool Empty() const { return length==0; }
+
+    std::string ToHex() const;
+
+    // 非法的十六进制串返回空摘要
+    static Digest FromHex(const std::string& hex,HashAlgorithm algorithm);
+    static Digest FromBytes(const uint8_t* data,size_t size,HashAlgorithm algorithm);
+
+    bool operator==(const Digest& other) const {
+        return algorithm==other.algorithm&&length==other.length&&
+            std::memcmp(bytes.data(),other.bytes.data(),length)==0;
+    }
+
+    bool operator!=(const Digest& other) const {
+        return !(*this==other);
+    }
+
+    bool operator<(const Digest& other) const {
+        if(algorithm!=other.algorithm) return algorithm<other.algorithm;
+        if(length!=other.length) return length<other.length;
+        return std::memcmp(bytes.data(),other.bytes.data(),length)<0;
+    }
+};
+
+// 摘要本身已经是均匀分布的，直接取前 8 字节作为哈希值
+struct DigestHash {
+    size_t operator()(const Digest& digest) const {
+        uint64_t value=0;
+        std::memcpy(&value,digest.bytes.data(),sizeof(value));
+        return static_cast<size_t>(value^static_cast<uint64_t>(digest.algorithm));
+    }
+};
+
+#endif
@@ -0,0 +1,66 @@
+﻿#ifndef FILEREADER_H
+#define FILEREADER_H
+
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// 文件读取策略
+enum class ReadStrategy {
+    Auto,       // 按文件大小自动选择
+    Stream,     // fopen/fread，旧实现
+    Buffered,   // 大缓冲区 pread/ReadFile
+    Mmap        // 内存映射 + 顺序预读提示
+};
+
+struct ReadOptions {
+    ReadStrategy strategy = ReadStrategy::Auto;
+    size_t bufferSize = 1024*1024;               // Stream/Buffered 的缓冲区大小
+    uint64_t mmapThreshold = 64ull*1024*1024;    // Auto 模式下不小于该大小的文件使用 mmap
+    bool dropCache = true;                       // 读完后提示内核丢弃页缓存，避免挤掉 Web 服务的热数据
+};
+
+class FileReader {
+public:
+    using ChunkConsumer=std::function<void(const unsigned char* data,size_t length)>;
+
+    // 按块读取整个文件，任何打开/读取错误都返回 false（不会把部分内容当作完整内容）
+    static bool Read(const std::string& filePath,const ReadOptions& options,const ChunkConsumer& consumer);
+
+    static ReadStrategy ParseStrategy(const std::string& name);
+    static const char* StrategyName(ReadStrategy strategy);
+
+private:
+    static bool ReadStream(const std::string& filePath,const ReadOptions& options,const ChunkConsumer& consumer);
+    static bool ReadBuffered(const std::string& filePath,const ReadOptions& options,const ChunkConsumer& consumer);
+    static bool ReadMapped(const std::string& filePath,const ReadOptions& options,const ChunkConsumer& consumer);
+};
+
+// 整个文件的只读内存映射，映射期间内容可直接当作只读内存使用（二进制快照等）
+class MappedFile {
+public:
+    MappedFile()=default;
+    ~MappedFile() { Close(); }
+    MappedFile(const MappedFile&)=delete;
+    MappedFile& operator=(const MappedFile&)=delete;
+
+    // 空文件也视为打开成功，此时 GetData() 为空指针
+    bool Open(const std::string& filePath);
+    void Close();
+
+    bool IsOpen() const { return opened; }
+    const unsigned char* GetData() const { return data; }
+    size_t GetSize() const { return size; }
+
+private:
+    bool opened=false;
+    const unsigned char* data=nullptr;
+    size_t size=0;
+#ifdef _WIN32
+    void* fileHandle=nullptr;
+    void* mappingHandle=nullptr;
+#endif
+};
+
+#endif
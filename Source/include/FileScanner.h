@@ -5,67 +5,43 @@
 #include <vector>
 #include <unordered_map>
 #include <filesystem>
+#include <memory>
 #include <json/json.h>
+#include "FileReader.h"
+#include "HashProvider.h"
+#include "Snapshot.h"
 
-struct FileInfo {
-    std::string path;
-    std::string hash;
-    uint64_t size = 0;
-    bool isDirectory = false;
-    std::time_t modifiedTime = 0;
-
-    // 用于比较
-	//FIXEME: 简化的实现，以后可能需要改
-    bool operator==(const FileInfo& other) const {
-        return path==other.path&&hash==other.hash;
-    }
-
-    Json::Value ToJson() const {
-        Json::Value json;
-        json["path"]=path;
-        json["hash"]=hash;
-        json["size"]=static_cast<Json::Int64>(size);
-        json["is_directory"]=isDirectory;
-        json["modified_time"]=static_cast<Json::Int64>(modifiedTime);
-        return json;
-    }
-};
-//OPTIMIZE:FileScannercpp好像也维护了这个东西（files），会浪费内存
-struct DirectoryInfo {
-    std::string path;
-    std::vector<FileInfo> files;
-    std::vector<std::string> subdirectories;
-
-    Json::Value ToJson() const {
-        Json::Value json;
-        json["path"]=path;
-
-        Json::Value filesJson(Json::arrayValue);
-        for(const auto& file:files) {
-            filesJson.append(file.ToJson());
-        }
-        json["files"]=filesJson;
-
-        Json::Value dirsJson(Json::arrayValue);
-        for(const auto& dir:subdirectories) {
-            dirsJson.append(dir);
-        }
-        json["subdirectories"]=dirsJson;
-
-        return json;
-    }
-};
+class HashPipeline;
+class HashCache;
 
 class FileScanner {
 public:
-    FileScanner(const std::string& workspace,const std::string& hashAlgorithm="sha256");
+    // threadCount 为哈希工作线程数，0 表示按 CPU 核心数自动决定，1 表示在扫描线程内同步计算
+    FileScanner(const std::string& workspace,const std::string& hashAlgorithm="sha256",int threadCount=0);
+    ~FileScanner();
 
     bool Scan();
-    const std::vector<FileInfo>& GetFiles() const { return files; }
-    const std::vector<DirectoryInfo>& GetDirectories() const { return directories; }
-
-    // 计算文件哈希
-    static std::string CalculateFileHash(const std::string& filePath,const std::string& algorithm);
+    // 增量扫描：以上一次扫描结果为基础，只重新扫描 dirtyPaths（相对路径，文件或目录，
+    // 目录表示整棵子树；不存在的路径视为已删除）。尚未完整扫描过时退化为 Scan()
+    bool ScanIncremental(const std::vector<std::string>& dirtyPaths);
+    bool HasScanned() const { return hasScanned; }
+    // 设置哈希缓存（不接管所有权），为空时每个文件都重新计算
+    void SetHashCache(HashCache* cache) { hashCache=cache; }
+    // 设置哈希时的文件读取策略（mmap/大缓冲区等）
+    void SetReadOptions(const ReadOptions& options) { readOptions=options; }
+    // 与版本列表、历史快照共用路径表，使路径编号可以直接比较
+    void SetPathTable(std::shared_ptr<PathTable> paths) { snapshot=Snapshot(std::move(paths)); }
+    // 扫描结果，调用方以引用方式使用，不要复制
+    const Snapshot& GetSnapshot() const { return snapshot; }
+    const std::vector<FileInfo>& GetFiles() const { return snapshot.GetFiles(); }
+    const std::vector<DirectoryInfo>& GetDirectories() const { return snapshot.GetDirectories(); }
+
+    // 计算文件哈希（十六进制，供包校验等边界场景使用）
+    static std::string CalculateFileHash(const std::string& filePath,const std::string& algorithm,
+        const ReadOptions& options=ReadOptions());
+    // 计算文件二进制摘要，失败返回空摘要
+    static Digest CalculateFileDigest(const std::string& filePath,HashAlgorithm algorithm,
+        const ReadOptions& options=ReadOptions());
 
     // 从JSON加载文件列表
     bool LoadFromJson(const Json::Value& json);
@@ -76,10 +52,29 @@ public:
 private:
     std::string workspace;
     std::string hashAlgorithm;
-    std::vector<FileInfo> files;
-    std::vector<DirectoryInfo> directories;
-
-    void ScanDirectory(const std::filesystem::path& currentPath,const std::string& relativePath="");
+    int threadCount;
+    HashAlgorithm hashAlgorithmId;
+    ReadOptions readOptions;
+    Snapshot snapshot;
+
+    // 扫描期间使用：目录遍历只负责把哈希任务投递到有界队列，由工作线程计算
+    std::unique_ptr<HashPipeline> hashPipeline;
+    HashCache* hashCache=nullptr;
+    // 与快照文件追加顺序一一对应的 inode，仅在扫描期间（Finalize 之前）用于回写哈希缓存。
+    // 增量扫描中原样沿用的文件记为 kCarriedOver，只保留旧缓存条目
+    std::vector<uint64_t> fileInodes;
+    static constexpr uint64_t kCarriedOver=UINT64_MAX;
+
+    // 完整扫描成功后为 true，增量扫描以此为前提
+    bool hasScanned=false;
+
+    bool RunScan(const std::vector<std::string>* dirtyPaths);
+    void RescanDirtyPaths(const std::vector<std::string>& dirtyPaths);
+    void ScanDirectory(const std::filesystem::path& currentPath,const std::string& relativePath="",
+        PathId directoryId=kRootPath);
+    void ScanFile(const std::filesystem::directory_entry& entry,const std::string& fullPath,
+        const std::string& relativePath,PathId fileId);
+    void UpdateHashCache();
     std::string NormalizePath(const std::string& path) const;
 };
 
@@ -0,0 +1,51 @@
+﻿#ifndef HASHCACHE_H
+#define HASHCACHE_H
+
+#include <string>
+#include <unordered_map>
+#include <ctime>
+#include <cstdint>
+#include "Digest.h"
+
+// 持久化的文件哈希缓存：以 相对路径 + 大小 + 修改时间 + inode 为键，
+// 命中时 FileScanner 直接复用上次的哈希，不再读取文件内容。
+struct HashCacheEntry {
+    uint64_t size = 0;
+    std::time_t modifiedTime = 0;
+    uint64_t inode = 0;
+    Digest hash;
+};
+
+class HashCache {
+public:
+    HashCache(const std::string& cacheFile,HashAlgorithm algorithm);
+
+    // 加载缓存文件，算法不一致时视为空缓存
+    bool Load();
+    // 只写回本次扫描中出现过的条目，已删除的文件自然被清理
+    bool Save();
+
+    // 每轮扫描开始时调用：重置命中统计和"近期修改"判定的基准时间（守护模式下缓存对象长期存在）
+    void BeginScan();
+
+    bool Lookup(const std::string& relativePath,uint64_t size,std::time_t modifiedTime,
+        uint64_t inode,Digest& hash);
+    void Store(const std::string& relativePath,uint64_t size,std::time_t modifiedTime,
+        uint64_t inode,const Digest& hash);
+    // 增量扫描时未重新检查的文件：原样保留上次的缓存条目
+    void Keep(const std::string& relativePath);
+
+    size_t GetHits() const { return hits; }
+    size_t GetMisses() const { return misses; }
+
+private:
+    std::string cacheFile;
+    HashAlgorithm algorithm;
+    std::time_t createdAt;
+    std::unordered_map<std::string,HashCacheEntry> entries;
+    std::unordered_map<std::string,HashCacheEntry> nextEntries;
+    size_t hits=0;
+    size_t misses=0;
+};
+
+#endif
@@ -0,0 +1,40 @@
+﻿#ifndef HASHPROVIDER_H
+#define HASHPROVIDER_H
+
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "Digest.h"
+
+// 增量哈希计算接口，FileScanner/PackageBuilder 等通过它屏蔽具体算法
+class HashProvider {
+public:
+    static const size_t kMaxDigestLength=Digest::kMaxLength;
+
+    virtual ~HashProvider()=default;
+
+    virtual void Update(const unsigned char* data,size_t length)=0;
+    // 写出二进制摘要，digest 至少需要 GetDigestLength() 字节
+    virtual void Final(unsigned char* digest)=0;
+    virtual size_t GetDigestLength() const=0;
+    virtual HashAlgorithm GetAlgorithm() const=0;
+
+    // 结束计算并返回带算法标记的摘要
+    Digest Finish() {
+        Digest digest;
+        Final(digest.bytes.data());
+        digest.length=static_cast<uint8_t>(GetDigestLength());
+        digest.algorithm=GetAlgorithm();
+        return digest;
+    }
+
+    // 未知算法返回空指针
+    static std::unique_ptr<HashProvider> Create(HashAlgorithm algorithm);
+
+    static HashAlgorithm ParseAlgorithm(const std::string& name);
+    static const char* AlgorithmName(HashAlgorithm algorithm);
+    static size_t DigestLength(HashAlgorithm algorithm);
+};
+
+#endif
@@ -0,0 +1,62 @@
+﻿#ifndef OBJECTSTORE_H
+#define OBJECTSTORE_H
+
+#include <string>
+#include <unordered_set>
+#include <functional>
+#include <filesystem>
+#include <cstdint>
+#include "Digest.h"
+#include "Snapshot.h"
+#include "FileReader.h"
+
+struct ObjectStoreStats {
+    size_t stored=0;        // 本次新写入的对象数
+    size_t reused=0;        // 已存在、直接复用的对象数
+    uint64_t storedBytes=0;
+};
+
+// 内容寻址的对象库：每份内容按摘要只保存一次，位于 <root>/<算法>/<前两位>/<其余十六进制>。
+// 所有版本共享对象，/files/ 据此返回任意已发布版本的内容，不必为每个版本保留一份工作空间。
+// 注意只有对象库本身是去重的：全量包、增量包和目录包仍是自包含的 ZIP，
+// 大文件的分块（chunks/）也另存一份，总占用是对象库加上这些包，而不是去重后的内容总量。
+// 对象写入后不再修改，可以被多个线程同时读取
+class ObjectStore {
+public:
+    explicit ObjectStore(const std::string& rootDir);
+
+    const std::string& GetRoot() const { return rootDir; }
+    std::string GetObjectPath(const Digest& digest) const;
+    bool Contains(const Digest& digest) const;
+
+    // 把文件内容存为对象，已存在时直接返回 true。
+    // 复制时重新计算摘要，与 digest 不符（扫描后文件又被修改）时放弃并返回 false
+    bool Put(const Digest& digest,const std::string& sourcePath,const ReadOptions& options,bool* stored=nullptr);
+    // 以 digest 为键保存内存中的数据，不做校验（调用方已计算过摘要）
+    bool PutData(const Digest& digest,const void* data,size_t size,bool* stored=nullptr);
+
+    // 对象的变体（如预压缩的 .br/.gz）与对象放在一起，路径为对象路径加后缀，随对象一起被清理
+    std::string GetVariantPath(const Digest& digest,const std::string& suffix) const;
+    bool HasVariant(const Digest& digest,const std::string& suffix) const;
+    bool PutVariant(const Digest& digest,const std::string& suffix,const void* data,size_t size);
+
+    // 存入快照中的全部文件（内容取自工作空间），任一文件失败都返回 false
+    bool PutSnapshot(const Snapshot& snapshot,const std::string& workspace,
+        const ReadOptions& options,ObjectStoreStats* stats=nullptr);
+
+    // 遍历所有对象及其变体（变体传入所属对象的摘要）；无法解析为摘要的文件传入空摘要
+    void ForEachObject(const std::function<void(const Digest& digest,const std::filesystem::path& path)>& callback) const;
+
+    // 删除不在 liveDigests 中的对象，返回删除的数量
+    size_t RemoveUnreferenced(const std::unordered_set<Digest,DigestHash>& liveDigests);
+
+private:
+    std::string rootDir;
+
+    // 临时文件名按线程和时间区分，并发写入同一对象时不会互相覆盖
+    static std::string TempPathFor(const std::string& objectPath);
+    // 写临时文件后改名，读者不会看到写了一半的内容
+    static bool WriteFileAtomically(const std::string& path,const void* data,size_t size);
+};
+
+#endif
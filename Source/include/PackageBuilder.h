@@ -6,12 +6,28 @@
 #include <zip.h>
 #include <json/json.h>
 #include "DiffEngine.h"
+#include "ObjectStore.h"
+#include "PackageIndex.h"
 
 class PackageBuilder {
 public:
+    // 补丁格式的增量包与普通增量包并存：<from>_to_<to>.patch.zip，普通包始终打包完整文件
+    static constexpr const char* kPatchPackageSuffix=".patch.zip";
+
     PackageBuilder()=default;
     ~PackageBuilder()=default;
 
+    // 指定对象库后，包内文件内容按摘要从对象库读取（即版本发布时的内容），对象不存在时才读工作空间
+    void SetObjectStore(const ObjectStore* store) { objectStore=store; }
+    // 开启后，增量包中内容有变化的 MODIFIED/MOVED 文件会尝试改为差分补丁（旧内容取自对象库），
+    // 补丁不比完整文件小或旧内容不在对象库中时仍打包完整文件
+    void SetDeltaPatches(bool enable) { deltaPatches=enable; }
+
+    // 最近一次成功创建的增量包/全量包的摘要和大小；摘要计算失败时 hash 为空
+    const PackageRecord& GetLastPackage() const { return lastPackage; }
+    // 最近一次创建的增量包中以补丁代替完整文件的数量
+    size_t GetLastPatchCount() const { return lastPatchCount; }
+
     // 创建增量更新包
     bool CreateIncrementalPackage(
         const std::string& oldVersion,
@@ -23,16 +39,14 @@ public:
     // 创建全量更新包
     bool CreateFullPackage(
         const std::string& version,
-        const std::vector<FileInfo>& files,
-        const std::vector<DirectoryInfo>& dirs,
+        const Snapshot& snapshot,
         const std::string& workspace,
         const std::string& outputPath);
 
     // 创建目录包（仅包含直接文件和空子目录条目）
     bool CreateDirectoryPackage(
         const std::string& rootDir,
-        const std::vector<DirectoryInfo>& allDirs,
-        const std::vector<FileInfo>& allFiles,
+        const Snapshot& snapshot,
         const std::string& workspace,
         const std::string& outputPath);
 
@@ -40,6 +54,17 @@ public:
     static bool AddManifestToZip(zip_t* zip,const std::string& manifest);
 
 private:
+    const ObjectStore* objectStore=nullptr;
+    bool deltaPatches=false;
+    PackageRecord lastPackage;
+    size_t lastPatchCount=0;
+
+    // zip_close 写完包后立即计算摘要，此时包内容仍在页缓存中，不需要再从磁盘读取
+    void RecordPackage(const std::string& outputPath);
+
+    // 文件内容的实际位置：对象库中有该摘要时使用对象，否则使用工作空间中的文件
+    std::string ContentPath(const std::string& workspace,const std::string& relativePath,const Digest& hash) const;
+
     // 添加文件到ZIP
     bool AddFileToZip(zip_t* zip,const std::string& filePath,const std::string& zipPath);
 
@@ -54,7 +79,14 @@ private:
         */
 
     bool AddEmptyDirectoryMarker(zip_t* zip,const std::string& dirPath);
-    bool AddDirectoryRecursively(zip_t* zip,const std::string& physicalPath,const std::string& zipPath);
+
+    // 尝试以补丁形式添加变更文件，成功时把补丁条目追加到 patchList。
+    // 返回 false 只表示不适合打补丁，调用方应改为添加完整文件
+    bool AddPatchToZip(zip_t* zip,const ChangeRecord& change,
+        const std::string& filePath,std::string& patchList,uint64_t& savedBytes);
+    static bool AddPatchListToZip(zip_t* zip,const std::string& patchList);
+    // 按快照递归添加目录（目录条目和其中的文件）
+    bool AddSnapshotDirectory(zip_t* zip,const Snapshot& snapshot,const DirectoryInfo& dir,const std::string& workspace);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+﻿#ifndef PACKAGEINDEX_H
+#define PACKAGEINDEX_H
+
+#include <string>
+#include <map>
+#include <ctime>
+#include <cstdint>
+
+// 打包时记录的包信息，WebServer 直接使用，不再在请求时读取整个压缩包计算哈希
+struct PackageRecord {
+    std::string hash;                   // 十六进制摘要
+    std::string hashAlgorithm="md5";    // 与 update 信息中的 hash 字段一致，客户端按它校验下载
+    uint64_t size=0;
+    std::time_t buildTime=0;
+};
+
+// 包索引，保存在 versions.json 旁的 packages.json 中。
+// 键为相对输出目录的路径，如 "full/1.0.0.zip"、"incremental/1.0.0_to_1.0.1.zip"
+class PackageIndex {
+public:
+    explicit PackageIndex(const std::string& dataDir);
+
+    // 索引文件不存在时视为空索引并返回 true
+    bool Load();
+    bool Save() const;
+
+    void Set(const std::string& key,const PackageRecord& record);
+    void Remove(const std::string& key);
+    const PackageRecord* Find(const std::string& key) const;
+    // 删除输出目录中已不存在的包的记录，返回删除的数量
+    size_t RemoveMissing(const std::string& outputDir);
+
+private:
+    std::string dataDir;
+    std::map<std::string,PackageRecord> records;
+
+    std::string GetIndexFile() const;
+};
+
+#endif
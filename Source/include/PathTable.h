@@ -0,0 +1,71 @@
+﻿#ifndef PATHTABLE_H
+#define PATHTABLE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+
+// 路径编号。同一个 PathTable 内相同路径的编号相同，比较路径只需比较整数
+using PathId=uint32_t;
+const PathId kRootPath=0;
+const PathId kInvalidPath=UINT32_MAX;
+
+// 字符串池：按块分配，已写入的字符串地址不会因后续追加而改变
+class StringArena {
+public:
+    std::string_view Store(std::string_view text);
+    void Clear();
+    size_t GetBytes() const { return totalBytes; }
+
+private:
+    static constexpr size_t kBlockSize=64*1024;
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t blockUsed=0;
+    size_t blockCapacity=0;
+    size_t totalBytes=0;
+};
+
+// 路径表：每个路径节点只保存 (父节点编号, 名称编号)，名称本身也只存一份，
+// 例如 mods/config/a.toml 与 mods/config/b.toml 共享 mods、mods/config 两个节点。
+// 完整路径仅在需要时（写 JSON、拼接磁盘路径、日志）由 GetPath 拼出。
+// 多个快照、版本列表共用同一张表时，路径编号可以直接比较。
+// 非线程安全：并发使用的场景（如 WebServer 请求处理）应各自持有独立的表。
+class PathTable {
+public:
+    PathTable();
+
+    // 插入路径（以 '/' 分隔，忽略空段），返回编号
+    PathId Intern(std::string_view path);
+    PathId InternChild(PathId parent,std::string_view name);
+    // 只查找不插入，不存在时返回 kInvalidPath
+    PathId Find(std::string_view path) const;
+
+    PathId GetParent(PathId id) const { return nodes[id].parent; }
+    std::string_view GetName(PathId id) const { return names[nodes[id].nameId]; }
+    std::string GetPath(PathId id) const;
+    void AppendPath(PathId id,std::string& out) const;
+
+    size_t Size() const { return nodes.size(); }
+    size_t GetMemoryUsage() const;
+
+private:
+    struct Node {
+        PathId parent;
+        uint32_t nameId;
+    };
+
+    static uint64_t ChildKey(PathId parent,uint32_t nameId) {
+        return (static_cast<uint64_t>(parent)<<32)|nameId;
+    }
+
+    std::vector<Node> nodes;
+    std::vector<std::string_view> names;
+    std::unordered_map<std::string_view,uint32_t> nameIds;
+    std::unordered_map<uint64_t,PathId> children;
+    StringArena arena;
+};
+
+#endif
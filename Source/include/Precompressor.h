@@ -0,0 +1,40 @@
+﻿#ifndef PRECOMPRESSOR_H
+#define PRECOMPRESSOR_H
+
+#include <string>
+#include <cstddef>
+
+// 预压缩的内容编码，对应 HTTP 的 Content-Encoding
+enum class ContentEncoding {
+    Identity,
+    Brotli,
+    Zstd,
+    Gzip
+};
+
+// 发布时把对象压缩为 .br/.zst/.gz 兄弟文件，/files/ 按 Accept-Encoding 直接返回，请求时不再消耗压缩 CPU。
+// 发布只做一次，所以三种编码都使用高压缩级别
+class Precompressor {
+public:
+    // 服务器的优先顺序：压缩率高的在前
+    static constexpr ContentEncoding kEncodings[]={ContentEncoding::Brotli,ContentEncoding::Zstd,ContentEncoding::Gzip};
+    // 所有编码都不值得保存时写入的空标记，下次发布不再重复尝试
+    static constexpr const char* kNoVariantSuffix=".plain";
+
+    // Content-Encoding 中的名称：br / zstd / gzip
+    static const char* EncodingName(ContentEncoding encoding);
+    // 对象旁的文件后缀：.br / .zst / .gz
+    static const char* FileSuffix(ContentEncoding encoding);
+
+    static bool Compress(ContentEncoding encoding,const unsigned char* data,size_t size,std::string& output);
+
+    // 至少节省 10% 且不少于 512 字节才保存，避免为几乎不可压缩的内容多占磁盘和多一次协商
+    static bool IsWorthwhile(size_t originalSize,size_t compressedSize);
+
+private:
+    static bool CompressGzip(const unsigned char* data,size_t size,std::string& output);
+    static bool CompressZstd(const unsigned char* data,size_t size,std::string& output);
+    static bool CompressBrotli(const unsigned char* data,size_t size,std::string& output);
+};
+
+#endif
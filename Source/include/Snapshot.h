@@ -0,0 +1,120 @@
+﻿#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <ctime>
+#include <cstdint>
+#include <json/json.h>
+#include "HashProvider.h"
+#include "PathTable.h"
+
+// 文件记录。path 为所属 Snapshot 路径表中的编号，需要字符串时通过 Snapshot::GetPath 获取
+struct FileInfo {
+    PathId path = kInvalidPath;
+    Digest hash;  // 二进制摘要，带算法标记，不同算法的哈希不可比较
+    uint64_t size = 0;
+    std::time_t modifiedTime = 0;
+
+    // 用于比较
+	//FIXEME: 简化的实现，以后可能需要改
+    bool operator==(const FileInfo& other) const {
+        return path==other.path&&hash==other.hash;
+    }
+};
+
+// 目录记录。不再保存文件副本，只引用 Snapshot 中的连续区间
+struct DirectoryInfo {
+    PathId path = kInvalidPath;
+    uint32_t firstFile = 0;   // Snapshot::files 中的起始下标
+    uint32_t fileCount = 0;
+    uint32_t firstChild = 0;  // Snapshot::childIndices 中的起始下标
+    uint32_t childCount = 0;
+    // Merkle 哈希：按名称排序的文件（名称+摘要）与子目录（名称+子树哈希），
+    // 子树完全相同时相等，可以整棵跳过
+    Digest treeHash;
+
+    bool Empty() const { return fileCount==0&&childCount==0; }
+};
+
+// 连续数组的只读视图
+template<typename T>
+class ArrayRange {
+public:
+    ArrayRange(const T* first,size_t count) : first(first),count(count) {}
+
+    const T* begin() const { return first; }
+    const T* end() const { return first+count; }
+    size_t size() const { return count; }
+    bool empty() const { return count==0; }
+    const T& operator[](size_t index) const { return first[index]; }
+
+private:
+    const T* first;
+    size_t count;
+};
+
+// 工作空间快照：所有文件记录放在一个连续数组中，按所在目录分组，
+// 目录只记录文件区间和子目录下标区间，路径统一保存在（可共享的）路径表中。
+// FileScanner/DiffEngine/PackageBuilder/WebServer 都以引用方式使用，禁止拷贝以免无意中复制整个快照。
+class Snapshot {
+public:
+    // paths 为空时使用独立的路径表；共用同一张表的快照之间可以直接比较路径编号
+    explicit Snapshot(std::shared_ptr<PathTable> paths=nullptr);
+    Snapshot(Snapshot&&)=default;
+    Snapshot& operator=(Snapshot&&)=default;
+    Snapshot(const Snapshot&)=delete;
+    Snapshot& operator=(const Snapshot&)=delete;
+
+    void Clear();
+
+    HashAlgorithm GetHashAlgorithm() const { return hashAlgorithm; }
+    void SetHashAlgorithm(HashAlgorithm algorithm) { hashAlgorithm=algorithm; }
+
+    // 构建接口：按任意顺序追加记录，最后调用 Finalize 整理为分组布局。
+    // Finalize 之前文件下标保持追加顺序，可以通过 GetMutableFile 回填哈希。
+    size_t AddFile(PathId path);
+    void AddDirectory(PathId path);
+    FileInfo& GetMutableFile(size_t index) { return files[index]; }
+    void Finalize();
+    // 直接采用已经整理好的布局（来自二进制快照），不再排序；
+    // 只有缺少 Merkle 哈希的目录存在时才重新计算
+    void AssignLayout(std::vector<FileInfo> files,std::vector<DirectoryInfo> directories,
+        std::vector<uint32_t> childIndices);
+
+    const std::vector<FileInfo>& GetFiles() const { return files; }
+    const std::vector<DirectoryInfo>& GetDirectories() const { return directories; }
+    ArrayRange<FileInfo> GetDirectoryFiles(const DirectoryInfo& dir) const;
+    // 子目录在 GetDirectories() 中的下标
+    ArrayRange<uint32_t> GetSubdirectories(const DirectoryInfo& dir) const;
+    // 根目录（Finalize 后位于下标 0），快照为空时返回空指针
+    const DirectoryInfo* GetRoot() const;
+
+    const PathTable& GetPathTable() const { return *paths; }
+    PathTable& GetPathTable() { return *paths; }
+    const std::shared_ptr<PathTable>& GetSharedPathTable() const { return paths; }
+    std::string GetPath(PathId id) const { return paths->GetPath(id); }
+
+    Json::Value FileToJson(const FileInfo& file) const;
+
+    // 从JSON加载（兼容旧格式：目录内带完整文件副本）
+    bool LoadFromJson(const Json::Value& json);
+
+    // 转换为JSON，格式与旧版本保持一致
+    Json::Value ToJson() const;
+
+    // 估算占用的内存（记录数组，不含共享的路径表）
+    size_t GetMemoryUsage() const;
+
+private:
+    HashAlgorithm hashAlgorithm=HashAlgorithm::Unknown;
+    std::shared_ptr<PathTable> paths;
+    std::vector<FileInfo> files;
+    std::vector<DirectoryInfo> directories;
+    std::vector<uint32_t> childIndices;
+
+    void ComputeTreeHashes();
+};
+
+#endif
@@ -0,0 +1,119 @@
+﻿#ifndef SNAPSHOTFILE_H
+#define SNAPSHOTFILE_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include "Snapshot.h"
+#include "SnapshotStream.h"
+#include "FileReader.h"
+
+// 二进制快照格式（snapshots/<version>.snap），按本机字节序（小端）写出，所有区段 8 字节对齐：
+//   头部 | 文件记录[fileCount] | 目录记录[directoryCount] | 子目录下标[childCount] | 字符串区
+// 布局与内存中的 Snapshot 相同：目录按路径排序，文件按 (目录, 名称) 分组排序，
+// 因此可以直接映射后二分查找，不需要解析。字符串区先放版本号，之后是各条记录的完整路径。
+struct SnapshotFileHeader {
+    char magic[8];             // "MCUSNAP\0"
+    uint32_t formatVersion;
+    uint32_t headerSize;
+    uint8_t hashAlgorithm;     // 快照级别的算法（HashAlgorithm）
+    uint8_t reserved[7];
+    uint32_t fileCount;
+    uint32_t directoryCount;
+    uint32_t childCount;
+    uint32_t versionLength;
+    uint64_t filesOffset;
+    uint64_t directoriesOffset;
+    uint64_t childrenOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    int64_t timestamp;
+    uint64_t payloadChecksum;  // 头部之后全部内容的 XXH3-64
+    uint64_t headerChecksum;   // 本字段置 0 时头部的 XXH3-64
+};
+
+struct SnapshotFileRecord {
+    uint64_t size;
+    int64_t modifiedTime;
+    uint32_t pathOffset;       // 字符串区内的偏移
+    uint32_t pathLength;
+    uint8_t hashAlgorithm;
+    uint8_t digestLength;
+    uint8_t reserved[6];
+    uint8_t digest[32];
+};
+
+struct SnapshotDirectoryRecord {
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    uint32_t firstFile;
+    uint32_t fileCount;
+    uint32_t firstChild;       // 子目录下标区段内的起始位置
+    uint32_t childCount;
+    uint8_t treeHashAlgorithm; // 目录的 Merkle 哈希（DirectoryInfo::treeHash）
+    uint8_t treeHashLength;
+    uint8_t reserved[6];
+    uint8_t treeHash[32];
+};
+
+static_assert(sizeof(SnapshotFileHeader)==104,"SnapshotFileHeader layout");
+static_assert(sizeof(SnapshotFileRecord)==64,"SnapshotFileRecord layout");
+static_assert(sizeof(SnapshotDirectoryRecord)==64,"SnapshotDirectoryRecord layout");
+
+// 已映射的二进制快照。Open 只校验头部，记录按需访问；越界的路径引用返回空字符串
+class SnapshotFile {
+public:
+    // 2: 目录记录增加 Merkle 哈希
+    static constexpr uint32_t kFormatVersion=2;
+
+    static bool Write(const std::string& filePath,const Snapshot& snapshot,const SnapshotMeta& meta);
+
+    bool Open(const std::string& filePath,std::string* error=nullptr);
+    // 以只读方式打开 snapshotsDir/<version>.snap，不写任何文件（WebServer 在请求中使用）
+    bool OpenVersion(const std::string& snapshotsDir,const std::string& version,std::string* error=nullptr);
+    // 生成器启动时调用：只有旧的 <version>.json 时转换为二进制格式。
+    // 已有 .snap 或没有 JSON 时什么也不做；转换失败时返回 false
+    static bool MigrateLegacy(const std::string& snapshotsDir,const std::string& version,std::string* error=nullptr);
+    void Close();
+    bool IsOpen() const { return header!=nullptr; }
+
+    // 校验整个文件内容的校验和（需要读取全部数据）
+    bool VerifyPayload() const;
+
+    HashAlgorithm GetHashAlgorithm() const { return static_cast<HashAlgorithm>(header->hashAlgorithm); }
+    SnapshotMeta GetMeta() const;
+
+    size_t GetFileCount() const { return header->fileCount; }
+    size_t GetDirectoryCount() const { return header->directoryCount; }
+    const SnapshotFileRecord& GetFile(size_t index) const { return files[index]; }
+    const SnapshotDirectoryRecord& GetDirectory(size_t index) const { return directories[index]; }
+    uint32_t GetChild(size_t index) const { return children[index]; }
+
+    std::string_view GetPath(const SnapshotFileRecord& file) const { return GetString(file.pathOffset,file.pathLength); }
+    std::string_view GetPath(const SnapshotDirectoryRecord& dir) const { return GetString(dir.pathOffset,dir.pathLength); }
+    static Digest GetDigest(const SnapshotFileRecord& file);
+    static Digest GetTreeHash(const SnapshotDirectoryRecord& dir);
+
+    // 按相对路径二分查找，不存在时返回空指针
+    const SnapshotDirectoryRecord* FindDirectory(std::string_view path) const;
+    const SnapshotFileRecord* FindFile(std::string_view path) const;
+
+    // 转换为内存中的 Snapshot，路径登记到 snapshot 当前的路径表
+    bool LoadInto(Snapshot& snapshot,std::string* error=nullptr) const;
+
+    // 按版本加载二进制快照（旧 JSON 快照需先经 MigrateLegacy 转换）
+    static bool LoadVersion(const std::string& snapshotsDir,const std::string& version,
+        Snapshot& snapshot,std::string* error=nullptr);
+
+private:
+    MappedFile mapped;
+    const SnapshotFileHeader* header=nullptr;
+    const SnapshotFileRecord* files=nullptr;
+    const SnapshotDirectoryRecord* directories=nullptr;
+    const uint32_t* children=nullptr;
+    const char* strings=nullptr;
+
+    std::string_view GetString(uint32_t offset,uint32_t length) const;
+};
+
+#endif
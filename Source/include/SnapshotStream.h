@@ -0,0 +1,34 @@
+﻿#ifndef SNAPSHOTSTREAM_H
+#define SNAPSHOTSTREAM_H
+
+#include <string>
+#include <ctime>
+#include <iosfwd>
+#include "Snapshot.h"
+
+// 快照文件中与记录一起保存的版本信息
+struct SnapshotMeta {
+    std::string version;       // 为空时不写出
+    std::time_t timestamp = 0; // 为 0 时不写出
+};
+
+// 流式写出快照 JSON：逐条记录直接写入输出流，不构建 Json::Value。
+// 字段与 Snapshot::ToJson 相同（目录中仍带文件副本），旧版本也能读取。
+class SnapshotWriter {
+public:
+    static bool WriteFile(const std::string& filePath,const Snapshot& snapshot,const SnapshotMeta& meta);
+    static void Write(std::ostream& out,const Snapshot& snapshot,const SnapshotMeta& meta);
+};
+
+// 流式解析快照 JSON：边读边把文件/目录记录填入 Snapshot，跳过目录中的文件副本等冗余字段。
+// 兼容 jsoncpp 写出的旧快照（键按字母序、非 ASCII 字符转义为 \uXXXX）。
+class SnapshotReader {
+public:
+    // snapshot 使用调用方提供的路径表；失败时 snapshot 内容不确定，error 为出错原因
+    static bool ReadFile(const std::string& filePath,Snapshot& snapshot,
+        SnapshotMeta* meta=nullptr,std::string* error=nullptr);
+    static bool Read(std::istream& in,Snapshot& snapshot,
+        SnapshotMeta* meta=nullptr,std::string* error=nullptr);
+};
+
+#endif
@@ -9,12 +9,26 @@
 #include "DiffEngine.h"
 #include "PackageBuilder.h"
 #include "VersionManager.h"
+#include "HashCache.h"
+#include "WorkspaceWatcher.h"
+#include "ObjectStore.h"
+#include "ChunkStore.h"
+#include "PackageIndex.h"
 
 class UpdateGenerator {
 public:
     UpdateGenerator(const Config& config);
 
     bool Initialize();
+    ~UpdateGenerator();
+
+    // 开启工作空间监视（受 watch_workspace 控制），之后的扫描只重扫变更路径。
+    // 监视不可用时返回 false，扫描照常全量进行
+    bool EnableWatch();
+    // 守护模式下的预扫描，让首次生成版本时也能走增量路径
+    bool ScanWorkspace();
+    // 自上次扫描以来累积的变更路径数，未监视时为 0
+    size_t GetPendingChanges() const;
 
     // 生成新版本
     bool GenerateVersion(const std::string& version,const std::string& description="");
@@ -27,6 +41,9 @@ public:
     // 生成全量更新包
     bool GenerateFullPackage(const std::string& version);
 
+    // 单独生成包之后调用：重建版本图并递增代数，serve 进程据此重新加载
+    bool RefreshVersionGraph() { return versionManager->RefreshVersionGraph(); }
+
     // 扫描并构建版本
     bool ScanAndBuild();
     bool RollbackToVersion(const std::string& targetVersion,
@@ -34,18 +51,44 @@ public:
         const std::string& description="");    
     bool GetPreviousVersionFiles(
         const std::string& version,
-        std::vector<FileInfo>& files,
-        std::vector<DirectoryInfo>& dirs);   
+        Snapshot& snapshot);   
     bool CreateDirectoryPackages(
         const std::string& version,
-        const std::vector<DirectoryInfo>& dirs);
+        const Snapshot& snapshot);
+    // 删除已不属于任何保留版本的对象，返回删除的数量（删除版本后调用）
+    size_t CollectUnreferencedObjects();
 private:
     Config config;
     std::unique_ptr<FileScanner> scanner;
     std::unique_ptr<VersionManager> versionManager;
+    std::unique_ptr<HashCache> hashCache;
+    std::unique_ptr<WorkspaceWatcher> watcher;
+    std::unique_ptr<ObjectStore> objectStore;
+    std::unique_ptr<ChunkStore> chunkStore;
+    // 包的摘要在打包时记录，WebServer 从这里读取
+    std::unique_ptr<PackageIndex> packageIndex;
+    ReadOptions readOptions;
+
+    // 当前工作空间的快照由 scanner 持有，这里不再复制
+    const Snapshot& CurrentSnapshot() const { return scanner->GetSnapshot(); }
+    // 按摘要查找内容（对象库优先，其次当前工作空间），供差异计算做相似度比较
+    DiffEngine::ContentResolver PublishedContentResolver() const;
 
-    std::vector<FileInfo> currentFiles;
-    std::vector<DirectoryInfo> currentDirs;
+    // 把快照中的文件内容存入对象库，包和 /files/ 之后都从对象库读取
+    bool PublishObjects(const Snapshot& snapshot);
+    // 为达到 chunk_threshold_mb 的文件生成分块列表，客户端据此只下载变化的分块
+    void PublishChunks(const Snapshot& snapshot);
+    // 为可压缩的对象生成 .br/.zst/.gz 变体（受 precompress 控制），/files/ 按 Accept-Encoding 直接返回
+    void PublishPrecompressed(const Snapshot& snapshot);
+    bool BuildFullPackage(const std::string& version,const Snapshot& snapshot);
+    // 把刚创建的包写入包索引，key 为相对输出目录的路径
+    void RecordPackage(const std::string& key,const PackageBuilder& builder);
+    // 创建 <from>_to_<to>.zip（完整文件，所有客户端可用）；开启 delta_patches 时另外创建补丁格式的
+    // <from>_to_<to>.patch.zip，由 update 信息的 patch_archive 提供给支持 update_patches.txt 的客户端
+    bool BuildIncrementalPackages(const std::string& fromVersion,const std::string& toVersion,
+        const std::vector<ChangeRecord>& changes);
+    // 只保留最新的 max_full_packages 个全量包，旧版本的内容仍在对象库中
+    void PruneFullPackages();
 
     // 获取前一个版本的文件列表
 
@@ -53,8 +96,7 @@ private:
     // 保存版本快照
     bool SaveVersionSnapshot(
         const std::string& version,
-        const std::vector<FileInfo>& files,
-        const std::vector<DirectoryInfo>& dirs);
+        const Snapshot& snapshot);
 
     // 创建目录包
 
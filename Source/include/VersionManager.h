@@ -4,17 +4,21 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <memory>
+#include <filesystem>
 #include <json/json.h>
+#include "PathTable.h"
 
 struct VersionInfo {
     std::string version;
     std::time_t timestamp;
     std::string manifestHash;
     std::vector<std::string> incrementalFrom;
-    std::vector<std::string> files;
-    std::vector<std::string> directories;
+    // 路径编号，属于 VersionManager 的路径表
+    std::vector<PathId> files;
+    std::vector<PathId> directories;
 
-    Json::Value ToJson() const {
+    Json::Value ToJson(const PathTable& paths) const {
         Json::Value json;
         json["version"]=version;
         json["timestamp"]=static_cast<Json::Int64>(timestamp);
@@ -28,13 +32,13 @@ struct VersionInfo {
 
         Json::Value filesJson(Json::arrayValue);
         for(const auto& file:files) {
-            filesJson.append(file);
+            filesJson.append(paths.GetPath(file));
         }
         json["files"]=filesJson;
 
         Json::Value dirsJson(Json::arrayValue);
         for(const auto& dir:directories) {
-            dirsJson.append(dir);
+            dirsJson.append(paths.GetPath(dir));
         }
         json["directories"]=dirsJson;
 
@@ -42,6 +46,15 @@ struct VersionInfo {
     }
 };
 
+// 从某个版本更新到目标版本的下载方案
+struct UpdatePlan {
+    bool reachable=false;       // 既没有增量链也没有全量包时为 false
+    bool useFullPackage=false;  // 直接下载目标版本的全量包
+    // 使用增量包时依次到达的版本（不含起点），第 i 步的包为 steps[i-1]_to_steps[i]（第一步从起点出发）
+    std::vector<std::string> steps;
+    uint64_t totalSize=0;       // 需要下载的字节数
+};
+
 class VersionManager {
 public:
     VersionManager(const std::string& dataDir);
@@ -58,11 +71,32 @@ public:
     // 获取版本列表
     std::vector<std::string> GetVersionList() const;
 
-    // 获取更新路径
+    // 版本列表的修改代数：每次增删版本加一并保存在 versions.json 中，
+    // WebServer 用它生成 API 响应的 ETag
+    uint64_t GetGeneration() const { return generation; }
+
+    // 版本列表使用的路径表，UpdateGenerator 的扫描结果和历史快照也共用这张表
+    PathTable& GetPathTable() { return *pathTable; }
+    const std::shared_ptr<PathTable>& GetSharedPathTable() const { return pathTable; }
+
+    // 获取更新路径：按增量包总字节数最小的增量链，依次返回经过的版本（不含起点），不可达时为空
     std::vector<std::string> GetUpdatePath(
         const std::string& fromVersion,
         const std::string& toVersion) const;
 
+    // 更新方案：最便宜的增量链与目标版本的全量包比较，取下载量小的一个
+    UpdatePlan PlanUpdate(
+        const std::string& fromVersion,
+        const std::string& toVersion) const;
+
+    // 包在版本添加之后才生成，生成完毕后重建版本图；代数随之递增，使已缓存的更新信息失效
+    bool RefreshVersionGraph();
+
+    // 版本由另一个进程（version/daemon）生成，serve 进程按 versions.json 的修改时间发现变化
+    bool HasChangedOnDisk() const;
+    // versions.json 有变化时重新读取版本列表和代数并重建版本图；读取失败时保留当前数据，返回是否已重新加载
+    bool ReloadIfChanged();
+
     // 查找最近的共同祖先
     std::string FindCommonAncestor(
         const std::string& version1,
@@ -71,12 +105,28 @@ public:
 private:
     std::string dataDir;
     std::unordered_map<std::string,VersionInfo> versions;
-
-    void LoadVersions();
+    std::shared_ptr<PathTable> pathTable;
+    uint64_t generation=0;
+    // 最近一次读取的 versions.json 的修改时间
+    std::filesystem::file_time_type versionsFileTime{};
+
+    // 版本图：一条边是一个现存的增量包 from -> to，权重为包的字节数
+    struct UpdateEdge {
+        std::string to;
+        uint64_t size=0;
+    };
+    std::unordered_map<std::string,std::vector<UpdateEdge>> forwardEdges;
+    // 现存的全量包大小
+    std::unordered_map<std::string,uint64_t> fullPackageSizes;
+
+    bool LoadVersions();
     bool SaveVersions() const;
 
-    // TODO：构建版本图，目前好像没什么用
+    // 按输出目录中的 incremental/ 与 full/ 构建版本图
     void BuildVersionGraph();
+    // 总字节数最小的增量链（Dijkstra），不可达时返回 false
+    bool FindCheapestPath(const std::string& fromVersion,const std::string& toVersion,
+        std::vector<std::string>& path,uint64_t& totalSize) const;
 
     // 数据文件路径
     std::string GetVersionsFile() const;
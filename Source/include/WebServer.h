@@ -3,10 +3,19 @@
 
 #include <string>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <unordered_map>
 #include "crow.h"
 #include "Config.h"
 #include "VersionManager.h"
 #include "FileScanner.h"
+#include "DiffEngine.h"
+#include "WorkspaceWatcher.h"
+#include "ObjectStore.h"
+#include "ChunkStore.h"
+#include "Precompressor.h"
 
 class WebServer {
 public:
@@ -21,19 +30,85 @@ public:
     crow::response HandleUpdateInfo(const crow::request& req);
     crow::response HandleFileDownload(const crow::request& req,const std::string& filepath);
     crow::response HandlePackageDownload(const crow::request& req,const std::string& package);
+    crow::response HandleChunkDownload(const crow::request& req,const std::string& digest);
+    crow::response HandleDelta(const crow::request& req);
     crow::response HandleVersionList(const crow::request& req);
     crow::response HandleStatus(const crow::request& req);
 
 private:
     Config config;
     VersionManager& versionManager;
+    // 版本由 version/daemon 进程生成，请求处理期间持有共享锁，重新加载 versions.json 时持有独占锁
+    std::shared_mutex versionMutex;
+    std::atomic<int64_t> lastVersionCheck{0};
     std::string workspace;
+    // 已发布版本的文件内容，/files/ 优先从这里读取
+    ObjectStore objectStore;
+    // 大文件的分块，/chunks/<摘要> 按分块下载
+    ChunkStore chunkStore;
     std::unique_ptr<crow::SimpleApp> app;
+    // 监视工作空间中尚未发布为版本的变更，供 /api/status 展示
+    std::unique_ptr<WorkspaceWatcher> watcher;
+
+    // 按键缓存序列化后的 JSON 响应。版本列表变化（代数改变）时整体失效，超过容量时淘汰最久未用的
+    class DocumentCache {
+    public:
+        explicit DocumentCache(size_t capacity) : capacity(capacity) {}
+        // 未命中时返回空指针
+        std::shared_ptr<const std::string> Find(const std::string& key,uint64_t generation);
+        void Insert(const std::string& key,uint64_t generation,const std::shared_ptr<const std::string>& document);
+    private:
+        struct Entry {
+            std::shared_ptr<const std::string> body;
+            uint64_t lastUsed=0;
+        };
+        size_t capacity;
+        std::mutex mutex;
+        std::unordered_map<std::string,Entry> entries;
+        uint64_t generation=0;
+        uint64_t clock=0;
+    };
+    // /api/update 的响应按版本缓存，请求时不再读快照、算包哈希
+    DocumentCache updateInfoCache{8};
+    // /api/delta 的响应按 (from,to) 缓存，同一对版本的差异只计算一次
+    DocumentCache deltaCache{32};
 
     void SetupRoutes();
 
+    // 每秒最多检查一次 versions.json，有变化时重新加载版本列表、代数和版本图；
+    // 返回的共享锁在处理请求期间保持，其间版本数据不会被替换
+    std::shared_lock<std::shared_mutex> LockVersions();
+
     // 生成更新信息JSON
     Json::Value GenerateUpdateInfo(const std::string& version) const;
+    // 取缓存的更新信息，未命中时生成并缓存（只缓存已存在的版本）
+    std::shared_ptr<const std::string> GetUpdateInfoDocument(const std::string& version);
+
+    // 加载版本快照，路径登记到 paths 中（同一次比较的两个快照共用一张表）
+    bool LoadVersionSnapshot(const std::string& version,const std::shared_ptr<PathTable>& paths,Snapshot& snapshot) const;
+    // 从客户端上报的文件列表（路径 + 摘要）构建快照，格式错误时返回 false 并给出原因
+    static bool BuildClientSnapshot(const Json::Value& json,HashAlgorithm algorithm,
+        const std::shared_ptr<PathTable>& paths,Snapshot& snapshot,std::string& error);
+    // 差异结果：需要下载的条目带上 /files/ 地址
+    Json::Value DeltaToJson(const std::string& fromVersion,const std::string& toVersion,
+        HashAlgorithm algorithm,const std::vector<ChangeRecord>& changes) const;
+
+    // /files/ 请求的实际文件：在版本快照中的文件返回对象库中的对象（与版本一致）。
+    // 请求最新版本时，不在对象库中的文件（旧版本发布前的数据、未发布的文件）退回工作空间中的文件；
+    // 明确指定了版本却找不到对象时返回空串，不能用当前内容冒充该版本。
+    // 返回对象时通过 digest 带回内容摘要
+    std::string ResolveFilePath(const std::string& relativePath,const std::string& version,Digest* digest=nullptr) const;
+
+    // 以流式响应返回文件：crow 发送时按固定大小的缓冲读取，不把文件整体读入内存。
+    // 支持单个 Range 区间（206）与 If-Range，以及 If-None-Match / If-Modified-Since（304）。
+    // etag 为空时由文件大小和修改时间生成；immutable 用于地址即内容的 URL，允许客户端长期缓存。
+    // downloadName 非空时附带 Content-Disposition；displayName 用于错误信息
+    crow::response ServeFile(const crow::request& req,const std::string& path,const std::string& contentType,
+        const std::string& downloadName,const std::string& displayName,
+        const std::string& etag,bool immutable) const;
+
+    // 按 Accept-Encoding 从对象已有的预压缩变体中选择编码，都不可用时返回 Identity
+    ContentEncoding SelectEncoding(const std::string& acceptEncoding,const Digest& digest) const;
 
     // 检查文件存在性
     bool FileExists(const std::string& filepath) const;
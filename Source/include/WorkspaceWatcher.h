@@ -0,0 +1,65 @@
+﻿#ifndef WORKSPACEWATCHER_H
+#define WORKSPACEWATCHER_H
+
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+// 工作空间变更监视：Linux 下使用 inotify，Windows 下使用 ReadDirectoryChangesW，
+// 在后台线程中维护一个"脏路径"集合（相对工作空间，'/' 分隔，文件或目录，目录表示整棵子树），
+// UpdateGenerator 据此只重新扫描变化的部分。
+// 事件队列溢出、监视数量超限等导致事件可能丢失时，标记需要全量扫描。
+class WorkspaceWatcher {
+public:
+    explicit WorkspaceWatcher(const std::string& workspace);
+    ~WorkspaceWatcher();
+
+    // 平台不支持或初始化失败时返回 false，调用方应始终使用全量扫描
+    bool Start();
+    void Stop();
+    // 监视线程因错误退出后不再算作运行中，调用方回到全量扫描
+    bool IsRunning() const { return running&&!failed; }
+
+    // 取出并清空当前的脏路径集合；返回 false 表示期间有事件丢失，需要全量扫描
+    bool TakeDirtyPaths(std::vector<std::string>& paths);
+    // 当前待处理的脏路径数量（用于状态显示）
+    size_t GetPendingCount() const;
+    bool IsOverflowed() const;
+
+private:
+    std::string workspace;
+    std::thread worker;
+    std::atomic<bool> running{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> failed{false};
+
+    mutable std::mutex mutex;
+    std::unordered_set<std::string> dirtyPaths;
+    bool overflowed=false;
+
+    void MarkDirty(const std::string& relativePath);
+    void MarkOverflow();
+    // 监视线程无法继续时调用：之后的事件都会丢失
+    void MarkFailed();
+
+#ifdef _WIN32
+    void* directoryHandle=nullptr;
+    void* stopEvent=nullptr;
+#else
+    int inotifyFd=-1;
+    int stopPipe[2]={-1,-1};
+    // inotify 只能监视单个目录，需要为每个子目录单独添加，记录 watch 描述符对应的相对路径
+    std::unordered_map<int,std::string> watchPaths;
+
+    void AddWatchRecursive(const std::string& relativePath);
+    void RemoveWatchRecursive(const std::string& relativePath);
+#endif
+
+    void WatchLoop();
+};
+
+#endif
@@ -8762,6 +8762,8 @@ namespace crow
             headers = std::move(r.headers);
             completed_ = r.completed_;
             file_info = std::move(r.file_info);
+            // McUpdaterServer: keep a handler's request to omit Content-Length (e.g. 304) when the response is moved
+            manual_length_header = r.manual_length_header;
             return *this;
         }
 
@@ -8819,7 +8821,11 @@ namespace crow
                 completed_ = true;
                 if (skip_body)
                 {
-                    set_header("Content-Length", std::to_string(body.size()));
+                    // McUpdaterServer: a static response already carries the file (range) length, keep it for HEAD
+                    if (!is_static_type())
+                    {
+                        set_header("Content-Length", std::to_string(body.size()));
+                    }
                     body = "";
                     manual_length_header = true;
                 }
@@ -8854,6 +8860,11 @@ namespace crow
             std::string path = "";
             struct stat statbuf;
             int statResult;
+            // McUpdaterServer: only send [offset, offset+length); length 0 means up to the end of the file
+            uint64_t offset = 0;
+            uint64_t length = 0;
+            // McUpdaterServer: file already opened by the handler, whose size produced Content-Length
+            std::shared_ptr<std::istream> stream;
         };
 
         void set_static_file_info(std::string path, std::string content_type = "")
@@ -8862,6 +8873,23 @@ namespace crow
             set_static_file_info_unsafe(path, content_type);
         }
 
+        // McUpdaterServer: stream a byte range (length > 0) of a file the handler has already opened and
+        // measured, so the advertised length and the bytes sent come from the same file.
+        // Skips stat(), which cannot represent files over 2 GB on Windows; path is only used for identification.
+        void set_static_file_range(std::string path, std::shared_ptr<std::istream> stream, uint64_t offset, uint64_t length, std::string content_type)
+        {
+            file_info.path = path;
+            file_info.statResult = 0;
+            file_info.offset = offset;
+            file_info.length = length;
+            file_info.stream = std::move(stream);
+#ifdef CROW_ENABLE_COMPRESSION
+            compressed = false;
+#endif
+            this->set_header("Content-Length", std::to_string(length));
+            this->set_header("Content-Type", content_type);
+        }
+
         void set_static_file_info_unsafe(std::string path, std::string content_type = "")
         {
             file_info.path = path;
@@ -10467,17 +10495,39 @@ namespace crow
         {
             asio::write(adaptor_.socket(), buffers_);
 
-            if (res.file_info.statResult == 0)
+            // McUpdaterServer: HEAD gets the headers only, the file body would break keep-alive framing
+            if (res.file_info.statResult == 0 && !res.skip_body)
             {
-                std::ifstream is(res.file_info.path.c_str(), std::ios::in | std::ios::binary);
+                std::ifstream opened;
+                if (!res.file_info.stream)
+                {
+                    opened.open(std::filesystem::u8path(res.file_info.path), std::ios::in | std::ios::binary);
+                }
+                std::istream& is = res.file_info.stream ? *res.file_info.stream : static_cast<std::istream&>(opened);
+                if (res.file_info.offset > 0)
+                {
+                    is.seekg(static_cast<std::streamoff>(res.file_info.offset));
+                }
+                uint64_t remaining = res.file_info.length > 0 ? res.file_info.length : UINT64_MAX;
                 std::vector<asio::const_buffer> buffers{1};
                 char buf[16384];
-                is.read(buf, sizeof(buf));
-                while (is.gcount() > 0)
+                is.read(buf, static_cast<std::streamsize>(std::min<uint64_t>(sizeof(buf), remaining)));
+                while (is.gcount() > 0 && adaptor_.is_open())
                 {
+                    remaining -= static_cast<uint64_t>(is.gcount());
                     buffers[0] = asio::buffer(buf, is.gcount());
                     do_write_sync(buffers);
-                    is.read(buf, sizeof(buf));
+                    if (remaining == 0)
+                    {
+                        break;
+                    }
+                    is.read(buf, static_cast<std::streamsize>(std::min<uint64_t>(sizeof(buf), remaining)));
+                }
+                // McUpdaterServer: the file shrank after Content-Length was sent; the response cannot be
+                // completed, close instead of letting the client read the next response as body
+                if (res.file_info.length > 0 && remaining > 0)
+                {
+                    close_connection_ = true;
                 }
             }
             if (close_connection_)
@@ -0,0 +1,99 @@
+﻿#include "ChunkStore.h"
+#include "HashProvider.h"
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+ChunkStore::ChunkStore(const std::string& rootDir,const ChunkerParams& params)
+    : chunker(params),chunks(rootDir+"/data"),lists(rootDir+"/lists") {
+}
+
+bool ChunkStore::AddFile(const Digest& fileDigest,const unsigned char* data,size_t size,ObjectStoreStats* stats) {
+    if(fileDigest.Empty()||!HashProvider::Create(fileDigest.algorithm)) {
+        return false;
+    }
+
+    std::ostringstream list;
+    list<<"# Chunk List\n";
+    list<<"# Format: HASH:SIZE\n";
+    bool success=true;
+    chunker.Split(data,size,[&](size_t offset,size_t length) {
+        if(!success) {
+            return;
+        }
+        auto hasher=HashProvider::Create(fileDigest.algorithm);
+        hasher->Update(data+offset,length);
+        Digest chunkDigest=hasher->Finish();
+
+        bool stored=false;
+        if(!chunks.PutData(chunkDigest,data+offset,length,&stored)) {
+            success=false;
+            return;
+        }
+        if(stats) {
+            if(stored) {
+                ++stats->stored;
+                stats->storedBytes+=length;
+            }
+            else {
+                ++stats->reused;
+            }
+        }
+        list<<chunkDigest.ToHex()<<":"<<length<<"\n";
+        });
+    if(!success) {
+        return false;
+    }
+
+    // 分块都写入后才写列表，有列表就意味着所有分块可用
+    std::string content=list.str();
+    return lists.PutData(fileDigest,content.data(),content.size());
+}
+
+bool ChunkStore::LoadChunkList(const Digest& fileDigest,std::vector<ChunkRef>& result) const {
+    result.clear();
+    std::ifstream in(lists.GetObjectPath(fileDigest),std::ios::binary);
+    if(!in) {
+        return false;
+    }
+    std::string line;
+    while(std::getline(in,line)) {
+        if(line.empty()||line[0]=='#') {
+            continue;
+        }
+        size_t colon=line.find(':');
+        if(colon==std::string::npos) {
+            return false;
+        }
+        ChunkRef chunk;
+        chunk.hash=Digest::FromHex(line.substr(0,colon),fileDigest.algorithm);
+        chunk.size=static_cast<uint32_t>(std::strtoul(line.c_str()+colon+1,nullptr,10));
+        if(chunk.hash.Empty()) {
+            return false;
+        }
+        result.push_back(chunk);
+    }
+    return true;
+}
+
+size_t ChunkStore::RemoveUnreferenced(const std::unordered_set<Digest,DigestHash>& liveFiles) {
+    lists.RemoveUnreferenced(liveFiles);
+
+    // 剩下的列表引用的分块都要保留；有列表读不出来时不清理分块
+    std::unordered_set<Digest,DigestHash> liveChunks;
+    bool complete=true;
+    std::vector<ChunkRef> refs;
+    lists.ForEachObject([&](const Digest& fileDigest,const std::filesystem::path&) {
+        if(!LoadChunkList(fileDigest,refs)) {
+            complete=false;
+            return;
+        }
+        for(const auto& chunk:refs) {
+            liveChunks.insert(chunk.hash);
+        }
+        });
+    if(!complete) {
+        return 0;
+    }
+    return chunks.RemoveUnreferenced(liveChunks);
+}
@@ -0,0 +1,74 @@
+﻿#include "Chunker.h"
+#include <array>
+#include <algorithm>
+
+// 掩码的 1 隔位分散在高位：左移的 Gear 哈希中高位包含更长窗口的信息，
+// 比低位连续的掩码切分更均匀（FastCDC 论文的做法）。bits 不超过 32
+static uint64_t SpreadMask(int bits) {
+    uint64_t mask=0;
+    for(int i=0; i<bits&&i<32; ++i) {
+        mask|=1ull<<(63-i*2);
+    }
+    return mask;
+}
+
+Chunker::Chunker(const ChunkerParams& params)
+    : params(params) {
+    int bits=0;
+    while((static_cast<size_t>(1)<<(bits+1))<=params.averageSize) {
+        ++bits;
+    }
+    // 归一化级别 2：严格掩码多 2 位，宽松掩码少 2 位
+    strictMask=SpreadMask(bits+2);
+    looseMask=SpreadMask(bits>2?bits-2:1);
+}
+
+// Gear 表由固定种子生成（splitmix64），保证不同进程、不同平台分块结果一致
+const uint64_t* Chunker::GearTable() {
+    static const auto table=[] {
+        std::array<uint64_t,256> values{};
+        uint64_t seed=0x9E3779B97F4A7C15ull;
+        for(auto& value:values) {
+            seed+=0x9E3779B97F4A7C15ull;
+            uint64_t z=seed;
+            z=(z^(z>>30))*0xBF58476D1CE4E5B9ull;
+            z=(z^(z>>27))*0x94D049BB133111EBull;
+            value=z^(z>>31);
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+size_t Chunker::NextChunk(const unsigned char* data,size_t size) const {
+    if(size<=params.minSize) {
+        return size;
+    }
+    const uint64_t* gear=GearTable();
+    size_t end=std::min(size,params.maxSize);
+    size_t normal=std::min(end,params.averageSize);
+    uint64_t hash=0;
+    size_t i=params.minSize;
+    for(; i<normal; ++i) {
+        hash=(hash<<1)+gear[data[i]];
+        if((hash&strictMask)==0) {
+            return i+1;
+        }
+    }
+    for(; i<end; ++i) {
+        hash=(hash<<1)+gear[data[i]];
+        if((hash&looseMask)==0) {
+            return i+1;
+        }
+    }
+    return end;
+}
+
+void Chunker::Split(const unsigned char* data,size_t size,const ChunkCallback& callback) const {
+    size_t offset=0;
+    while(offset<size) {
+        size_t length=NextChunk(data+offset,size-offset);
+        callback(offset,length);
+        offset+=length;
+    }
+}
@@ -54,6 +54,31 @@ bool Config::Load() {
     if(jsonConfig.isMember("language"))
         language=jsonConfig["language"].asString();
 
+    if(jsonConfig.isMember("scan_threads"))
+        scanThreads=jsonConfig["scan_threads"].asInt();
+
+    if(jsonConfig.isMember("io_strategy"))
+        ioStrategy=jsonConfig["io_strategy"].asString();
+
+    if(jsonConfig.isMember("hash_buffer_kb"))
+        hashBufferKb=jsonConfig["hash_buffer_kb"].asInt();
+
+    if(jsonConfig.isMember("mmap_threshold_mb"))
+        mmapThresholdMb=jsonConfig["mmap_threshold_mb"].asInt();
+
+    if(jsonConfig.isMember("drop_page_cache"))
+        dropPageCache=jsonConfig["drop_page_cache"].asBool();
+    if(jsonConfig.isMember("watch_workspace"))
+        watchWorkspace=jsonConfig["watch_workspace"].asBool();
+    if(jsonConfig.isMember("delta_patches"))
+        deltaPatches=jsonConfig["delta_patches"].asBool();
+    if(jsonConfig.isMember("max_full_packages"))
+        maxFullPackages=jsonConfig["max_full_packages"].asInt();
+    if(jsonConfig.isMember("chunk_threshold_mb"))
+        chunkThresholdMb=jsonConfig["chunk_threshold_mb"].asInt();
+    if(jsonConfig.isMember("precompress"))
+        precompress=jsonConfig["precompress"].asBool();
+
     Language::Instance().SetLanguage(language);
 
     return true;
@@ -74,6 +99,16 @@ bool Config::Save() {
     jsonConfig["max_package_versions"]=maxPackageVersions;
     jsonConfig["log_file"]=logFile;
     jsonConfig["language"]=language;
+    jsonConfig["scan_threads"]=scanThreads;
+    jsonConfig["io_strategy"]=ioStrategy;
+    jsonConfig["hash_buffer_kb"]=hashBufferKb;
+    jsonConfig["mmap_threshold_mb"]=mmapThresholdMb;
+    jsonConfig["drop_page_cache"]=dropPageCache;
+    jsonConfig["watch_workspace"]=watchWorkspace;
+    jsonConfig["delta_patches"]=deltaPatches;
+    jsonConfig["max_full_packages"]=maxFullPackages;
+    jsonConfig["chunk_threshold_mb"]=chunkThresholdMb;
+    jsonConfig["precompress"]=precompress;
 
     // 初始化或者判断有没有人把配置给删除了，防止出奇奇怪怪的问题
     std::filesystem::path configFilePath(configPath);
@@ -133,5 +168,15 @@ Json::Value Config::GetDefaultConfig() {
     config["max_package_versions"]=10;
     config["log_file"]="./logs/server.log";
     config["language"]="zh_CN";
+    config["scan_threads"]=0;
+    config["io_strategy"]="auto";
+    config["hash_buffer_kb"]=1024;
+    config["mmap_threshold_mb"]=64;
+    config["drop_page_cache"]=true;
+    config["watch_workspace"]=true;
+    config["delta_patches"]=true;
+    config["max_full_packages"]=0;
+    config["chunk_threshold_mb"]=8;
+    config["precompress"]=true;
     return config;
 }
\ No newline at end of file
@@ -0,0 +1,223 @@
+﻿#include "DeltaPatch.h"
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+static const char kDeltaMagic[8]={'M','C','U','D','E','L','T','A'};
+static const uint8_t kDeltaFormatVersion=1;
+
+static const uint8_t kOpEnd=0x00;
+static const uint8_t kOpCopy=0x01;
+static const uint8_t kOpAdd=0x02;
+
+static const size_t kMinBlockSize=16;
+static const size_t kMaxBlockSize=4096;
+static const size_t kMaxIndexEntries=1<<20;   // 索引最多约 1M 条，内存占用上限约 32MB
+static const size_t kMaxProbes=8;             // 哈希冲突时最多比较的候选数
+static const uint64_t kRollingPrime=0x100000001B3ull;
+
+static void PutVarint(std::string& out,uint64_t value) {
+    while(value>=0x80) {
+        out.push_back(static_cast<char>((value&0x7F)|0x80));
+        value>>=7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static bool GetVarint(const std::string& in,size_t& pos,uint64_t& value) {
+    value=0;
+    for(int shift=0; shift<64; shift+=7) {
+        if(pos>=in.size()) {
+            return false;
+        }
+        uint8_t byte=static_cast<uint8_t>(in[pos++]);
+        value|=static_cast<uint64_t>(byte&0x7F)<<shift;
+        if((byte&0x80)==0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 多项式滚动哈希（模 2^64），窗口右移一个字节只需 O(1) 更新
+static uint64_t HashBlock(const unsigned char* data,size_t length) {
+    uint64_t hash=0;
+    for(size_t i=0; i<length; ++i) {
+        hash=hash*kRollingPrime+data[i];
+    }
+    return hash;
+}
+
+static size_t SlotOf(uint64_t hash,size_t mask) {
+    return static_cast<size_t>((hash^(hash>>29))*0xBF58476D1CE4E5B9ull>>17)&mask;
+}
+
+size_t DeltaPatch::BlockSizeFor(size_t oldSize) {
+    size_t blockSize=kMinBlockSize;
+    while(blockSize<kMaxBlockSize&&oldSize/blockSize>kMaxIndexEntries) {
+        blockSize*=2;
+    }
+    return blockSize;
+}
+
+// 与 rsync 类似：旧内容按固定块建哈希索引，新内容逐字节滚动查找匹配块，
+// 命中后向前向后尽量延伸为一次 COPY，未命中的字节累积为 ADD。
+// 插入/删除造成的偏移不影响后续匹配，适合 jar 内个别类变化、存档中少量区块变化等场景
+bool DeltaPatch::Create(const unsigned char* oldData,size_t oldSize,
+    const unsigned char* newData,size_t newSize,std::string& patch) {
+    patch.clear();
+    patch.append(kDeltaMagic,sizeof(kDeltaMagic));
+    patch.push_back(static_cast<char>(kDeltaFormatVersion));
+    PutVarint(patch,oldSize);
+    PutVarint(patch,newSize);
+
+    size_t literalStart=0;
+    auto emitAdd=[&](size_t end) {
+        if(end>literalStart) {
+            patch.push_back(static_cast<char>(kOpAdd));
+            PutVarint(patch,end-literalStart);
+            patch.append(reinterpret_cast<const char*>(newData+literalStart),end-literalStart);
+        }
+    };
+
+    size_t blockSize=BlockSizeFor(oldSize);
+    size_t entries=oldSize/blockSize;
+    if(entries>0&&newSize>=blockSize) {
+        struct IndexSlot {
+            uint64_t hash;
+            size_t offset;
+        };
+        static const size_t kEmptySlot=SIZE_MAX;
+
+        size_t tableSize=1;
+        while(tableSize<entries*2) {
+            tableSize<<=1;
+        }
+        size_t mask=tableSize-1;
+        std::vector<IndexSlot> table(tableSize,IndexSlot{0,kEmptySlot});
+        for(size_t offset=0; offset+blockSize<=oldSize; offset+=blockSize) {
+            uint64_t hash=HashBlock(oldData+offset,blockSize);
+            size_t slot=SlotOf(hash,mask);
+            for(size_t probe=0; probe<kMaxProbes; ++probe,slot=(slot+1)&mask) {
+                if(table[slot].offset==kEmptySlot) {
+                    table[slot]=IndexSlot{hash,offset};
+                    break;
+                }
+                // 相同内容的块只保留第一个
+                if(table[slot].hash==hash&&std::memcmp(oldData+table[slot].offset,oldData+offset,blockSize)==0) {
+                    break;
+                }
+            }
+        }
+        auto lookup=[&](uint64_t hash,const unsigned char* block) -> size_t {
+            size_t slot=SlotOf(hash,mask);
+            for(size_t probe=0; probe<kMaxProbes; ++probe,slot=(slot+1)&mask) {
+                const IndexSlot& entry=table[slot];
+                if(entry.offset==kEmptySlot) {
+                    break;
+                }
+                if(entry.hash==hash&&std::memcmp(oldData+entry.offset,block,blockSize)==0) {
+                    return entry.offset;
+                }
+            }
+            return kEmptySlot;
+        };
+
+        // 窗口左移出去的字节的权重 P^(blockSize-1)
+        uint64_t outWeight=1;
+        for(size_t i=1; i<blockSize; ++i) {
+            outWeight*=kRollingPrime;
+        }
+
+        size_t pos=0;
+        uint64_t hash=0;
+        bool hashValid=false;
+        while(pos+blockSize<=newSize) {
+            if(!hashValid) {
+                hash=HashBlock(newData+pos,blockSize);
+                hashValid=true;
+            }
+            size_t match=lookup(hash,newData+pos);
+            if(match!=kEmptySlot) {
+                size_t oldEnd=match+blockSize;
+                size_t newEnd=pos+blockSize;
+                while(oldEnd<oldSize&&newEnd<newSize&&oldData[oldEnd]==newData[newEnd]) {
+                    ++oldEnd;
+                    ++newEnd;
+                }
+                size_t oldStart=match;
+                size_t newStart=pos;
+                while(newStart>literalStart&&oldStart>0&&oldData[oldStart-1]==newData[newStart-1]) {
+                    --oldStart;
+                    --newStart;
+                }
+                emitAdd(newStart);
+                patch.push_back(static_cast<char>(kOpCopy));
+                PutVarint(patch,oldStart);
+                PutVarint(patch,newEnd-newStart);
+                // 补丁已经不比新内容小，没有继续的必要
+                if(patch.size()>=newSize) {
+                    return false;
+                }
+                pos=newEnd;
+                literalStart=pos;
+                hashValid=false;
+                continue;
+            }
+            if(pos+blockSize<newSize) {
+                hash=(hash-newData[pos]*outWeight)*kRollingPrime+newData[pos+blockSize];
+            }
+            ++pos;
+        }
+    }
+
+    emitAdd(newSize);
+    patch.push_back(static_cast<char>(kOpEnd));
+    return patch.size()<newSize;
+}
+
+bool DeltaPatch::Apply(const unsigned char* oldData,size_t oldSize,
+    const std::string& patch,std::string& output) {
+    output.clear();
+    if(patch.size()<sizeof(kDeltaMagic)+1||
+        std::memcmp(patch.data(),kDeltaMagic,sizeof(kDeltaMagic))!=0||
+        static_cast<uint8_t>(patch[sizeof(kDeltaMagic)])!=kDeltaFormatVersion) {
+        return false;
+    }
+
+    size_t pos=sizeof(kDeltaMagic)+1;
+    uint64_t expectedOldSize=0;
+    uint64_t newSize=0;
+    if(!GetVarint(patch,pos,expectedOldSize)||!GetVarint(patch,pos,newSize)||expectedOldSize!=oldSize) {
+        return false;
+    }
+    // 大小来自补丁本身，先不完全信任，预留空间以补丁可能产生的上限为准
+    output.reserve(static_cast<size_t>(std::min<uint64_t>(newSize,oldSize+patch.size())));
+
+    while(pos<patch.size()) {
+        uint8_t op=static_cast<uint8_t>(patch[pos++]);
+        if(op==kOpEnd) {
+            return pos==patch.size()&&output.size()==newSize;
+        }
+        uint64_t offset=0;
+        uint64_t length=0;
+        if(op==kOpCopy) {
+            if(!GetVarint(patch,pos,offset)||!GetVarint(patch,pos,length)||
+                offset>oldSize||length>oldSize-offset||length>newSize-output.size()) {
+                return false;
+            }
+            output.append(reinterpret_cast<const char*>(oldData+offset),static_cast<size_t>(length));
+        }
+        else if(op==kOpAdd) {
+            if(!GetVarint(patch,pos,length)||length>patch.size()-pos||length>newSize-output.size()) {
+                return false;
+            }
+            output.append(patch,pos,static_cast<size_t>(length));
+            pos+=static_cast<size_t>(length);
+        }
+        else {
+            return false;
+        }
+    }
+    return false;
+}
@@ -5,168 +5,503 @@
 #include <sstream>
 #include <iomanip>
 #include "Logger.h"
+#include "FileReader.h"
+#include "Chunker.h"
+#include <xxhash.h>
+#include <cctype>
+#include <memory>
 
-//主函数
-//FIXME: 现有设计有缺陷，譬如若内容被改变的文件移动，DetectFileMovements 因为hash不同应该不会记录移动。
-std::vector<ChangeRecord> DiffEngine::CalculateDiff(
-    const std::vector<FileInfo>& oldFiles,
-    const std::vector<FileInfo>& newFiles,
-    const std::vector<DirectoryInfo>& oldDirs,
-    const std::vector<DirectoryInfo>& newDirs) {
+// 把旧快照的路径编号换算到新快照的路径表；两者共用同一张表时直接使用，
+// 否则按路径查找，新表中不存在的路径返回 kInvalidPath
+static PathId TranslatePath(const Snapshot& from,const Snapshot& to,PathId id) {
+    if(from.GetSharedPathTable()==to.GetSharedPathTable()) {
+        return id;
+    }
+    return to.GetPathTable().Find(from.GetPath(id));
+}
 
-    g_logger<<LANG("diff_processing")<<std::endl;
+// 目录树同步遍历的状态。变更按类别分开收集，最后按旧版本的顺序拼接：
+// 新增/修改、删除、（移动检测）、新增空目录、删除空目录
+struct TreeDiffContext {
+    const Snapshot& oldSnapshot;
+    const Snapshot& newSnapshot;
+    std::vector<ChangeRecord> fileChanges;
+    std::vector<ChangeRecord> deletions;
+    std::vector<ChangeRecord> addedDirectories;
+    std::vector<ChangeRecord> deletedDirectories;
+    bool algorithmMismatchReported=false;
+    bool verbose=true;
 
-    std::vector<ChangeRecord> changes;
+    TreeDiffContext(const Snapshot& oldSnapshot,const Snapshot& newSnapshot,bool verbose)
+        : oldSnapshot(oldSnapshot),newSnapshot(newSnapshot),verbose(verbose) {
+    }
+};
 
-    // 构建新旧文件映射
-    std::unordered_map<std::string,const FileInfo*> oldFileMap;
-    for(const auto& file:oldFiles) {
-        oldFileMap[file.path]=&file;
+static void EmitFileChange(TreeDiffContext& context,std::vector<ChangeRecord>& out,ChangeType type,
+    const Snapshot& snapshot,const FileInfo& file,const char* logKey) {
+    ChangeRecord record;
+    record.type=type;
+    record.path=snapshot.GetPath(file.path);
+    record.hash=file.hash;
+    record.size=file.size;
+    if(context.verbose) {
+        g_logger<<LANG(logKey)<<record.path<<std::endl;
     }
+    out.push_back(std::move(record));
+}
 
-    std::unordered_map<std::string,const FileInfo*> newFileMap;
-    for(const auto& file:newFiles) {
-        newFileMap[file.path]=&file;
+static void EmitDirectoryChange(TreeDiffContext& context,std::vector<ChangeRecord>& out,ChangeType type,
+    const Snapshot& snapshot,const DirectoryInfo& dir,const char* logKey) {
+    ChangeRecord record;
+    record.type=type;
+    record.path=snapshot.GetPath(dir.path);
+    if(context.verbose) {
+        g_logger<<LANG(logKey)<<record.path<<std::endl;
     }
-	//optimize: 日志输出冗余，当文件数量较多时会产生大量日志，考虑增加日志级别控制
-    // 新增和修改文件的检测
-    for(const auto& newFile:newFiles) {
-        auto it=oldFileMap.find(newFile.path);
-        if(it==oldFileMap.end()) {
-            // 新增文件检测
-            ChangeRecord record;
-            record.type=ChangeType::ADDED;
-            record.path=newFile.path;
-            record.hash=newFile.hash;
-            record.size=newFile.size;
-            changes.push_back(record);
-            g_logger<<LANG("diff_added")<<newFile.path<<std::endl;
+    out.push_back(std::move(record));
+}
+
+// 只存在于新快照的子树：所有文件为新增，空目录为新增目录
+static void AddSubtree(TreeDiffContext& context,uint32_t dirIndex) {
+    const Snapshot& snapshot=context.newSnapshot;
+    const DirectoryInfo& dir=snapshot.GetDirectories()[dirIndex];
+    if(dir.Empty()) {
+        EmitDirectoryChange(context,context.addedDirectories,ChangeType::DIRECTORY_ADDED,snapshot,dir,"info_directory_added");
+    }
+    for(const auto& file:snapshot.GetDirectoryFiles(dir)) {
+        EmitFileChange(context,context.fileChanges,ChangeType::ADDED,snapshot,file,"diff_added");
+    }
+    for(uint32_t child:snapshot.GetSubdirectories(dir)) {
+        AddSubtree(context,child);
+    }
+}
+
+// 只存在于旧快照的子树：所有文件为删除，空目录为删除目录
+static void DeleteSubtree(TreeDiffContext& context,uint32_t dirIndex) {
+    const Snapshot& snapshot=context.oldSnapshot;
+    const DirectoryInfo& dir=snapshot.GetDirectories()[dirIndex];
+    if(dir.Empty()) {
+        EmitDirectoryChange(context,context.deletedDirectories,ChangeType::DIRECTORY_DELETED,snapshot,dir,"info_directory_deleted");
+    }
+    for(const auto& file:snapshot.GetDirectoryFiles(dir)) {
+        EmitFileChange(context,context.deletions,ChangeType::DELETED,snapshot,file,"diff_deleted");
+    }
+    for(uint32_t child:snapshot.GetSubdirectories(dir)) {
+        DeleteSubtree(context,child);
+    }
+}
+
+// 同一路径的新旧目录：Merkle 哈希相同直接跳过，否则按名称归并文件和子目录
+static void DiffDirectory(TreeDiffContext& context,uint32_t oldIndex,uint32_t newIndex) {
+    const Snapshot& oldSnapshot=context.oldSnapshot;
+    const Snapshot& newSnapshot=context.newSnapshot;
+    const DirectoryInfo& oldDir=oldSnapshot.GetDirectories()[oldIndex];
+    const DirectoryInfo& newDir=newSnapshot.GetDirectories()[newIndex];
+    if(!newDir.treeHash.Empty()&&oldDir.treeHash==newDir.treeHash) {
+        return;
+    }
+
+    const PathTable& oldPaths=oldSnapshot.GetPathTable();
+    const PathTable& newPaths=newSnapshot.GetPathTable();
+
+    // 目录内文件已按名称排序
+    auto oldFiles=oldSnapshot.GetDirectoryFiles(oldDir);
+    auto newFiles=newSnapshot.GetDirectoryFiles(newDir);
+    size_t i=0,j=0;
+    while(i<oldFiles.size()||j<newFiles.size()) {
+        int order;
+        if(i==oldFiles.size()) order=1;
+        else if(j==newFiles.size()) order=-1;
+        else order=oldPaths.GetName(oldFiles[i].path).compare(newPaths.GetName(newFiles[j].path));
+
+        if(order<0) {
+            EmitFileChange(context,context.deletions,ChangeType::DELETED,oldSnapshot,oldFiles[i++],"diff_deleted");
+        }
+        else if(order>0) {
+            EmitFileChange(context,context.fileChanges,ChangeType::ADDED,newSnapshot,newFiles[j++],"diff_added");
         }
         else {
-            // 修改的检测
-			// FIXME: 文件移动的检测依赖于哈希匹配，但当前实现存在潜在缺陷：若多个文件内容相同（哈希碰撞或重复内容），可能会误判移动关系。
-            const FileInfo* oldFile=it->second;
-            if(oldFile->hash!=newFile.hash) {
-                ChangeRecord record;
-                record.type=ChangeType::MODIFIED;
-                record.path=newFile.path;
-                record.hash=newFile.hash;
-                record.size=newFile.size;
-                changes.push_back(record);
-                g_logger<<LANG("diff_modified")<<newFile.path<<std::endl;
+            const FileInfo& oldFile=oldFiles[i++];
+            const FileInfo& newFile=newFiles[j++];
+            // 不同算法产生的哈希无法比较，保守地视为修改
+            if(oldFile.hash.algorithm!=newFile.hash.algorithm&&!context.algorithmMismatchReported) {
+                g_logger<<"[WARNING] "<<LANG("warning_hash_algorithm_mismatch")
+                    <<HashProvider::AlgorithmName(oldFile.hash.algorithm)<<LANG("info_to")
+                    <<HashProvider::AlgorithmName(newFile.hash.algorithm)<<std::endl;
+                context.algorithmMismatchReported=true;
+            }
+            // 摘要比较包含算法标记
+            if(oldFile.hash!=newFile.hash) {
+                EmitFileChange(context,context.fileChanges,ChangeType::MODIFIED,newSnapshot,newFile,"diff_modified");
+                context.fileChanges.back().oldHash=oldFile.hash;
             }
         }
     }
 
-    // 删除的文件检测
-    for(const auto& oldFile:oldFiles) {
-        if(newFileMap.find(oldFile.path)==newFileMap.end()) {
-            ChangeRecord record;
-            record.type=ChangeType::DELETED;
-            record.path=oldFile.path;
-            record.hash=oldFile.hash;
-            record.size=oldFile.size;
-            changes.push_back(record);
-            g_logger<<LANG("diff_deleted")<<oldFile.path<<std::endl;
+    // 子目录下标按路径（即名称）排序
+    const auto& oldDirs=oldSnapshot.GetDirectories();
+    const auto& newDirs=newSnapshot.GetDirectories();
+    auto oldChildren=oldSnapshot.GetSubdirectories(oldDir);
+    auto newChildren=newSnapshot.GetSubdirectories(newDir);
+    i=0;
+    j=0;
+    while(i<oldChildren.size()||j<newChildren.size()) {
+        int order;
+        if(i==oldChildren.size()) order=1;
+        else if(j==newChildren.size()) order=-1;
+        else order=oldPaths.GetName(oldDirs[oldChildren[i]].path).compare(newPaths.GetName(newDirs[newChildren[j]].path));
+
+        if(order<0) {
+            DeleteSubtree(context,oldChildren[i++]);
+        }
+        else if(order>0) {
+            AddSubtree(context,newChildren[j++]);
+        }
+        else {
+            uint32_t oldChild=oldChildren[i++];
+            uint32_t newChild=newChildren[j++];
+            DiffDirectory(context,oldChild,newChild);
         }
     }
-    // 移动的文件检测
-    DetectFileMovements(oldFiles,newFiles,changes);
+}
 
-    // 构建新旧目录映射
-    std::unordered_map<std::string,const DirectoryInfo*> oldDirMap;
-    for(const auto& dir:oldDirs) {
-        oldDirMap[dir.path]=&dir;
-    }
+//主函数：从根目录开始同步遍历新旧两棵树，只进入 Merkle 哈希不同的子树，
+// 工作量与变更规模成正比，而不是与文件总数成正比
+std::vector<ChangeRecord> DiffEngine::CalculateDiff(
+    const Snapshot& oldSnapshot,
+    const Snapshot& newSnapshot) {
 
-    std::unordered_map<std::string,const DirectoryInfo*> newDirMap;
-    for(const auto& dir:newDirs) {
-        newDirMap[dir.path]=&dir;
-    }
+    g_logger<<LANG("diff_processing")<<std::endl;
 
-    // 检查新增和删除的空目录
-    for(const auto& newDir:newDirs) {
-        auto it=oldDirMap.find(newDir.path);
-        if(it==oldDirMap.end()&&newDir.files.empty()&&newDir.subdirectories.empty()) {
-            ChangeRecord record;
-            record.type=ChangeType::DIRECTORY_ADDED;
-            record.path=newDir.path;
-            changes.push_back(record);
-            g_logger<<LANG("info_directory_added")<<newDir.path<<std::endl;
-        }
+    //optimize: 日志输出冗余，当文件数量较多时会产生大量日志，考虑增加日志级别控制
+    TreeDiffContext context(oldSnapshot,newSnapshot,verbose);
+    const DirectoryInfo* oldRoot=oldSnapshot.GetRoot();
+    const DirectoryInfo* newRoot=newSnapshot.GetRoot();
+    if(oldRoot&&newRoot) {
+        DiffDirectory(context,0,0);
+    }
+    else if(newRoot) {
+        AddSubtree(context,0);
+    }
+    else if(oldRoot) {
+        DeleteSubtree(context,0);
     }
 
-    for(const auto& oldDir:oldDirs) {
-        if(newDirMap.find(oldDir.path)==newDirMap.end()&&
-            oldDir.files.empty()&&oldDir.subdirectories.empty()) {
-            ChangeRecord record;
-            record.type=ChangeType::DIRECTORY_DELETED;
-            record.path=oldDir.path;
-            changes.push_back(record);
-            g_logger<<LANG("info_directory_deleted")<<oldDir.path<<std::endl;
+    std::vector<ChangeRecord> changes=std::move(context.fileChanges);
+    changes.insert(changes.end(),
+        std::make_move_iterator(context.deletions.begin()),std::make_move_iterator(context.deletions.end()));
+
+    // 移动的文件检测：同时有新增和删除时才可能存在移动
+    bool hasAdded=false;
+    bool hasDeleted=!context.deletions.empty();
+    for(const auto& change:changes) {
+        if(change.type==ChangeType::ADDED) {
+            hasAdded=true;
+            break;
         }
     }
+    if(hasAdded&&hasDeleted) {
+        DetectFileMovements(changes);
+        // 内容也被修改的移动（如 foo-1.2.jar -> foo-1.3.jar）摘要不同，按相似度再配对一次
+        DetectSimilarMovements(changes);
+    }
+
+    changes.insert(changes.end(),
+        std::make_move_iterator(context.addedDirectories.begin()),std::make_move_iterator(context.addedDirectories.end()));
+    changes.insert(changes.end(),
+        std::make_move_iterator(context.deletedDirectories.begin()),std::make_move_iterator(context.deletedDirectories.end()));
 	//FIXEME : 非空目录的创建/删除不会产生变更记录，完全依赖文件条目。
     // 客户端虽然能通过文件路径隐式创建目录，但某些情况，若版本间目录由非空变为空（例如删光所有文件），现有逻辑不会生成 DIRECTORY_ADDED，导致客户端可能遗漏创建空目录。
     return changes;
 }
-// 检测文件移动
-//OPTIMIZE: 每次匹配哈希后，都要遍历 changes 查找对应的 DELETED 和 ADDED 记录，导致最坏 O(n*m) 复杂度（n 为新文件数，m 为变更记录数）。
-// 当变更量大时（如数万文件），性能急剧下降,现在只是对小文件没问题，以后务必修复。
-void DiffEngine::DetectFileMovements(
-    const std::vector<FileInfo>& oldFiles,
-    const std::vector<FileInfo>& newFiles,
-    std::vector<ChangeRecord>& changes) {
-
-    // 哈希
-    auto hashMap=BuildHashMap(oldFiles);
-
-    // 遍历新文件，检查是否有相同哈希的旧文件
-    for(const auto& newFile:newFiles) {
-        auto it=hashMap.find(newFile.hash);
-        if(it!=hashMap.end()&&!it->second.empty()) {
-            // 找到相同哈希的旧文件
-            const FileInfo* oldFile=it->second[0];
-
-            // 确保路径不同，新文件被标记为新增，旧文件被标记为删除
-            if(oldFile->path!=newFile.path) {
-				// 新增和删除标记的检测
-                // FIXME: 当多个旧文件哈希相同时（如重复空白文件），只取第一个匹配可能容易出问题。
-                auto deleteIt=std::find_if(changes.begin(),changes.end(),
-                    [&](const ChangeRecord& r) {
-                        return r.type==ChangeType::DELETED&&r.path==oldFile->path;
-                    });
-
-                auto addIt=std::find_if(changes.begin(),changes.end(),
-                    [&](const ChangeRecord& r) {
-                        return r.type==ChangeType::ADDED&&r.path==newFile.path;
-                    });
-                // HACK: 当前 deleteIt 在 erase 后未被使用，因此迭代器失效无影响。
-                //       但若将来代码修改后误用，可能会未定义，头大。
-                //       以后务必修改，可能算一个严重bug。
-                if(deleteIt!=changes.end()&&addIt!=changes.end()) {
-					// 修改成移动
-                    deleteIt->type=ChangeType::MOVED;
-                    deleteIt->oldPath=oldFile->path;
-                    changes.erase(addIt); 
-
-                    g_logger<<LANG("info_moved")<<oldFile->path<<LANG("info_to")<<newFile.path<<std::endl;
-                }
-            }
+// 检测文件移动：按摘要把 DELETED 记录分桶，ADDED 记录只查一次桶，整体 O(n)。
+// 同一内容有多个候选时（重复文件、空文件），按记录顺序（即路径顺序）一一配对，结果确定；
+// 多出来的记录保持新增/删除。被合并的 ADDED 记录先做标记，最后统一压缩，不在中途 erase。
+void DiffEngine::DetectFileMovements(std::vector<ChangeRecord>& changes) {
+    struct MoveBucket {
+        std::vector<size_t> deleted;
+        size_t nextDeleted=0;
+    };
+    std::unordered_map<Digest,MoveBucket,DigestHash> buckets;
+    for(size_t i=0; i<changes.size(); ++i) {
+        const ChangeRecord& change=changes[i];
+        if(change.type==ChangeType::DELETED&&!change.hash.Empty()) {
+            buckets[change.hash].deleted.push_back(i);
+        }
+    }
+    if(buckets.empty()) {
+        return;
+    }
+
+    std::vector<bool> merged(changes.size(),false);
+    size_t movedCount=0;
+    for(size_t i=0; i<changes.size(); ++i) {
+        ChangeRecord& added=changes[i];
+        if(added.type!=ChangeType::ADDED||added.hash.Empty()) {
+            continue;
+        }
+        auto it=buckets.find(added.hash);
+        if(it==buckets.end()||it->second.nextDeleted==it->second.deleted.size()) {
+            continue;
+        }
+
+        // DELETED 记录原地改为 MOVED：path 为新路径，oldPath 为原路径
+        ChangeRecord& moved=changes[it->second.deleted[it->second.nextDeleted++]];
+        moved.type=ChangeType::MOVED;
+        moved.oldPath=std::move(moved.path);
+        moved.path=std::move(added.path);
+        moved.size=added.size;
+        merged[i]=true;
+        ++movedCount;
+
+        if(verbose) {
+            g_logger<<LANG("info_moved")<<moved.oldPath<<LANG("info_to")<<moved.path<<std::endl;
+        }
+    }
+    if(movedCount==0) {
+        return;
+    }
+
+    size_t write=0;
+    for(size_t read=0; read<changes.size(); ++read) {
+        if(merged[read]) {
+            continue;
+        }
+        if(write!=read) {
+            changes[write]=std::move(changes[read]);
+        }
+        ++write;
+    }
+    changes.resize(write);
+}
+
+// 相似度配对的参数
+static const size_t kMaxSimilarCandidates=32;    // 每个新增文件最多比较的候选数，防止同名文件过多时退化
+static const double kMinSizeRatio=0.5;           // 大小相差超过一倍不认为是同一文件
+static const double kMinChunkOverlap=0.2;        // 能比较内容时，分块重合度低于此值直接排除
+static const size_t kChunkMinSize=2*1024;        // 相似度比较用较小的分块（平均 8KB），小文件也有足够的分块
+static const size_t kChunkAverageSize=8*1024;
+static const size_t kChunkMaxSize=64*1024;
+static const size_t kMinComparableChunks=4;      // 分块太少（小文件）时重合度没有意义，只按文件名和大小判断
+
+static std::string FileNameOf(const std::string& path) {
+    size_t slash=path.find_last_of('/');
+    return slash==std::string::npos?path:path.substr(slash+1);
+}
+
+static std::string DirectoryOf(const std::string& path) {
+    size_t slash=path.find_last_of('/');
+    return slash==std::string::npos?std::string():path.substr(0,slash);
+}
+
+// 文件名去掉版本号后的"词干"：主名中的数字和 -_.+ 全部去掉并转小写，保留扩展名。
+// foo-1.2.jar 与 foo-1.3.jar 的词干都是 foo.jar；主名只剩版本号时返回空，不参与配对
+static std::string SimilarityStem(const std::string& fileName) {
+    size_t dot=fileName.find_last_of('.');
+    std::string base=dot==std::string::npos?fileName:fileName.substr(0,dot);
+    std::string extension=dot==std::string::npos?std::string():fileName.substr(dot);
+
+    std::string stem;
+    for(char c:base) {
+        unsigned char uc=static_cast<unsigned char>(c);
+        if(std::isdigit(uc)||c=='-'||c=='_'||c=='.'||c=='+') {
+            continue;
+        }
+        stem.push_back(static_cast<char>(std::tolower(uc)));
+    }
+    if(stem.empty()) {
+        return stem;
+    }
+    for(char& c:extension) {
+        c=static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return stem+extension;
+}
+
+// 内容定义分块后的分块指纹（排好序、去重），用于估计两份内容的重合度
+static std::vector<uint64_t> ChunkFingerprints(const unsigned char* data,size_t size) {
+    static const Chunker chunker([] {
+        ChunkerParams params;
+        params.minSize=kChunkMinSize;
+        params.averageSize=kChunkAverageSize;
+        params.maxSize=kChunkMaxSize;
+        return params;
+    }());
+    std::vector<uint64_t> fingerprints;
+    chunker.Split(data,size,[&](size_t offset,size_t length) {
+        fingerprints.push_back(XXH3_64bits(data+offset,length));
+        });
+    std::sort(fingerprints.begin(),fingerprints.end());
+    fingerprints.erase(std::unique(fingerprints.begin(),fingerprints.end()),fingerprints.end());
+    return fingerprints;
+}
+
+// 两组分块指纹的 Jaccard 系数
+static double ChunkJaccard(const std::vector<uint64_t>& a,const std::vector<uint64_t>& b) {
+    if(a.empty()&&b.empty()) {
+        return 1.0;
+    }
+    size_t common=0;
+    size_t i=0,j=0;
+    while(i<a.size()&&j<b.size()) {
+        if(a[i]<b[j]) ++i;
+        else if(b[j]<a[i]) ++j;
+        else {
+            ++common;
+            ++i;
+            ++j;
         }
     }
+    return static_cast<double>(common)/static_cast<double>(a.size()+b.size()-common);
 }
-// 哈希映射到列表
-//FIXME: 实现太简单了，只匹配了哈希，如果有人用md5这样的哈希应该会出问题吧
-std::unordered_map<std::string,std::vector<const FileInfo*>>
-DiffEngine::BuildHashMap(const std::vector<FileInfo>& files) {
-    std::unordered_map<std::string,std::vector<const FileInfo*>> hashMap;
 
-    for(const auto& file:files) {
-        hashMap[file.hash].push_back(&file);
+// 检测移动并修改的文件：只处理精确移动检测后剩下的 DELETED/ADDED。
+// 候选来自同名文件和同词干文件（去掉版本号），先用大小比例过滤，再按
+// 文件名匹配程度、是否同目录、大小接近程度打分；能取到新旧内容时再加上分块重合度。
+// 按 ADDED 记录顺序贪心选择得分最高的候选，同分取路径顺序靠前的，结果确定。
+void DiffEngine::DetectSimilarMovements(std::vector<ChangeRecord>& changes) {
+    std::unordered_map<std::string,std::vector<size_t>> byName;
+    std::unordered_map<std::string,std::vector<size_t>> byStem;
+    bool hasAdded=false;
+    for(size_t i=0; i<changes.size(); ++i) {
+        const ChangeRecord& change=changes[i];
+        if(change.type==ChangeType::ADDED) {
+            hasAdded=true;
+        }
+        if(change.type!=ChangeType::DELETED) {
+            continue;
+        }
+        std::string name=FileNameOf(change.path);
+        std::string stem=SimilarityStem(name);
+        byName[name].push_back(i);
+        if(!stem.empty()) {
+            byStem[stem].push_back(i);
+        }
+    }
+    if(!hasAdded||byName.empty()) {
+        return;
     }
 
-    return hashMap;
+    // 分块指纹按摘要缓存，同一内容只读取一次；取不到内容的摘要记为 nullptr
+    std::unordered_map<Digest,std::unique_ptr<std::vector<uint64_t>>,DigestHash> chunkCache;
+    auto fingerprintsOf=[&](const Digest& hash)->const std::vector<uint64_t>* {
+        auto it=chunkCache.find(hash);
+        if(it!=chunkCache.end()) {
+            return it->second.get();
+        }
+        std::unique_ptr<std::vector<uint64_t>> fingerprints;
+        std::string contentPath=contentResolver(hash);
+        MappedFile file;
+        if(!contentPath.empty()&&file.Open(contentPath)) {
+            fingerprints=std::make_unique<std::vector<uint64_t>>(ChunkFingerprints(file.GetData(),file.GetSize()));
+        }
+        return chunkCache.emplace(hash,std::move(fingerprints)).first->second.get();
+    };
+
+    std::vector<bool> taken(changes.size(),false);
+    std::vector<bool> merged(changes.size(),false);
+    std::vector<size_t> candidates;
+    size_t movedCount=0;
+    for(size_t i=0; i<changes.size(); ++i) {
+        ChangeRecord& added=changes[i];
+        if(added.type!=ChangeType::ADDED) {
+            continue;
+        }
+        std::string name=FileNameOf(added.path);
+        std::string stem=SimilarityStem(name);
+
+        candidates.clear();
+        auto collect=[&](const std::unordered_map<std::string,std::vector<size_t>>& index,const std::string& key) {
+            auto it=index.find(key);
+            if(it==index.end()) {
+                return;
+            }
+            for(size_t candidate:it->second) {
+                if(candidates.size()>=kMaxSimilarCandidates) {
+                    return;
+                }
+                if(!taken[candidate]) {
+                    candidates.push_back(candidate);
+                }
+            }
+        };
+        collect(byName,name);
+        if(!stem.empty()) {
+            collect(byStem,stem);
+        }
+        if(candidates.empty()) {
+            continue;
+        }
+
+        std::string directory=DirectoryOf(added.path);
+        size_t best=0;
+        double bestScore=-1.0;
+        for(size_t candidate:candidates) {
+            const ChangeRecord& deleted=changes[candidate];
+            uint64_t smaller=std::min(deleted.size,added.size);
+            uint64_t larger=std::max(deleted.size,added.size);
+            double sizeRatio=larger==0?1.0:static_cast<double>(smaller)/static_cast<double>(larger);
+            if(sizeRatio<kMinSizeRatio) {
+                continue;
+            }
+
+            std::string deletedName=FileNameOf(deleted.path);
+            double score=(deletedName==name?3.0:2.0)+sizeRatio;
+            if(DirectoryOf(deleted.path)==directory) {
+                score+=1.0;
+            }
+            if(contentResolver&&!deleted.hash.Empty()&&!added.hash.Empty()) {
+                const std::vector<uint64_t>* oldChunks=fingerprintsOf(deleted.hash);
+                const std::vector<uint64_t>* newChunks=oldChunks?fingerprintsOf(added.hash):nullptr;
+                if(oldChunks&&newChunks&&
+                    std::min(oldChunks->size(),newChunks->size())>=kMinComparableChunks) {
+                    double overlap=ChunkJaccard(*oldChunks,*newChunks);
+                    if(overlap<kMinChunkOverlap) {
+                        continue;
+                    }
+                    score+=4.0*overlap;
+                }
+            }
+            if(score>bestScore||(score==bestScore&&candidate<best)) {
+                bestScore=score;
+                best=candidate;
+            }
+        }
+        if(bestScore<0) {
+            continue;
+        }
+
+        // 与精确移动相同，DELETED 记录原地改为 MOVED，并保留原摘要供生成差分补丁
+        ChangeRecord& moved=changes[best];
+        moved.type=ChangeType::MOVED;
+        moved.oldPath=std::move(moved.path);
+        moved.oldHash=moved.hash;
+        moved.path=std::move(added.path);
+        moved.hash=added.hash;
+        moved.size=added.size;
+        taken[best]=true;
+        merged[i]=true;
+        ++movedCount;
+
+        if(verbose) {
+            g_logger<<LANG("info_moved_modified")<<moved.oldPath<<LANG("info_to")<<moved.path<<std::endl;
+        }
+    }
+    if(movedCount==0) {
+        return;
+    }
+
+    size_t write=0;
+    for(size_t read=0; read<changes.size(); ++read) {
+        if(merged[read]) {
+            continue;
+        }
+        if(write!=read) {
+            changes[write]=std::move(changes[read]);
+        }
+        ++write;
+    }
+    changes.resize(write);
 }
 //manifest记录
 //NOTE: 这里未考虑跨平台，譬如路径分隔符等问题，未来做的话需要改进。
@@ -191,7 +526,7 @@ std::string DiffEngine::GenerateManifest(const std::vector<ChangeRecord>& change
         oss<<typeStr<<":"
             <<change.path<<":"
             <<change.oldPath<<":"
-            <<change.hash<<":"
+            <<change.hash.ToHex()<<":"
             <<change.size<<"\n";
     }
 
@@ -234,8 +569,9 @@ std::vector<ChangeRecord> DiffEngine::ParseManifest(const std::string& manifest)
                 record.oldPath=tokens[2];
             }
 
+            // 清单不记录算法，解析出的摘要只能用于与同一清单内的记录比较
             if(tokens.size()>3) {
-                record.hash=tokens[3];
+                record.hash=Digest::FromHex(tokens[3],HashAlgorithm::Unknown);
             }
 
             if(tokens.size()>4) {
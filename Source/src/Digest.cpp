@@ -0,0 +1,58 @@
+﻿#include "Digest.h"
+
+// 每个字节对应两个十六进制字符的查表编码，避免 stringstream + setw/setfill 的逐字节格式化
+static const char kHexPairs[]=
+    "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+    "202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+    "404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+    "606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+    "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+    "a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+    "c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+    "e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+
+static int HexValue(char c) {
+    if(c>='0'&&c<='9') return c-'0';
+    if(c>='a'&&c<='f') return c-'a'+10;
+    if(c>='A'&&c<='F') return c-'A'+10;
+    return -1;
+}
+
+std::string Digest::ToHex() const {
+    std::string hex(static_cast<size_t>(length)*2,'0');
+    for(size_t i=0; i<length; ++i) {
+        hex[i*2]=kHexPairs[bytes[i]*2];
+        hex[i*2+1]=kHexPairs[bytes[i]*2+1];
+    }
+    return hex;
+}
+
+Digest Digest::FromHex(const std::string& hex,HashAlgorithm algorithm) {
+    Digest digest;
+    if(hex.empty()||hex.size()%2!=0||hex.size()/2>kMaxLength) {
+        return digest;
+    }
+
+    for(size_t i=0; i<hex.size()/2; ++i) {
+        int high=HexValue(hex[i*2]);
+        int low=HexValue(hex[i*2+1]);
+        if(high<0||low<0) {
+            return Digest();
+        }
+        digest.bytes[i]=static_cast<uint8_t>((high<<4)|low);
+    }
+    digest.length=static_cast<uint8_t>(hex.size()/2);
+    digest.algorithm=algorithm;
+    return digest;
+}
+
+Digest Digest::FromBytes(const uint8_t* data,size_t size,HashAlgorithm algorithm) {
+    Digest digest;
+    if(size>kMaxLength) {
+        return digest;
+    }
+    std::memcpy(digest.bytes.data(),data,size);
+    digest.length=static_cast<uint8_t>(size);
+    digest.algorithm=algorithm;
+    return digest;
+}
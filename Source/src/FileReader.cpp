@@ -0,0 +1,339 @@
+﻿#include "FileReader.h"
+#include <cstdio>
+#include <cerrno>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+static std::wstring Utf8ToWide(const std::string& utf8) {
+    if(utf8.empty()) return L"";
+    int wlen=MultiByteToWideChar(CP_UTF8,0,utf8.c_str(),-1,nullptr,0);
+    if(wlen<=0) return L"";
+    std::wstring wstr(wlen-1,0);
+    MultiByteToWideChar(CP_UTF8,0,utf8.c_str(),-1,&wstr[0],wlen);
+    return wstr;
+}
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// mmap 路径每次交给消费者的块大小，避免一次性对整个映射区计算导致缺页集中爆发
+static const size_t kMappedChunkSize=8*1024*1024;
+
+bool FileReader::Read(const std::string& filePath,const ReadOptions& options,const ChunkConsumer& consumer) {
+    ReadStrategy strategy=options.strategy;
+    if(strategy==ReadStrategy::Auto) {
+        std::error_code ec;
+        uint64_t size=std::filesystem::file_size(std::filesystem::u8path(filePath),ec);
+        if(ec) {
+            return false;
+        }
+        strategy=size>=options.mmapThreshold?ReadStrategy::Mmap:ReadStrategy::Buffered;
+    }
+
+    switch(strategy) {
+    case ReadStrategy::Stream: return ReadStream(filePath,options,consumer);
+    case ReadStrategy::Mmap: return ReadMapped(filePath,options,consumer);
+    default: return ReadBuffered(filePath,options,consumer);
+    }
+}
+
+ReadStrategy FileReader::ParseStrategy(const std::string& name) {
+    if(name=="stream") return ReadStrategy::Stream;
+    if(name=="buffered") return ReadStrategy::Buffered;
+    if(name=="mmap") return ReadStrategy::Mmap;
+    return ReadStrategy::Auto;
+}
+
+const char* FileReader::StrategyName(ReadStrategy strategy) {
+    switch(strategy) {
+    case ReadStrategy::Stream: return "stream";
+    case ReadStrategy::Buffered: return "buffered";
+    case ReadStrategy::Mmap: return "mmap";
+    default: return "auto";
+    }
+}
+
+bool FileReader::ReadStream(const std::string& filePath,const ReadOptions& options,const ChunkConsumer& consumer) {
+#ifdef _WIN32
+    std::wstring wFilePath=Utf8ToWide(filePath);
+    FILE* file=_wfopen(wFilePath.c_str(),L"rb");
+#else
+    FILE* file=fopen(filePath.c_str(),"rb");
+#endif
+    if(!file) {
+        return false;
+    }
+
+    std::vector<unsigned char> buffer(options.bufferSize>0?options.bufferSize:8192);
+    size_t bytesRead;
+    while((bytesRead=fread(buffer.data(),1,buffer.size(),file))>0) {
+        consumer(buffer.data(),bytesRead);
+    }
+
+    bool ok=!ferror(file);
+    fclose(file);
+    return ok;
+}
+
+#ifdef _WIN32
+bool FileReader::ReadBuffered(const std::string& filePath,const ReadOptions& options,const ChunkConsumer& consumer) {
+    std::wstring wFilePath=Utf8ToWide(filePath);
+    HANDLE handle=CreateFileW(wFilePath.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,
+        OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,nullptr);
+    if(handle==INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    // 小文件不必分配完整的大缓冲区（多一个字节用于一次读到 EOF）
+    size_t bufferSize=options.bufferSize>0?options.bufferSize:8192;
+    LARGE_INTEGER size;
+    if(GetFileSizeEx(handle,&size)&&static_cast<uint64_t>(size.QuadPart)<bufferSize) {
+        bufferSize=static_cast<size_t>(size.QuadPart)+1;
+    }
+    std::unique_ptr<unsigned char[]> buffer(new unsigned char[bufferSize]);
+    bool ok=true;
+    while(true) {
+        DWORD bytesRead=0;
+        if(!ReadFile(handle,buffer.get(),static_cast<DWORD>(bufferSize),&bytesRead,nullptr)) {
+            ok=false;
+            break;
+        }
+        if(bytesRead==0) {
+            break;
+        }
+        consumer(buffer.get(),bytesRead);
+    }
+
+    CloseHandle(handle);
+    return ok;
+}
+
+bool FileReader::ReadMapped(const std::string& filePath,const ReadOptions& options,const ChunkConsumer& consumer) {
+    std::wstring wFilePath=Utf8ToWide(filePath);
+    HANDLE handle=CreateFileW(wFilePath.c_str(),GENERIC_READ,FILE_SHARE_READ,nullptr,
+        OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,nullptr);
+    if(handle==INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(handle,&size)) {
+        CloseHandle(handle);
+        return false;
+    }
+    // 空文件无法建立映射
+    if(size.QuadPart==0) {
+        CloseHandle(handle);
+        return true;
+    }
+
+    HANDLE mapping=CreateFileMappingW(handle,nullptr,PAGE_READONLY,0,0,nullptr);
+    if(!mapping) {
+        CloseHandle(handle);
+        return ReadBuffered(filePath,options,consumer);
+    }
+
+    const unsigned char* data=static_cast<const unsigned char*>(MapViewOfFile(mapping,FILE_MAP_READ,0,0,0));
+    if(!data) {
+        CloseHandle(mapping);
+        CloseHandle(handle);
+        return ReadBuffered(filePath,options,consumer);
+    }
+
+    uint64_t total=static_cast<uint64_t>(size.QuadPart);
+    for(uint64_t offset=0; offset<total; offset+=kMappedChunkSize) {
+        size_t length=static_cast<size_t>(std::min<uint64_t>(kMappedChunkSize,total-offset));
+        consumer(data+offset,length);
+    }
+
+    UnmapViewOfFile(data);
+    CloseHandle(mapping);
+    CloseHandle(handle);
+    return true;
+}
+#else
+// 读完后告诉内核这些页不再需要，扫描几十 GB 的工作空间时不会把 Web 服务依赖的页缓存挤掉
+static void DropPageCache(int fd,const ReadOptions& options) {
+#ifdef POSIX_FADV_DONTNEED
+    if(options.dropCache) {
+        posix_fadvise(fd,0,0,POSIX_FADV_DONTNEED);
+    }
+#else
+    (void)fd;
+    (void)options;
+#endif
+}
+
+bool FileReader::ReadBuffered(const std::string& filePath,const ReadOptions& options,const ChunkConsumer& consumer) {
+    int fd=open(filePath.c_str(),O_RDONLY);
+    if(fd<0) {
+        return false;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(fd,0,0,POSIX_FADV_SEQUENTIAL);
+#endif
+
+    // 小文件不必分配完整的大缓冲区（多一个字节用于一次读到 EOF）
+    size_t bufferSize=options.bufferSize>0?options.bufferSize:8192;
+    struct stat st;
+    if(fstat(fd,&st)==0&&static_cast<uint64_t>(st.st_size)<bufferSize) {
+        bufferSize=static_cast<size_t>(st.st_size)+1;
+    }
+    std::unique_ptr<unsigned char[]> buffer(new unsigned char[bufferSize]);
+    off_t offset=0;
+    bool ok=true;
+    while(true) {
+        ssize_t bytesRead=pread(fd,buffer.get(),bufferSize,offset);
+        if(bytesRead<0) {
+            if(errno==EINTR) {
+                continue;
+            }
+            ok=false;
+            break;
+        }
+        if(bytesRead==0) {
+            break;
+        }
+        consumer(buffer.get(),static_cast<size_t>(bytesRead));
+        offset+=bytesRead;
+    }
+
+    DropPageCache(fd,options);
+    close(fd);
+    return ok;
+}
+
+bool FileReader::ReadMapped(const std::string& filePath,const ReadOptions& options,const ChunkConsumer& consumer) {
+    int fd=open(filePath.c_str(),O_RDONLY);
+    if(fd<0) {
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd,&st)!=0) {
+        close(fd);
+        return false;
+    }
+    // 空文件无法建立映射
+    if(st.st_size==0) {
+        close(fd);
+        return true;
+    }
+
+    size_t total=static_cast<size_t>(st.st_size);
+    void* mapped=mmap(nullptr,total,PROT_READ,MAP_PRIVATE,fd,0);
+    if(mapped==MAP_FAILED) {
+        close(fd);
+        return ReadBuffered(filePath,options,consumer);
+    }
+    madvise(mapped,total,MADV_SEQUENTIAL);
+
+    const unsigned char* data=static_cast<const unsigned char*>(mapped);
+    for(size_t offset=0; offset<total; offset+=kMappedChunkSize) {
+        consumer(data+offset,std::min(kMappedChunkSize,total-offset));
+    }
+
+    munmap(mapped,total);
+    DropPageCache(fd,options);
+    close(fd);
+    return true;
+}
+#endif
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& filePath) {
+    Close();
+    std::wstring wFilePath=Utf8ToWide(filePath);
+    HANDLE handle=CreateFileW(wFilePath.c_str(),GENERIC_READ,FILE_SHARE_READ|FILE_SHARE_DELETE,nullptr,
+        OPEN_EXISTING,FILE_FLAG_RANDOM_ACCESS,nullptr);
+    if(handle==INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(handle,&fileSize)) {
+        CloseHandle(handle);
+        return false;
+    }
+    fileHandle=handle;
+    opened=true;
+    // 空文件无法建立映射
+    if(fileSize.QuadPart==0) {
+        return true;
+    }
+
+    HANDLE mapping=CreateFileMappingW(handle,nullptr,PAGE_READONLY,0,0,nullptr);
+    if(!mapping) {
+        Close();
+        return false;
+    }
+    mappingHandle=mapping;
+    data=static_cast<const unsigned char*>(MapViewOfFile(mapping,FILE_MAP_READ,0,0,0));
+    if(!data) {
+        Close();
+        return false;
+    }
+    size=static_cast<size_t>(fileSize.QuadPart);
+    return true;
+}
+
+void MappedFile::Close() {
+    if(data) {
+        UnmapViewOfFile(data);
+    }
+    if(mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if(fileHandle) {
+        CloseHandle(fileHandle);
+    }
+    data=nullptr;
+    size=0;
+    mappingHandle=nullptr;
+    fileHandle=nullptr;
+    opened=false;
+}
+#else
+bool MappedFile::Open(const std::string& filePath) {
+    Close();
+    int fd=open(filePath.c_str(),O_RDONLY);
+    if(fd<0) {
+        return false;
+    }
+
+    struct stat st;
+    if(fstat(fd,&st)!=0) {
+        close(fd);
+        return false;
+    }
+    // 映射建立后即可关闭描述符；空文件无法建立映射
+    if(st.st_size>0) {
+        void* mapped=mmap(nullptr,static_cast<size_t>(st.st_size),PROT_READ,MAP_SHARED,fd,0);
+        if(mapped==MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        data=static_cast<const unsigned char*>(mapped);
+        size=static_cast<size_t>(st.st_size);
+    }
+    close(fd);
+    opened=true;
+    return true;
+}
+
+void MappedFile::Close() {
+    if(data) {
+        munmap(const_cast<unsigned char*>(data),size);
+    }
+    data=nullptr;
+    size=0;
+    opened=false;
+}
+#endif
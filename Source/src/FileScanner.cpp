@@ -1,13 +1,19 @@
 ﻿#include "FileScanner.h"
+#include "HashCache.h"
+#include "HashProvider.h"
 #include "Language.h"
 #include <fstream>
-#include <iomanip>
 #include <sstream>
 #include <iostream>
-#include <openssl/sha.h>
-#include <openssl/md5.h>
 #include <filesystem>
 #include <chrono>
+#include <algorithm>
+#include <unordered_set>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <sys/stat.h>
 #include "Logger.h"
 
 #ifdef _WIN32
@@ -31,13 +37,133 @@ static std::string WideToUtf8(const std::wstring& wide) {
 }
 #endif
 
-FileScanner::FileScanner(const std::string& workspace,const std::string& hashAlgorithm)
-    : workspace(workspace),hashAlgorithm(hashAlgorithm) {
+// 获取文件的 inode，作为哈希缓存键的一部分，防止文件被同大小同时间的新文件替换后误命中。
+// Windows 下取文件索引需要额外打开句柄，代价接近读取小文件本身，因此返回 0，仅依赖路径/大小/时间。
+static uint64_t GetFileInode(const std::string& fullPath) {
+#ifdef _WIN32
+    (void)fullPath;
+    return 0;
+#else
+    struct stat st;
+    if(stat(fullPath.c_str(),&st)!=0) {
+        return 0;
+    }
+    return static_cast<uint64_t>(st.st_ino);
+#endif
+}
+
+// 并行哈希流水线：目录遍历线程投递任务，工作线程并发计算哈希。
+// 队列有界，遍历快于磁盘/CPU 时投递方会阻塞，避免一次性堆积几十万个路径字符串。
+// 每个工作线程把结果写入自己的结果表，遍历期间不触碰 files，结束后再按下标合并。
+class HashPipeline {
+public:
+    HashPipeline(HashAlgorithm algorithm,const ReadOptions& readOptions,unsigned workerCount,size_t capacity)
+        : algorithm(algorithm),readOptions(readOptions),capacity(capacity),results(workerCount) {
+        for(unsigned i=0; i<workerCount; ++i) {
+            workers.emplace_back(&HashPipeline::WorkerLoop,this,i);
+        }
+    }
+
+    ~HashPipeline() {
+        Close();
+    }
+
+    void Submit(size_t index,std::string fullPath) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock,[this]() { return queue.size()<capacity; });
+        queue.push_back({index,std::move(fullPath)});
+        lock.unlock();
+        notEmpty.notify_one();
+    }
+
+    // 关闭队列并等待所有任务完成，返回 (files 下标, 摘要)
+    std::vector<std::pair<size_t,Digest>> Finish() {
+        Close();
+        std::vector<std::pair<size_t,Digest>> merged;
+        for(auto& workerResults:results) {
+            merged.insert(merged.end(),
+                std::make_move_iterator(workerResults.begin()),
+                std::make_move_iterator(workerResults.end()));
+            workerResults.clear();
+        }
+        return merged;
+    }
+
+private:
+    struct Job {
+        size_t index;
+        std::string fullPath;
+    };
+
+    void Close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed=true;
+        }
+        notEmpty.notify_all();
+        for(auto& worker:workers) {
+            if(worker.joinable()) {
+                worker.join();
+            }
+        }
+    }
+
+    void WorkerLoop(size_t workerId) {
+        while(true) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                notEmpty.wait(lock,[this]() { return closed||!queue.empty(); });
+                if(queue.empty()) {
+                    return;
+                }
+                job=std::move(queue.front());
+                queue.pop_front();
+            }
+            notFull.notify_one();
+
+            results[workerId].emplace_back(job.index,FileScanner::CalculateFileDigest(job.fullPath,algorithm,readOptions));
+        }
+    }
+
+    HashAlgorithm algorithm;
+    ReadOptions readOptions;
+    size_t capacity;
+    std::deque<Job> queue;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    bool closed=false;
+    std::vector<std::thread> workers;
+    std::vector<std::vector<std::pair<size_t,Digest>>> results;
+};
+
+FileScanner::FileScanner(const std::string& workspace,const std::string& hashAlgorithm,int threadCount)
+    : workspace(workspace),hashAlgorithm(hashAlgorithm),threadCount(threadCount),
+    hashAlgorithmId(HashProvider::ParseAlgorithm(hashAlgorithm)) {
 }
 
+FileScanner::~FileScanner()=default;
+
 bool FileScanner::Scan() {
-    files.clear();
-    directories.clear();
+    return RunScan(nullptr);
+}
+
+bool FileScanner::ScanIncremental(const std::vector<std::string>& dirtyPaths) {
+    if(!hasScanned) {
+        return Scan();
+    }
+    return RunScan(&dirtyPaths);
+}
+
+// dirtyPaths 为空指针时完整扫描，否则在上一次结果的基础上只重扫脏路径
+bool FileScanner::RunScan(const std::vector<std::string>* dirtyPaths) {
+    fileInodes.clear();
+    if(!dirtyPaths) {
+        snapshot.Clear();
+        snapshot.SetHashAlgorithm(hashAlgorithmId);
+    }
+    hasScanned=false;
 
     if(!std::filesystem::exists(workspace)) {
         g_logger<<LANG("error_scan")<<": "<<LANG("error_file_not_found")<<": "<<workspace<<std::endl;
@@ -45,34 +171,104 @@ bool FileScanner::Scan() {
     }
 
     g_logger<<LANG("scan_start")<<": "<<workspace<<std::endl;
+    if(hashCache) {
+        hashCache->BeginScan();
+    }
+
+    unsigned workerCount=threadCount>0?
+        static_cast<unsigned>(threadCount):
+        std::thread::hardware_concurrency();
+    if(workerCount==0) {
+        workerCount=1;
+    }
+    g_logger<<LANG("info_scan_threads")<<workerCount<<std::endl;
 
     try {
-        ScanDirectory(workspace);
-        g_logger<<LANG("scan_complete")<<": "<<files.size()<<" files, "<<directories.size()<<" directories"<<std::endl;
+        // 单线程时直接在遍历线程内计算，不启动流水线
+        if(workerCount>1) {
+            hashPipeline=std::make_unique<HashPipeline>(hashAlgorithmId,readOptions,workerCount,workerCount*64);
+        }
+
+        if(dirtyPaths) {
+            g_logger<<LANG("info_incremental_scan")<<dirtyPaths->size()<<std::endl;
+            RescanDirtyPaths(*dirtyPaths);
+        }
+        else {
+            ScanDirectory(workspace);
+        }
+
+        if(hashPipeline) {
+            for(const auto& [index,hash]:hashPipeline->Finish()) {
+                snapshot.GetMutableFile(index).hash=hash;
+            }
+            hashPipeline.reset();
+        }
+        // 回写缓存依赖追加顺序的下标，必须在 Finalize 重排之前完成
+        UpdateHashCache();
+        snapshot.Finalize();
+
+        g_logger<<LANG("scan_complete")<<": "<<snapshot.GetFiles().size()<<" files, "
+            <<snapshot.GetDirectories().size()<<" directories"<<std::endl;
+        hasScanned=true;
         return true;
     }
     catch(const std::exception& e) {
+        hashPipeline.reset();
         g_logger<<LANG("error_scan")<<": "<<e.what()<<std::endl;
         return false;
     }
 }
-//FIXME: 每个 FileInfo 包含完整路径、哈希、大小等，在 DirectoryInfo 中重复存储，导致内存膨胀。
-// 若文件数量巨大，可能成为瓶颈。
-void FileScanner::ScanDirectory(const std::filesystem::path& currentPath,const std::string& relativePath) {
-    DirectoryInfo dirInfo;
-    dirInfo.path=relativePath;
+
+// 把本次扫描的结果写回哈希缓存并落盘
+void FileScanner::UpdateHashCache() {
+    if(!hashCache) {
+        fileInodes.clear();
+        return;
+    }
+
+    const auto& files=snapshot.GetFiles();
+    for(size_t i=0; i<files.size()&&i<fileInodes.size(); ++i) {
+        const FileInfo& file=files[i];
+        if(fileInodes[i]==kCarriedOver) {
+            hashCache->Keep(snapshot.GetPath(file.path));
+            continue;
+        }
+        hashCache->Store(snapshot.GetPath(file.path),file.size,file.modifiedTime,fileInodes[i],file.hash);
+    }
+    fileInodes.clear();
+
+    g_logger<<LANG("info_hash_cache_hits")<<hashCache->GetHits()<<"/"
+        <<(hashCache->GetHits()+hashCache->GetMisses())<<std::endl;
+    if(!hashCache->Save()) {
+        g_logger<<"[WARNING] "<<LANG("error_save_hash_cache")<<std::endl;
+    }
+}
+
+// 文件记录只追加到快照中一次，目录不再保存副本，由 Snapshot::Finalize 统一分组
+void FileScanner::ScanDirectory(const std::filesystem::path& currentPath,const std::string& relativePath,
+    PathId directoryId) {
+    PathTable& paths=snapshot.GetPathTable();
+    snapshot.AddDirectory(directoryId);
 
     try {
+        // 先收集再按名称排序，保证不同文件系统下 files/directories 的顺序一致
+        std::vector<std::pair<std::string,std::filesystem::directory_entry>> entries;
 #ifdef _WIN32
         // Windows下使用宽字符处理目录遍历
         std::wstring wCurrentPath=Utf8ToWide(currentPath.string());
         for(const auto& entry:std::filesystem::directory_iterator(wCurrentPath)) {
-            std::string entryName=WideToUtf8(entry.path().filename().wstring());
+            entries.emplace_back(WideToUtf8(entry.path().filename().wstring()),entry);
+        }
 #else
         for(const auto& entry:std::filesystem::directory_iterator(currentPath)) {
-            std::string entryName=entry.path().filename().string();
+            entries.emplace_back(entry.path().filename().string(),entry);
+        }
 #endif
+        std::sort(entries.begin(),entries.end(),[](const auto& a,const auto& b) {
+            return a.first<b.first;
+            });
 
+        for(const auto& [entryName,entry]:entries) {
             std::string entryRelativePath=relativePath.empty()?
                 entryName:
                 relativePath+"/"+entryName;
@@ -80,136 +276,143 @@ void FileScanner::ScanDirectory(const std::filesystem::path& currentPath,const s
             entryRelativePath=NormalizePath(entryRelativePath);
 
             if(entry.is_directory()) {
-                ScanDirectory(entry.path(),entryRelativePath);
-                dirInfo.subdirectories.push_back(entryName);
+                ScanDirectory(entry.path(),entryRelativePath,paths.InternChild(directoryId,entryName));
             }
             else if(entry.is_regular_file()) {
-                FileInfo fileInfo;
-                fileInfo.path=entryRelativePath;
-                fileInfo.size=entry.file_size();
-                fileInfo.isDirectory=false;
-
-                try {
-                    auto ftime=entry.last_write_time();
-                    auto sctp=std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-                        ftime-std::filesystem::file_time_type::clock::now()+
-                        std::chrono::system_clock::now());
-                    fileInfo.modifiedTime=std::chrono::system_clock::to_time_t(sctp);
-                }
-                catch(const std::exception& e) {
-                    g_logger<<LANG("error_time_conversion")<<": "<<e.what()<<std::endl;
-                    fileInfo.modifiedTime=0;
-                }
-
-                // 计算文件哈希（使用完整路径）
-                std::string fullPath=currentPath.string()+"/"+entryName;
-				//FIXME: 若 CalculateFileHash 返回空字符串（如文件无法打开），fileInfo.hash 为空，该文件仍被加入列表。
-                // 后续差异计算可能误认为该文件内容为空哈希，导致错误。
-                fileInfo.hash=CalculateFileHash(fullPath,hashAlgorithm);
-
-                files.push_back(fileInfo);
-                dirInfo.files.push_back(fileInfo);
+                ScanFile(entry,currentPath.string()+"/"+entryName,entryRelativePath,
+                    paths.InternChild(directoryId,entryName));
             }
         }
-
-        if(!dirInfo.path.empty()||(!dirInfo.files.empty()||!dirInfo.subdirectories.empty())) {
-            directories.push_back(dirInfo);
-        }
-        }
+    }
     catch(const std::filesystem::filesystem_error& e) {
         g_logger<<LANG("error_scan")<<": "<<e.what()<<std::endl;
     }
-    }
+}
 
-std::string FileScanner::CalculateFileHash(const std::string& filePath,const std::string& algorithm) {
-#ifdef _WIN32
-    // Windows下使用宽字符API确保中文路径正确
-    std::wstring wFilePath=Utf8ToWide(filePath);
-    FILE* file=_wfopen(wFilePath.c_str(),L"rb");
-#else
-    FILE* file=fopen(filePath.c_str(),"rb");
-#endif
+void FileScanner::ScanFile(const std::filesystem::directory_entry& entry,const std::string& fullPath,
+    const std::string& relativePath,PathId fileId) {
+    FileInfo fileInfo;
+    fileInfo.size=entry.file_size();
 
-    if(!file) {
-        return "";
+    try {
+        auto ftime=entry.last_write_time();
+        auto sctp=std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+            ftime-std::filesystem::file_time_type::clock::now()+
+            std::chrono::system_clock::now());
+        fileInfo.modifiedTime=std::chrono::system_clock::to_time_t(sctp);
+    }
+    catch(const std::exception& e) {
+        g_logger<<LANG("error_time_conversion")<<": "<<e.what()<<std::endl;
+        fileInfo.modifiedTime=0;
     }
 
-    const size_t bufferSize=8192;
-    char buffer[bufferSize];
-
-    if(algorithm=="md5") {
-        MD5_CTX context;
-        MD5_Init(&context);
-		//FIXME: fread 可能因错误返回 0，此时 ferror(file) 为真，但代码未检查，导致哈希基于部分数据计算，结果错误。
-        size_t bytesRead;
-        while((bytesRead=fread(buffer,1,bufferSize,file))>0) {
-            MD5_Update(&context,buffer,bytesRead);
+    // 计算文件哈希（使用完整路径）
+	//FIXME: 若 CalculateFileDigest 返回空摘要（如文件无法打开），fileInfo.hash 为空，该文件仍被加入列表。
+    // 后续差异计算可能误认为该文件内容为空哈希，导致错误。
+    // 大小、修改时间、inode 均未变化时直接复用缓存的哈希
+    uint64_t inode=hashCache?GetFileInode(fullPath):0;
+    bool cached=hashCache&&
+        hashCache->Lookup(relativePath,fileInfo.size,fileInfo.modifiedTime,inode,fileInfo.hash);
+
+    size_t index=snapshot.AddFile(fileId);
+    FileInfo& record=snapshot.GetMutableFile(index);
+    record.size=fileInfo.size;
+    record.modifiedTime=fileInfo.modifiedTime;
+    record.hash=fileInfo.hash;
+    fileInodes.push_back(inode);
+    if(!cached) {
+        if(hashPipeline) {
+            hashPipeline->Submit(index,fullPath);
         }
-
-        unsigned char digest[MD5_DIGEST_LENGTH];
-        MD5_Final(digest,&context);
-
-        std::stringstream ss;
-        for(int i=0; i<MD5_DIGEST_LENGTH; ++i) {
-            ss<<std::hex<<std::setw(2)<<std::setfill('0')<<(int)digest[i];
+        else {
+            record.hash=CalculateFileDigest(fullPath,hashAlgorithmId,readOptions);
         }
-
-        fclose(file);
-        return ss.str();
     }
-    else if(algorithm=="sha1") {
-        SHA_CTX context;
-        SHA1_Init(&context);
+}
 
-        size_t bytesRead;
-        while((bytesRead=fread(buffer,1,bufferSize,file))>0) {
-            SHA1_Update(&context,buffer,bytesRead);
+// 增量扫描：沿用上一次快照中不受影响的记录，再逐个重扫脏路径
+void FileScanner::RescanDirtyPaths(const std::vector<std::string>& dirtyPaths) {
+    Snapshot previous=std::move(snapshot);
+    snapshot=Snapshot(previous.GetSharedPathTable());
+    snapshot.SetHashAlgorithm(hashAlgorithmId);
+    PathTable& paths=snapshot.GetPathTable();
+
+    std::unordered_set<PathId> dirtyIds;
+    std::vector<std::pair<std::string,PathId>> targets;
+    for(const auto& dirtyPath:dirtyPaths) {
+        std::string relativePath=NormalizePath(dirtyPath);
+        PathId id=relativePath.empty()?kRootPath:paths.Intern(relativePath);
+        if(dirtyIds.insert(id).second) {
+            targets.emplace_back(relativePath,id);
         }
+    }
 
-        unsigned char digest[SHA_DIGEST_LENGTH];
-        SHA1_Final(digest,&context);
-
-        std::stringstream ss;
-        for(int i=0; i<SHA_DIGEST_LENGTH; ++i) {
-            ss<<std::hex<<std::setw(2)<<std::setfill('0')<<(int)digest[i];
+    // 自身或任一祖先被标脏的路径需要重扫
+    auto isDirty=[&](PathId id) {
+        while(true) {
+            if(dirtyIds.count(id)) {
+                return true;
+            }
+            if(id==kRootPath) {
+                return false;
+            }
+            id=paths.GetParent(id);
         }
+        };
 
-        fclose(file);
-        return ss.str();
+    for(const auto& dir:previous.GetDirectories()) {
+        if(!isDirty(dir.path)) {
+            snapshot.AddDirectory(dir.path);
+        }
     }
-    else if(algorithm=="sha256") {
-        SHA256_CTX context;
-        SHA256_Init(&context);
-
-        size_t bytesRead;
-        while((bytesRead=fread(buffer,1,bufferSize,file))>0) {
-            SHA256_Update(&context,buffer,bytesRead);
+    for(const auto& file:previous.GetFiles()) {
+        if(!isDirty(file.path)) {
+            snapshot.GetMutableFile(snapshot.AddFile(file.path))=file;
+            fileInodes.push_back(kCarriedOver);
         }
+    }
 
-        // 特别处理空文件
-		//OPTIMIZE: 空文件处理可优化,不必要的初始化。
-        if(ftell(file)==0) {
-            // 空文件的SHA256是固定的
-            static const std::string emptyFileSha256=
-                "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855";
-            fclose(file);
-            return emptyFileSha256;
+    for(const auto& [relativePath,id]:targets) {
+        // 祖先已被标脏时由祖先目录的重扫覆盖
+        if(id!=kRootPath&&isDirty(paths.GetParent(id))) {
+            continue;
         }
+        std::string fullPath=relativePath.empty()?workspace:workspace+"/"+relativePath;
+#ifdef _WIN32
+        std::filesystem::directory_entry entry(Utf8ToWide(fullPath));
+#else
+        std::filesystem::directory_entry entry(fullPath);
+#endif
+        std::error_code ec;
+        if(entry.is_directory(ec)) {
+            ScanDirectory(entry.path(),relativePath,id);
+        }
+        else if(entry.is_regular_file(ec)) {
+            ScanFile(entry,fullPath,relativePath,id);
+        }
+        // 其余情况（已删除）：旧记录已被排除，无需处理
+    }
+}
 
-        unsigned char digest[SHA256_DIGEST_LENGTH];
-        SHA256_Final(digest,&context);
+std::string FileScanner::CalculateFileHash(const std::string& filePath,const std::string& algorithm,
+    const ReadOptions& options) {
+    return CalculateFileDigest(filePath,HashProvider::ParseAlgorithm(algorithm),options).ToHex();
+}
 
-        std::stringstream ss;
-        for(int i=0; i<SHA256_DIGEST_LENGTH; ++i) {
-            ss<<std::hex<<std::setw(2)<<std::setfill('0')<<(int)digest[i];
-        }
+Digest FileScanner::CalculateFileDigest(const std::string& filePath,HashAlgorithm algorithm,
+    const ReadOptions& options) {
+    auto provider=HashProvider::Create(algorithm);
+    if(!provider) {
+        return Digest();
+    }
 
-        fclose(file);
-        return ss.str();
+    if(!FileReader::Read(filePath,options,[&](const unsigned char* data,size_t length) {
+        provider->Update(data,length);
+        })) {
+        return Digest();
     }
 
-    fclose(file);
-    return "";
+    return provider->Finish();
 }
 
 std::string FileScanner::NormalizePath(const std::string& path) const {
@@ -221,68 +424,9 @@ std::string FileScanner::NormalizePath(const std::string& path) const {
 }
 
 bool FileScanner::LoadFromJson(const Json::Value& json) {
-    files.clear();
-    directories.clear();
-
-    if(!json.isMember("files")||!json.isMember("directories")) {
-        return false;
-    }
-
-    // 加载文件
-	//FIXME: 这里没有校验 JSON 结构的完整性和正确性，譬如缺失字段或类型错误可能导致异常或错误
-    const Json::Value& filesJson=json["files"];
-    for(const auto& fileJson:filesJson) {
-        FileInfo file;
-        file.path=fileJson["path"].asString();
-        file.hash=fileJson["hash"].asString();
-        file.size=fileJson["size"].asUInt64();
-        file.isDirectory=fileJson["is_directory"].asBool();
-        file.modifiedTime=fileJson["modified_time"].asUInt64();
-        files.push_back(file);
-    }
-
-    // 加载目录
-    const Json::Value& dirsJson=json["directories"];
-    for(const auto& dirJson:dirsJson) {
-        DirectoryInfo dir;
-        dir.path=dirJson["path"].asString();
-
-        const Json::Value& dirFilesJson=dirJson["files"];
-        for(const auto& fileJson:dirFilesJson) {
-            FileInfo file;
-            file.path=fileJson["path"].asString();
-            file.hash=fileJson["hash"].asString();
-            file.size=fileJson["size"].asUInt64();
-            file.isDirectory=false;
-            file.modifiedTime=fileJson["modified_time"].asUInt64();
-            dir.files.push_back(file);
-        }
-
-        const Json::Value& subdirsJson=dirJson["subdirectories"];
-        for(const auto& subdirJson:subdirsJson) {
-            dir.subdirectories.push_back(subdirJson.asString());
-        }
-
-        directories.push_back(dir);
-    }
-
-    return true;
+    return snapshot.LoadFromJson(json);
 }
 
 Json::Value FileScanner::ToJson() const {
-    Json::Value json;
-
-    Json::Value filesJson(Json::arrayValue);
-    for(const auto& file:files) {
-        filesJson.append(file.ToJson());
-    }
-    json["files"]=filesJson;
-
-    Json::Value dirsJson(Json::arrayValue);
-    for(const auto& dir:directories) {
-        dirsJson.append(dir.ToJson());
-    }
-    json["directories"]=dirsJson;
-
-    return json;
+    return snapshot.ToJson();
 }
\ No newline at end of file
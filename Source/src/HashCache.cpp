@@ -0,0 +1,144 @@
+﻿#include "HashCache.h"
+#include "HashProvider.h"
+#include "Language.h"
+#include <fstream>
+#include <filesystem>
+#include <json/json.h>
+#include "Logger.h"
+
+HashCache::HashCache(const std::string& cacheFile,HashAlgorithm algorithm)
+    : cacheFile(cacheFile),algorithm(algorithm),createdAt(std::time(nullptr)) {
+}
+
+bool HashCache::Load() {
+    entries.clear();
+    if(!std::filesystem::exists(cacheFile)) {
+        return true;
+    }
+
+    std::ifstream file(cacheFile);
+    if(!file.is_open()) {
+        g_logger<<LANG("error_open_file")<<cacheFile<<std::endl;
+        return false;
+    }
+
+    Json::CharReaderBuilder reader;
+    std::string errors;
+    Json::Value json;
+    if(!Json::parseFromStream(reader,file,&json,&errors)) {
+        // 缓存损坏不影响正确性，丢弃后全量重新计算即可
+        g_logger<<"[WARNING] "<<LANG("error_parse_json")<<errors<<std::endl;
+        return false;
+    }
+
+    if(HashProvider::ParseAlgorithm(json["algorithm"].asString())!=algorithm||!json["entries"].isObject()) {
+        return true;
+    }
+
+    const Json::Value& entriesJson=json["entries"];
+    for(auto it=entriesJson.begin(); it!=entriesJson.end(); ++it) {
+        HashCacheEntry entry;
+        entry.size=(*it)["size"].asUInt64();
+        entry.modifiedTime=static_cast<std::time_t>((*it)["mtime"].asInt64());
+        entry.inode=(*it)["inode"].asUInt64();
+        entry.hash=Digest::FromHex((*it)["hash"].asString(),algorithm);
+        entries[it.name()]=entry;
+    }
+    return true;
+}
+
+bool HashCache::Save() {
+    std::filesystem::path cachePath(cacheFile);
+    if(cachePath.has_parent_path()) {
+        std::filesystem::create_directories(cachePath.parent_path());
+    }
+
+    Json::Value json;
+    json["algorithm"]=HashProvider::AlgorithmName(algorithm);
+    Json::Value entriesJson(Json::objectValue);
+    for(const auto& [path,entry]:nextEntries) {
+        Json::Value entryJson;
+        entryJson["size"]=static_cast<Json::UInt64>(entry.size);
+        entryJson["mtime"]=static_cast<Json::Int64>(entry.modifiedTime);
+        entryJson["inode"]=static_cast<Json::UInt64>(entry.inode);
+        entryJson["hash"]=entry.hash.ToHex();
+        entriesJson[path]=entryJson;
+    }
+    json["entries"]=entriesJson;
+    // 本轮的记录在内存中总是有效的，写盘失败也要替换掉上一轮，避免与下一轮的记录混在一起
+    entries.swap(nextEntries);
+    nextEntries.clear();
+
+    Json::StreamWriterBuilder writer;
+    writer["indentation"]="";
+    // 写临时文件后改名，写到一半崩溃时旧缓存仍然完整
+    std::string tempFile=cacheFile+".tmp";
+    {
+        std::ofstream file(tempFile,std::ios::trunc);
+        if(!file.is_open()) {
+            g_logger<<LANG("error_create_file")<<tempFile<<std::endl;
+            return false;
+        }
+        file<<Json::writeString(writer,json);
+        file.flush();
+        if(!file.good()) {
+            g_logger<<LANG("error_create_file")<<tempFile<<std::endl;
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempFile,cacheFile,ec);
+    if(ec) {
+        std::filesystem::remove(tempFile,ec);
+        g_logger<<LANG("error_create_file")<<cacheFile<<std::endl;
+        return false;
+    }
+    return true;
+}
+
+void HashCache::BeginScan() {
+    createdAt=std::time(nullptr);
+    hits=0;
+    misses=0;
+}
+
+bool HashCache::Lookup(const std::string& relativePath,uint64_t size,std::time_t modifiedTime,
+    uint64_t inode,Digest& hash) {
+    auto it=entries.find(relativePath);
+    if(it==entries.end()||
+        it->second.size!=size||
+        it->second.modifiedTime!=modifiedTime||
+        it->second.inode!=inode||
+        it->second.hash.Empty()) {
+        ++misses;
+        return false;
+    }
+
+    hash=it->second.hash;
+    nextEntries[relativePath]=it->second;
+    ++hits;
+    return true;
+}
+
+void HashCache::Store(const std::string& relativePath,uint64_t size,std::time_t modifiedTime,
+    uint64_t inode,const Digest& hash) {
+    // 修改时间只有秒级精度，扫描开始前后一秒内被改过的文件可能在同一秒内再次被改写，
+    // 这类文件不入缓存，下次扫描重新计算
+    if(hash.Empty()||modifiedTime>=createdAt-1) {
+        return;
+    }
+
+    HashCacheEntry entry;
+    entry.size=size;
+    entry.modifiedTime=modifiedTime;
+    entry.inode=inode;
+    entry.hash=hash;
+    nextEntries[relativePath]=entry;
+}
+
+void HashCache::Keep(const std::string& relativePath) {
+    auto it=entries.find(relativePath);
+    if(it!=entries.end()) {
+        nextEntries[relativePath]=it->second;
+    }
+}
@@ -0,0 +1,142 @@
+﻿#include "HashProvider.h"
+#include <openssl/evp.h>
+#include <blake3.h>
+#include <xxhash.h>
+
+// MD5/SHA1/SHA256 统一走 OpenSSL EVP 接口（旧的 *_Init 系列接口已被 OpenSSL 3 弃用）
+class EvpHashProvider : public HashProvider {
+public:
+    EvpHashProvider(HashAlgorithm algorithm,const EVP_MD* md)
+        : algorithm(algorithm),context(EVP_MD_CTX_new()) {
+        EVP_DigestInit_ex(context,md,nullptr);
+    }
+
+    ~EvpHashProvider() override {
+        EVP_MD_CTX_free(context);
+    }
+
+    void Update(const unsigned char* data,size_t length) override {
+        EVP_DigestUpdate(context,data,length);
+    }
+
+    void Final(unsigned char* digest) override {
+        unsigned int length=0;
+        EVP_DigestFinal_ex(context,digest,&length);
+    }
+
+    size_t GetDigestLength() const override {
+        return DigestLength(algorithm);
+    }
+
+    HashAlgorithm GetAlgorithm() const override {
+        return algorithm;
+    }
+
+private:
+    HashAlgorithm algorithm;
+    EVP_MD_CTX* context;
+};
+
+// BLAKE3：官方 C 实现会在运行时选择 SSE4.1/AVX2/AVX-512/NEON 路径
+class Blake3HashProvider : public HashProvider {
+public:
+    Blake3HashProvider() {
+        blake3_hasher_init(&hasher);
+    }
+
+    void Update(const unsigned char* data,size_t length) override {
+        blake3_hasher_update(&hasher,data,length);
+    }
+
+    void Final(unsigned char* digest) override {
+        blake3_hasher_finalize(&hasher,digest,BLAKE3_OUT_LEN);
+    }
+
+    size_t GetDigestLength() const override {
+        return BLAKE3_OUT_LEN;
+    }
+
+    HashAlgorithm GetAlgorithm() const override {
+        return HashAlgorithm::BLAKE3;
+    }
+
+private:
+    blake3_hasher hasher;
+};
+
+class Xxh3HashProvider : public HashProvider {
+public:
+    Xxh3HashProvider() : state(XXH3_createState()) {
+        XXH3_128bits_reset(state);
+    }
+
+    ~Xxh3HashProvider() override {
+        XXH3_freeState(state);
+    }
+
+    void Update(const unsigned char* data,size_t length) override {
+        XXH3_128bits_update(state,data,length);
+    }
+
+    void Final(unsigned char* digest) override {
+        // 使用规范（大端）字节序输出，保证跨平台一致
+        XXH128_canonical_t canonical;
+        XXH128_canonicalFromHash(&canonical,XXH3_128bits_digest(state));
+        for(size_t i=0; i<sizeof(canonical.digest); ++i) {
+            digest[i]=canonical.digest[i];
+        }
+    }
+
+    size_t GetDigestLength() const override {
+        return 16;
+    }
+
+    HashAlgorithm GetAlgorithm() const override {
+        return HashAlgorithm::XXH3_128;
+    }
+
+private:
+    XXH3_state_t* state;
+};
+
+std::unique_ptr<HashProvider> HashProvider::Create(HashAlgorithm algorithm) {
+    switch(algorithm) {
+    case HashAlgorithm::MD5: return std::make_unique<EvpHashProvider>(algorithm,EVP_md5());
+    case HashAlgorithm::SHA1: return std::make_unique<EvpHashProvider>(algorithm,EVP_sha1());
+    case HashAlgorithm::SHA256: return std::make_unique<EvpHashProvider>(algorithm,EVP_sha256());
+    case HashAlgorithm::BLAKE3: return std::make_unique<Blake3HashProvider>();
+    case HashAlgorithm::XXH3_128: return std::make_unique<Xxh3HashProvider>();
+    default: return nullptr;
+    }
+}
+
+HashAlgorithm HashProvider::ParseAlgorithm(const std::string& name) {
+    if(name=="md5") return HashAlgorithm::MD5;
+    if(name=="sha1") return HashAlgorithm::SHA1;
+    if(name=="sha256") return HashAlgorithm::SHA256;
+    if(name=="blake3") return HashAlgorithm::BLAKE3;
+    if(name=="xxh3-128"||name=="xxh3") return HashAlgorithm::XXH3_128;
+    return HashAlgorithm::Unknown;
+}
+
+const char* HashProvider::AlgorithmName(HashAlgorithm algorithm) {
+    switch(algorithm) {
+    case HashAlgorithm::MD5: return "md5";
+    case HashAlgorithm::SHA1: return "sha1";
+    case HashAlgorithm::SHA256: return "sha256";
+    case HashAlgorithm::BLAKE3: return "blake3";
+    case HashAlgorithm::XXH3_128: return "xxh3-128";
+    default: return "";
+    }
+}
+
+size_t HashProvider::DigestLength(HashAlgorithm algorithm) {
+    switch(algorithm) {
+    case HashAlgorithm::MD5: return 16;
+    case HashAlgorithm::SHA1: return 20;
+    case HashAlgorithm::SHA256: return 32;
+    case HashAlgorithm::BLAKE3: return 32;
+    case HashAlgorithm::XXH3_128: return 16;
+    default: return 0;
+    }
+}
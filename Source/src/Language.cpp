@@ -13,6 +13,25 @@ void Language::LoadChinese() {
         {"scan_start","开始扫描工作目录: "},
         {"scan_complete","扫描完成"},
         {"scan_complete_files","扫描完成，找到 {} 个文件，{} 个目录"},
+        {"info_scan_threads","哈希工作线程数: "},
+        {"info_hash_cache_hits","哈希缓存命中: "},
+        {"info_hash_cache_rehash","已忽略哈希缓存，将重新计算所有文件哈希"},
+        {"error_save_hash_cache","无法保存哈希缓存"},
+        {"info_bench_hash","哈希读取策略基准测试，算法: "},
+        {"warning_hash_algorithm_mismatch","新旧快照的哈希算法不同，无法比较内容，相关文件将视为已修改: "},
+        {"info_watch_started","已开始监视工作空间变更: "},
+        {"warning_watch_unavailable","无法监视工作空间，将使用全量扫描: "},
+        {"warning_watch_overflow","工作空间变更事件丢失，下次将全量扫描: "},
+        {"info_incremental_scan","增量扫描，变更路径数: "},
+        {"info_watch_full_rescan","变更事件不完整，执行全量扫描"},
+        {"info_daemon_ready","生成器守护模式已启动，输入 version <版本号> [描述] 生成版本，status 查看待处理变更，exit 退出"},
+        {"info_daemon_pending","待处理的变更路径: "},
+        {"info_daemon_unknown","未知指令: "},
+        {"error_snapshot_invalid","快照文件无效: "},
+        {"info_snapshot_exported","快照已导出: "},
+        {"info_bench_moves","移动检测基准测试，最大重命名数: "},
+        {"info_bench_patch","差分补丁基准测试，校验算法: "},
+        {"warning_patch_mismatch","差分补丁回放结果与新内容不一致，改为打包完整文件: "},
         {"package_building","构建更新包"},
         {"package_building_incremental","构建增量更新包: "},
         {"package_building_full","构建全量更新包: "},
@@ -55,6 +74,24 @@ void Language::LoadChinese() {
         {"error_version_snapshot_not_exist","版本快照不存在: "},
         {"error_save_snapshot","无法保存快照"},
         {"error_create_package","无法创建ZIP文件: "},
+        {"info_delta_summary","差分补丁文件数: "},
+        {"info_delta_saved","，节省字节: "},
+        {"error_object_store","无法存入对象库: "},
+        {"error_object_store_publish","存入对象库失败，版本未生成（文件可能在扫描后被修改，请重试）"},
+        {"info_objects_stored","对象库新增对象: "},
+        {"info_objects_reused","，复用: "},
+        {"info_objects_removed","已清理不再引用的对象: "},
+        {"warning_chunk_store","无法生成分块，客户端只能下载整个文件: "},
+        {"info_chunks_stored","已分块的大文件 / 新增分块: "},
+        {"request_chunk","分块下载请求"},
+        {"request_delta","请求获取版本差异"},
+        {"info_versions_reloaded","版本列表已变化，重新加载，代数: "},
+        {"warning_precompress","无法预压缩文件，客户端将下载未压缩的内容: "},
+        {"info_precompressed","已预压缩的文件 / 节省: "},
+        {"info_update_info_built","已生成并缓存更新信息: "},
+        {"warning_package_digest","无法计算更新包摘要，将在请求时计算: "},
+        {"error_package_index","无法读写包索引: "},
+        {"info_full_package_pruned","已删除旧的全量包（内容仍在对象库中）: "},
         {"error_zip_source","无法创建ZIP源"},
         {"error_add_file_zip","无法添加文件到ZIP: "},
         {"error_create_marker","无法创建空目录标记: "},
@@ -86,6 +123,7 @@ void Language::LoadChinese() {
         {"info_no_config","未找到配置文件，正在生成默认配置文件..."},
         {"info_default_config_created","默认配置文件已生成!"},
         {"info_put_game_files","请将游戏文件放入 'public' 文件夹中"},
+        {"info_delta_patches_note","delta_patches 开启（默认）时，每个增量包另外生成补丁格式的 *.patch.zip，通过 update 信息的 patch_archive 提供；不支持 update_patches.txt 的客户端继续使用普通增量包"},
         {"info_run_server","然后运行程序启动服务器"},
         {"info_enter_continue","按回车键继续..."},
         {"info_enter_exit","按回车键退出..."},
@@ -109,6 +147,7 @@ void Language::LoadChinese() {
         {"info_directory_added","新增目录: "},
         {"info_directory_deleted","删除目录: "},
         {"info_moved","移动: "},
+        {"info_moved_modified","移动并修改: "},
         {"info_to"," -> "},
         {"info_empty_directory","空目录"},
         {"info_delet_successed","已删除多余的目录包: "},
@@ -132,6 +171,25 @@ void Language::LoadEnglish() {
         {"scan_start","Start scanning workspace: "},
         {"scan_complete","Scan complete"},
         {"scan_complete_files","Scan complete, found {} files, {} directories"},
+        {"info_scan_threads","Hash worker threads: "},
+        {"info_hash_cache_hits","Hash cache hits: "},
+        {"info_hash_cache_rehash","Hash cache ignored, all files will be rehashed"},
+        {"error_save_hash_cache","Cannot save hash cache"},
+        {"info_bench_hash","Hash I/O strategy benchmark, algorithm: "},
+        {"warning_hash_algorithm_mismatch","Snapshots use different hash algorithms, affected files are treated as modified: "},
+        {"info_watch_started","Watching workspace for changes: "},
+        {"warning_watch_unavailable","Cannot watch workspace, falling back to full scans: "},
+        {"warning_watch_overflow","Workspace change events were lost, next scan will be full: "},
+        {"info_incremental_scan","Incremental scan, changed paths: "},
+        {"info_watch_full_rescan","Change events incomplete, running full scan"},
+        {"info_daemon_ready","Generator daemon ready. Enter version <ver> [description] to build a version, status to show pending changes, exit to quit"},
+        {"info_daemon_pending","Pending changed paths: "},
+        {"info_daemon_unknown","Unknown command: "},
+        {"error_snapshot_invalid","Invalid snapshot: "},
+        {"info_snapshot_exported","Snapshot exported: "},
+        {"info_bench_moves","Move detection benchmark, max renames: "},
+        {"info_bench_patch","Delta patch benchmark, verification hash: "},
+        {"warning_patch_mismatch","Delta patch does not reproduce the new content, packing the full file: "},
         {"package_building","Building update package"},
         {"package_building_incremental","Building incremental package: "},
         {"package_building_full","Building full package: "},
@@ -167,6 +225,24 @@ void Language::LoadEnglish() {
         {"error_version_snapshot_not_exist","Version snapshot does not exist: "},
         {"error_save_snapshot","Cannot save snapshot"},
         {"error_create_package","Cannot create ZIP file: "},
+        {"info_delta_summary","Delta patched files: "},
+        {"info_delta_saved",", bytes saved: "},
+        {"error_object_store","Cannot store object: "},
+        {"error_object_store_publish","Failed to populate object store, version not created (files may have changed after the scan, please retry)"},
+        {"info_objects_stored","Objects stored: "},
+        {"info_objects_reused",", reused: "},
+        {"info_objects_removed","Unreferenced objects removed: "},
+        {"warning_chunk_store","Cannot chunk file, clients will download it whole: "},
+        {"info_chunks_stored","Chunked large files / new chunks: "},
+        {"request_chunk","Chunk download request"},
+        {"request_delta","Request for version delta"},
+        {"info_versions_reloaded","Version list changed on disk, reloaded, generation: "},
+        {"warning_precompress","Cannot precompress file, clients will download it uncompressed: "},
+        {"info_precompressed","Precompressed files / saved: "},
+        {"info_update_info_built","Built and cached update info for version: "},
+        {"warning_package_digest","Cannot compute package digest, it will be computed on request: "},
+        {"error_package_index","Unable to read or write the package index: "},
+        {"info_full_package_pruned","Removed old full package (content kept in object store): "},
         {"error_zip_source","Cannot create ZIP source"},
         {"error_add_file_zip","Cannot add file to ZIP: "},
         {"error_create_marker","Cannot create empty directory marker: "},
@@ -208,6 +284,7 @@ void Language::LoadEnglish() {
         {"info_no_config","Config file not found, generating default config..."},
         {"info_default_config_created","Default config file created!"},
         {"info_put_game_files","Please put game files in 'public' folder"},
+        {"info_delta_patches_note","With delta_patches on (default), each incremental package also gets a patch-format *.patch.zip, offered as patch_archive in the update info; clients without update_patches.txt support keep using the plain package"},
         {"info_run_server","Then run program to start server"},
         {"info_enter_continue","Press Enter to continue..."},
         {"info_enter_exit","Press Enter to exit..."},
@@ -231,6 +308,7 @@ void Language::LoadEnglish() {
         {"info_directory_added","Directory added: "},
         {"info_directory_deleted","Directory deleted: "},
         {"info_moved","Moved: "},
+        {"info_moved_modified","Moved and modified: "},
         {"info_to"," -> "},
         {"info_empty_directory","Empty directory"},
         {"info_delet_successed","Excess directory packages have been deleted: " },
@@ -0,0 +1,215 @@
+﻿#include "ObjectStore.h"
+#include "HashProvider.h"
+#include "Language.h"
+#include "Logger.h"
+#include <fstream>
+#include <filesystem>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+ObjectStore::ObjectStore(const std::string& rootDir)
+    : rootDir(rootDir) {
+}
+
+std::string ObjectStore::GetObjectPath(const Digest& digest) const {
+    std::string hex=digest.ToHex();
+    return rootDir+"/"+HashProvider::AlgorithmName(digest.algorithm)+"/"+hex.substr(0,2)+"/"+hex.substr(2);
+}
+
+bool ObjectStore::Contains(const Digest& digest) const {
+    if(digest.Empty()) {
+        return false;
+    }
+    std::error_code ec;
+    return std::filesystem::is_regular_file(GetObjectPath(digest),ec);
+}
+
+bool ObjectStore::Put(const Digest& digest,const std::string& sourcePath,const ReadOptions& options,bool* stored) {
+    if(stored) {
+        *stored=false;
+    }
+    if(digest.Empty()) {
+        return false;
+    }
+    if(Contains(digest)) {
+        return true;
+    }
+    auto hasher=HashProvider::Create(digest.algorithm);
+    if(!hasher) {
+        return false;
+    }
+
+    std::string objectPath=GetObjectPath(digest);
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(objectPath).parent_path(),ec);
+
+    // 与快照文件相同：先写临时文件，校验通过后再改名，读者不会看到写了一半的对象
+    std::string tempPath=TempPathFor(objectPath);
+    bool ok=false;
+    {
+        std::ofstream out(tempPath,std::ios::binary|std::ios::trunc);
+        if(!out) {
+            return false;
+        }
+        ok=FileReader::Read(sourcePath,options,[&](const unsigned char* data,size_t length) {
+            hasher->Update(data,length);
+            out.write(reinterpret_cast<const char*>(data),static_cast<std::streamsize>(length));
+            });
+        out.flush();
+        ok=ok&&out.good();
+    }
+    if(!ok||hasher->Finish()!=digest) {
+        std::filesystem::remove(tempPath,ec);
+        return false;
+    }
+
+    std::filesystem::rename(tempPath,objectPath,ec);
+    if(ec) {
+        std::filesystem::remove(tempPath,ec);
+        // 其他进程可能刚好写入了同一个对象
+        return Contains(digest);
+    }
+    if(stored) {
+        *stored=true;
+    }
+    return true;
+}
+
+bool ObjectStore::PutData(const Digest& digest,const void* data,size_t size,bool* stored) {
+    if(stored) {
+        *stored=false;
+    }
+    if(digest.Empty()) {
+        return false;
+    }
+    if(Contains(digest)) {
+        return true;
+    }
+
+    if(!WriteFileAtomically(GetObjectPath(digest),data,size)) {
+        return Contains(digest);
+    }
+    if(stored) {
+        *stored=true;
+    }
+    return true;
+}
+
+std::string ObjectStore::GetVariantPath(const Digest& digest,const std::string& suffix) const {
+    return GetObjectPath(digest)+suffix;
+}
+
+bool ObjectStore::HasVariant(const Digest& digest,const std::string& suffix) const {
+    if(digest.Empty()) {
+        return false;
+    }
+    std::error_code ec;
+    return std::filesystem::is_regular_file(GetVariantPath(digest,suffix),ec);
+}
+
+bool ObjectStore::PutVariant(const Digest& digest,const std::string& suffix,const void* data,size_t size) {
+    if(digest.Empty()||suffix.empty()) {
+        return false;
+    }
+    return WriteFileAtomically(GetVariantPath(digest,suffix),data,size)||HasVariant(digest,suffix);
+}
+
+bool ObjectStore::WriteFileAtomically(const std::string& path,const void* data,size_t size) {
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(),ec);
+    std::string tempPath=TempPathFor(path);
+    {
+        std::ofstream out(tempPath,std::ios::binary|std::ios::trunc);
+        if(!out) {
+            return false;
+        }
+        out.write(static_cast<const char*>(data),static_cast<std::streamsize>(size));
+        out.flush();
+        if(!out.good()) {
+            out.close();
+            std::filesystem::remove(tempPath,ec);
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tempPath,path,ec);
+    if(ec) {
+        // 其他进程可能刚好写入了同一个文件
+        std::filesystem::remove(tempPath,ec);
+        return false;
+    }
+    return true;
+}
+
+std::string ObjectStore::TempPathFor(const std::string& objectPath) {
+    return objectPath+"."+
+        std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())^
+            static_cast<size_t>(std::chrono::steady_clock::now().time_since_epoch().count()))+".tmp";
+}
+
+bool ObjectStore::PutSnapshot(const Snapshot& snapshot,const std::string& workspace,
+    const ReadOptions& options,ObjectStoreStats* stats) {
+    bool success=true;
+    for(const auto& file:snapshot.GetFiles()) {
+        std::string relativePath=snapshot.GetPath(file.path);
+        bool stored=false;
+        if(!Put(file.hash,workspace+"/"+relativePath,options,&stored)) {
+            g_logger<<"[ERROR] "<<LANG("error_object_store")<<relativePath<<std::endl;
+            success=false;
+            continue;
+        }
+        if(stats) {
+            if(stored) {
+                ++stats->stored;
+                stats->storedBytes+=file.size;
+            }
+            else {
+                ++stats->reused;
+            }
+        }
+    }
+    return success;
+}
+
+void ObjectStore::ForEachObject(const std::function<void(const Digest& digest,const std::filesystem::path& path)>& callback) const {
+    std::error_code ec;
+    if(!std::filesystem::exists(rootDir,ec)) {
+        return;
+    }
+    for(auto it=std::filesystem::recursive_directory_iterator(rootDir,ec);
+        !ec&&it!=std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        if(it.depth()!=2||!it->is_regular_file(ec)) {
+            continue;
+        }
+        const std::filesystem::path& path=it->path();
+        // 写入中的临时文件不属于对象
+        if(path.extension()==".tmp") {
+            continue;
+        }
+        HashAlgorithm algorithm=HashProvider::ParseAlgorithm(path.parent_path().parent_path().filename().string());
+        // 对象文件名只有十六进制，带后缀的是对象的变体
+        std::string name=path.filename().string();
+        name=name.substr(0,name.find('.'));
+        callback(Digest::FromHex(path.parent_path().filename().string()+name,algorithm),path);
+    }
+}
+
+size_t ObjectStore::RemoveUnreferenced(const std::unordered_set<Digest,DigestHash>& liveDigests) {
+    // 先收集再删除，避免边遍历边修改目录
+    std::vector<std::filesystem::path> garbage;
+    ForEachObject([&](const Digest& digest,const std::filesystem::path& path) {
+        if(digest.Empty()||liveDigests.find(digest)==liveDigests.end()) {
+            garbage.push_back(path);
+        }
+        });
+
+    std::error_code ec;
+    size_t removed=0;
+    for(const auto& path:garbage) {
+        if(std::filesystem::remove(path,ec)) {
+            ++removed;
+        }
+    }
+    return removed;
+}
@@ -5,6 +5,18 @@
 #include <filesystem>
 #include <cstring>
 #include "Logger.h"
+#include "FileReader.h"
+#include "DeltaPatch.h"
+#include "HashProvider.h"
+#include <ctime>
+#include <cstdlib>
+
+// 差分补丁的适用范围：太小的文件补丁收益不明显，太大的文件新旧内容都要放进内存
+static const uint64_t kMinPatchFileSize=4*1024;
+static const uint64_t kMaxPatchFileSize=512ull*1024*1024;
+// 补丁在增量包中的位置，与工作空间文件分开，避免与同名文件冲突
+static const char* kPatchEntryPrefix=".mcupatch/";
+
 bool PackageBuilder::CreateIncrementalPackage(
     const std::string& oldVersion,
     const std::string& newVersion,
@@ -27,13 +39,28 @@ bool PackageBuilder::CreateIncrementalPackage(
         return false;
     }
 
+    // 补丁清单与 manifest 一样不复制进 libzip，要在 zip_close 之前一直有效
+    std::string patchList=
+        "# Patch List\n"
+        "# Format: PATH:OLD_PATH:PATCH_ENTRY:OLD_HASH:NEW_HASH:SIZE\n"
+        "# OLD_PATH is the local file the patch applies to (differs from PATH for moved files).\n"
+        "# Apply PATCH_ENTRY only if the local file hash equals OLD_HASH, then verify NEW_HASH;\n"
+        "# otherwise fall back to the full package.\n\n";
+    size_t patchedCount=0;
+    uint64_t savedBytes=0;
+    lastPatchCount=0;
+
     for(const auto& change:changes) {
         if(change.type==ChangeType::ADDED||
             change.type==ChangeType::MODIFIED||
             change.type==ChangeType::MOVED) {
 
-            std::string filePath=workspace+"/"+change.path;
+            std::string filePath=ContentPath(workspace,change.path,change.hash);
             if(std::filesystem::exists(filePath)) {
+                if(deltaPatches&&AddPatchToZip(zip,change,filePath,patchList,savedBytes)) {
+                    ++patchedCount;
+                    continue;
+                }
                 if(!AddFileToZip(zip,filePath,change.path)) {
                     zip_close(zip);
                     return false;
@@ -47,19 +74,48 @@ bool PackageBuilder::CreateIncrementalPackage(
             }
         }
     }
+    if(patchedCount>0) {
+        if(!AddPatchListToZip(zip,patchList)) {
+            zip_close(zip);
+            return false;
+        }
+        g_logger<<LANG("info_delta_summary")<<patchedCount<<LANG("info_delta_saved")<<savedBytes<<std::endl;
+    }
+    lastPatchCount=patchedCount;
 
     if(zip_close(zip)<0) {
         zip_error_t* error=zip_get_error(zip);
         g_logger<<LANG("error_close_package")<<": "<<zip_error_strerror(error)<<std::endl;
         return false;
     }
+    RecordPackage(outputPath);
     std::cout<<LANG("package_complete")<<outputPath<<std::endl;
     return true;
 }
+void PackageBuilder::RecordPackage(const std::string& outputPath) {
+    lastPackage=PackageRecord();
+    auto hasher=HashProvider::Create(HashProvider::ParseAlgorithm(lastPackage.hashAlgorithm));
+    if(!hasher) {
+        return;
+    }
+    ReadOptions options;
+    options.dropCache=false;
+    uint64_t size=0;
+    if(!FileReader::Read(outputPath,options,[&](const unsigned char* data,size_t length) {
+        hasher->Update(data,length);
+        size+=length;
+        })) {
+        g_logger<<"[WARNING] "<<LANG("warning_package_digest")<<outputPath<<std::endl;
+        return;
+    }
+    lastPackage.hash=hasher->Finish().ToHex();
+    lastPackage.size=size;
+    lastPackage.buildTime=std::time(nullptr);
+}
+
 bool PackageBuilder::CreateFullPackage(
     const std::string& version,
-    const std::vector<FileInfo>& files,
-    const std::vector<DirectoryInfo>& dirs,
+    const Snapshot& snapshot,
     const std::string& workspace,
     const std::string& outputPath) {
 
@@ -72,20 +128,24 @@ bool PackageBuilder::CreateFullPackage(
         return false;
     }
 
+    const auto& files=snapshot.GetFiles();
+    const auto& dirs=snapshot.GetDirectories();
+
     std::vector<ChangeRecord> changes;
+    changes.reserve(files.size());
     for(const auto& file:files) {
         ChangeRecord record;
         record.type=ChangeType::ADDED;
-        record.path=file.path;
+        record.path=snapshot.GetPath(file.path);
         record.hash=file.hash;
         record.size=file.size;
         changes.push_back(record);
     }
     for(const auto& dir:dirs) {
-        if(dir.files.empty()&&dir.subdirectories.empty()) {
+        if(dir.Empty()) {
             ChangeRecord record;
             record.type=ChangeType::DIRECTORY_ADDED;
-            record.path=dir.path;
+            record.path=snapshot.GetPath(dir.path);
             changes.push_back(record);
         }
     }
@@ -97,9 +157,10 @@ bool PackageBuilder::CreateFullPackage(
     }
 
     for(const auto& file:files) {
-        std::string filePath=workspace+"/"+file.path;
+        std::string relativePath=snapshot.GetPath(file.path);
+        std::string filePath=ContentPath(workspace,relativePath,file.hash);
         if(std::filesystem::exists(filePath)) {
-            if(!AddFileToZip(zip,filePath,file.path)) {
+            if(!AddFileToZip(zip,filePath,relativePath)) {
                 zip_close(zip);
                 return false;
             }
@@ -107,8 +168,8 @@ bool PackageBuilder::CreateFullPackage(
     }
 
     for(const auto& dir:dirs) {
-        if(dir.files.empty()&&dir.subdirectories.empty()) {
-            if(!AddEmptyDirectoryMarker(zip,dir.path)) {
+        if(dir.Empty()) {
+            if(!AddEmptyDirectoryMarker(zip,snapshot.GetPath(dir.path))) {
                 zip_close(zip);
                 return false;
             }
@@ -120,14 +181,14 @@ bool PackageBuilder::CreateFullPackage(
         g_logger<<LANG("error_close_package")<<": "<<zip_error_strerror(error)<<std::endl;
         return false;
     }
+    RecordPackage(outputPath);
     std::cout<<LANG("package_complete")<<outputPath<<std::endl;
     return true;
 }
 
 bool PackageBuilder::CreateDirectoryPackage(
     const std::string& rootDir,
-    const std::vector<DirectoryInfo>& allDirs,
-    const std::vector<FileInfo>& allFiles,
+    const Snapshot& snapshot,
     const std::string& workspace,
     const std::string& outputPath) {
 
@@ -139,11 +200,13 @@ bool PackageBuilder::CreateDirectoryPackage(
     }
 
     if(rootDir.empty()) {
-        // 根目录包：只打包根目录下的直接文件（路径中不含 '/'）
-        for(const auto& file:allFiles) {
-            if(file.path.find('/')==std::string::npos) {
-                std::string fullPath=workspace+"/"+file.path;
-                if(!AddFileToZip(zip,fullPath,file.path)) {
+        // 根目录包：只打包根目录下的直接文件，根目录排序后总在最前
+        const auto& dirs=snapshot.GetDirectories();
+        if(!dirs.empty()&&dirs.front().path==kRootPath) {
+            for(const auto& file:snapshot.GetDirectoryFiles(dirs.front())) {
+                std::string relativePath=snapshot.GetPath(file.path);
+                std::string fullPath=ContentPath(workspace,relativePath,file.hash);
+                if(!AddFileToZip(zip,fullPath,relativePath)) {
                     zip_close(zip);
                     return false;
                 }
@@ -151,16 +214,23 @@ bool PackageBuilder::CreateDirectoryPackage(
         }
     }
     else {
-        // 子目录包：递归打包整个目录树
-        std::string physicalRoot=workspace+"/"+rootDir;
-        if(std::filesystem::exists(physicalRoot)) {
-            if(!AddDirectoryRecursively(zip,physicalRoot,rootDir)) {
+        // 子目录包：按快照递归打包整个目录树，内容与版本一致，不受工作空间后续修改影响
+        PathId rootId=snapshot.GetPathTable().Find(rootDir);
+        const DirectoryInfo* root=nullptr;
+        for(const auto& dir:snapshot.GetDirectories()) {
+            if(dir.path==rootId) {
+                root=&dir;
+                break;
+            }
+        }
+        if(root) {
+            if(!AddSnapshotDirectory(zip,snapshot,*root,workspace)) {
                 zip_close(zip);
                 return false;
             }
         }
         else {
-            g_logger<<"[WARNING] 目录不存在: "<<physicalRoot<<std::endl;
+            g_logger<<"[WARNING] 目录不存在: "<<rootDir<<std::endl;
         }
     }
 
@@ -172,39 +242,31 @@ bool PackageBuilder::CreateDirectoryPackage(
     return true;
 }
 
-bool PackageBuilder::AddDirectoryRecursively(zip_t* zip,const std::string& physicalPath,const std::string& zipPath) {
+std::string PackageBuilder::ContentPath(const std::string& workspace,const std::string& relativePath,const Digest& hash) const {
+    if(objectStore&&objectStore->Contains(hash)) {
+        return objectStore->GetObjectPath(hash);
+    }
+    return workspace+"/"+relativePath;
+}
+
+bool PackageBuilder::AddSnapshotDirectory(zip_t* zip,const Snapshot& snapshot,const DirectoryInfo& dir,const std::string& workspace) {
+    std::string zipPath=snapshot.GetPath(dir.path);
     if(!zipPath.empty()) {
         zip_dir_add(zip,zipPath.c_str(),ZIP_FL_ENC_UTF_8);
     }
 
-    std::error_code ec;
-    for(const auto& entry:std::filesystem::directory_iterator(physicalPath,ec)) {
-        if(ec) {
-            g_logger<<LANG("error_scan")<<": "<<ec.message()<<std::endl;
+    for(const auto& file:snapshot.GetDirectoryFiles(dir)) {
+        std::string relativePath=snapshot.GetPath(file.path);
+        if(!AddFileToZip(zip,ContentPath(workspace,relativePath,file.hash),relativePath)) {
             return false;
         }
+    }
 
-        std::string entryName=entry.path().filename().string();
-        std::string entryPhysical=entry.path().string();
-        std::string entryZip;
-        if(zipPath.empty()) {
-            entryZip=entryName;
-        }
-        else {
-            entryZip=zipPath+"/"+entryName;
-        }
-
-        if(entry.is_directory()) {
-            // 递归添加子目录
-            if(!AddDirectoryRecursively(zip,entryPhysical,entryZip)) {
-                return false;
-            }
-        }
-        else if(entry.is_regular_file()) {
-            // 添加文件
-            if(!AddFileToZip(zip,entryPhysical,entryZip)) {
-                return false;
-            }
+    const auto& dirs=snapshot.GetDirectories();
+    for(uint32_t child:snapshot.GetSubdirectories(dir)) {
+        // 递归添加子目录
+        if(!AddSnapshotDirectory(zip,snapshot,dirs[child],workspace)) {
+            return false;
         }
     }
     return true;
@@ -287,6 +349,83 @@ bool PackageBuilder::AddEmptyDirectoryMarker(zip_t* zip,const std::string& dirPa
     return true;
 }
 
+// 补丁的前提是客户端本地文件与旧版本一致，旧内容按 oldHash 从对象库取得，
+// 对象写入时已校验过摘要，这里不再重复计算
+bool PackageBuilder::AddPatchToZip(zip_t* zip,const ChangeRecord& change,
+    const std::string& filePath,std::string& patchList,uint64_t& savedBytes) {
+    if(!objectStore||change.oldHash.Empty()||
+        (change.type!=ChangeType::MODIFIED&&change.type!=ChangeType::MOVED)) {
+        return false;
+    }
+
+    MappedFile newFile;
+    if(!newFile.Open(filePath)||
+        newFile.GetSize()<kMinPatchFileSize||newFile.GetSize()>kMaxPatchFileSize) {
+        return false;
+    }
+
+    MappedFile oldFile;
+    if(!objectStore->Contains(change.oldHash)||!oldFile.Open(objectStore->GetObjectPath(change.oldHash))||
+        oldFile.GetSize()>kMaxPatchFileSize) {
+        return false;
+    }
+
+    std::string patch;
+    if(!DeltaPatch::Create(oldFile.GetData(),oldFile.GetSize(),
+        newFile.GetData(),newFile.GetSize(),patch)) {
+        return false;
+    }
+    // 回放一次补丁，结果与新内容不一致时退回完整文件，不把错误的补丁发给客户端
+    std::string rebuilt;
+    if(!DeltaPatch::Apply(oldFile.GetData(),oldFile.GetSize(),patch,rebuilt)||
+        rebuilt.size()!=newFile.GetSize()||
+        std::memcmp(rebuilt.data(),newFile.GetData(),rebuilt.size())!=0) {
+        g_logger<<"[WARNING] "<<LANG("warning_patch_mismatch")<<change.path<<std::endl;
+        return false;
+    }
+
+    // 交给 libzip 的缓冲区由它在 zip_close 后释放
+    void* buffer=std::malloc(patch.size());
+    if(!buffer) {
+        return false;
+    }
+    std::memcpy(buffer,patch.data(),patch.size());
+    zip_source_t* source=zip_source_buffer(zip,buffer,patch.size(),1);
+    if(!source) {
+        std::free(buffer);
+        return false;
+    }
+    std::string entryName=kPatchEntryPrefix+change.path;
+    if(zip_file_add(zip,entryName.c_str(),source,ZIP_FL_OVERWRITE|ZIP_FL_ENC_UTF_8)<0) {
+        zip_source_free(source);
+        zip_error_t* error=zip_get_error(zip);
+        g_logger<<LANG("error_add_file_zip")<<": "<<entryName
+            <<" - Error: "<<zip_error_strerror(error)<<std::endl;
+        return false;
+    }
+
+    std::string oldPath=change.type==ChangeType::MOVED&&!change.oldPath.empty()?change.oldPath:change.path;
+    patchList+=change.path+":"+oldPath+":"+entryName+":"+change.oldHash.ToHex()+":"+change.hash.ToHex()+":"+std::to_string(change.size)+"\n";
+    savedBytes+=newFile.GetSize()-patch.size();
+    return true;
+}
+
+bool PackageBuilder::AddPatchListToZip(zip_t* zip,const std::string& patchList) {
+    zip_source_t* source=zip_source_buffer(zip,patchList.c_str(),patchList.length(),0);
+    if(!source) {
+        g_logger<<LANG("error_zip_source")<<std::endl;
+        return false;
+    }
+
+    if(zip_file_add(zip,"update_patches.txt",source,ZIP_FL_OVERWRITE)<0) {
+        zip_source_free(source);
+        g_logger<<LANG("error_add_file_zip")<<"update_patches.txt"<<std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 bool PackageBuilder::AddManifestToZip(zip_t* zip,const std::string& manifest) {
     zip_source_t* source=zip_source_buffer(zip,manifest.c_str(),manifest.length(),0);
     if(!source) {
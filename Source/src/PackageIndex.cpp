@@ -0,0 +1,118 @@
+﻿#include "PackageIndex.h"
+#include "Language.h"
+#include "Logger.h"
+#include <fstream>
+#include <filesystem>
+#include <json/json.h>
+
+PackageIndex::PackageIndex(const std::string& dataDir)
+    : dataDir(dataDir) {
+}
+
+std::string PackageIndex::GetIndexFile() const {
+    return dataDir+"/packages.json";
+}
+
+bool PackageIndex::Load() {
+    records.clear();
+    std::string indexFile=GetIndexFile();
+    if(!std::filesystem::exists(indexFile)) {
+        return true;
+    }
+
+    std::ifstream file(indexFile);
+    if(!file.is_open()) {
+        g_logger<<LANG("error_package_index")<<indexFile<<std::endl;
+        return false;
+    }
+    Json::CharReaderBuilder reader;
+    Json::Value json;
+    std::string errors;
+    if(!Json::parseFromStream(reader,file,&json,&errors)) {
+        g_logger<<LANG("error_package_index")<<errors<<std::endl;
+        return false;
+    }
+
+    const Json::Value& packages=json["packages"];
+    if(packages.isObject()) {
+        for(const auto& key:packages.getMemberNames()) {
+            const Json::Value& entry=packages[key];
+            PackageRecord record;
+            record.hash=entry["hash"].asString();
+            record.hashAlgorithm=entry.get("hash_algorithm","md5").asString();
+            record.size=entry["size"].asUInt64();
+            record.buildTime=static_cast<std::time_t>(entry["build_time"].asInt64());
+            records[key]=record;
+        }
+    }
+    return true;
+}
+
+bool PackageIndex::Save() const {
+    Json::Value packages(Json::objectValue);
+    for(const auto& [key,record]:records) {
+        Json::Value entry;
+        entry["hash"]=record.hash;
+        entry["hash_algorithm"]=record.hashAlgorithm;
+        entry["size"]=static_cast<Json::UInt64>(record.size);
+        entry["build_time"]=static_cast<Json::Int64>(record.buildTime);
+        packages[key]=entry;
+    }
+    Json::Value json;
+    json["packages"]=packages;
+
+    Json::StreamWriterBuilder writer;
+    writer["indentation"]="  ";
+    std::string indexFile=GetIndexFile();
+    // 写临时文件后改名，WebServer 不会读到写了一半的索引
+    std::string tempFile=indexFile+".tmp";
+    {
+        std::ofstream file(tempFile,std::ios::trunc);
+        if(!file.is_open()) {
+            g_logger<<LANG("error_package_index")<<indexFile<<std::endl;
+            return false;
+        }
+        file<<Json::writeString(writer,json);
+        file.flush();
+        if(!file.good()) {
+            g_logger<<LANG("error_package_index")<<indexFile<<std::endl;
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempFile,indexFile,ec);
+    if(ec) {
+        std::filesystem::remove(tempFile,ec);
+        g_logger<<LANG("error_package_index")<<indexFile<<std::endl;
+        return false;
+    }
+    return true;
+}
+
+void PackageIndex::Set(const std::string& key,const PackageRecord& record) {
+    records[key]=record;
+}
+
+void PackageIndex::Remove(const std::string& key) {
+    records.erase(key);
+}
+
+const PackageRecord* PackageIndex::Find(const std::string& key) const {
+    auto it=records.find(key);
+    return it==records.end()?nullptr:&it->second;
+}
+
+size_t PackageIndex::RemoveMissing(const std::string& outputDir) {
+    size_t removed=0;
+    std::error_code ec;
+    for(auto it=records.begin(); it!=records.end();) {
+        if(!std::filesystem::is_regular_file(outputDir+"/"+it->first,ec)) {
+            it=records.erase(it);
+            ++removed;
+        }
+        else {
+            ++it;
+        }
+    }
+    return removed;
+}
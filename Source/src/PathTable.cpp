@@ -0,0 +1,122 @@
+﻿#include "PathTable.h"
+#include <algorithm>
+#include <cstring>
+
+std::string_view StringArena::Store(std::string_view text) {
+    if(text.empty()) {
+        return std::string_view();
+    }
+    if(blockCapacity-blockUsed<text.size()) {
+        // 超长字符串单独占一个块，当前块剩余空间直接丢弃，名称通常很短，浪费可以忽略
+        size_t capacity=std::max(kBlockSize,text.size());
+        blocks.push_back(std::make_unique<char[]>(capacity));
+        blockUsed=0;
+        blockCapacity=capacity;
+        totalBytes+=capacity;
+    }
+    char* target=blocks.back().get()+blockUsed;
+    std::memcpy(target,text.data(),text.size());
+    blockUsed+=text.size();
+    return std::string_view(target,text.size());
+}
+
+void StringArena::Clear() {
+    blocks.clear();
+    blockUsed=0;
+    blockCapacity=0;
+    totalBytes=0;
+}
+
+PathTable::PathTable() {
+    // 0 号节点为根目录（空路径），0 号名称为空串
+    names.push_back(std::string_view());
+    nameIds.emplace(std::string_view(),0);
+    nodes.push_back({kRootPath,0});
+}
+
+PathId PathTable::InternChild(PathId parent,std::string_view name) {
+    auto nameIt=nameIds.find(name);
+    uint32_t nameId;
+    if(nameIt!=nameIds.end()) {
+        nameId=nameIt->second;
+    }
+    else {
+        nameId=static_cast<uint32_t>(names.size());
+        names.push_back(arena.Store(name));
+        nameIds.emplace(names.back(),nameId);
+    }
+
+    auto [it,inserted]=children.emplace(ChildKey(parent,nameId),static_cast<PathId>(nodes.size()));
+    if(inserted) {
+        nodes.push_back({parent,nameId});
+    }
+    return it->second;
+}
+
+PathId PathTable::Intern(std::string_view path) {
+    PathId id=kRootPath;
+    size_t start=0;
+    while(start<=path.size()) {
+        size_t end=path.find('/',start);
+        if(end==std::string_view::npos) {
+            end=path.size();
+        }
+        if(end>start) {
+            id=InternChild(id,path.substr(start,end-start));
+        }
+        start=end+1;
+    }
+    return id;
+}
+
+PathId PathTable::Find(std::string_view path) const {
+    PathId id=kRootPath;
+    size_t start=0;
+    while(start<=path.size()) {
+        size_t end=path.find('/',start);
+        if(end==std::string_view::npos) {
+            end=path.size();
+        }
+        if(end>start) {
+            auto nameIt=nameIds.find(path.substr(start,end-start));
+            if(nameIt==nameIds.end()) {
+                return kInvalidPath;
+            }
+            auto it=children.find(ChildKey(id,nameIt->second));
+            if(it==children.end()) {
+                return kInvalidPath;
+            }
+            id=it->second;
+        }
+        start=end+1;
+    }
+    return id;
+}
+
+void PathTable::AppendPath(PathId id,std::string& out) const {
+    // 自底向上收集各级节点，再正序拼接
+    std::vector<PathId> chain;
+    for(PathId current=id; current!=kRootPath; current=nodes[current].parent) {
+        chain.push_back(current);
+    }
+    for(auto it=chain.rbegin(); it!=chain.rend(); ++it) {
+        if(it!=chain.rbegin()) {
+            out.push_back('/');
+        }
+        out.append(names[nodes[*it].nameId]);
+    }
+}
+
+std::string PathTable::GetPath(PathId id) const {
+    std::string path;
+    AppendPath(id,path);
+    return path;
+}
+
+size_t PathTable::GetMemoryUsage() const {
+    return nodes.capacity()*sizeof(Node)+
+        names.capacity()*sizeof(std::string_view)+
+        nameIds.size()*(sizeof(std::string_view)+sizeof(uint32_t)+sizeof(void*)*2)+
+        children.size()*(sizeof(uint64_t)+sizeof(PathId)+sizeof(void*)*2)+
+        arena.GetBytes();
+}
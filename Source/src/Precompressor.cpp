@@ -0,0 +1,95 @@
+﻿#include "Precompressor.h"
+#include <algorithm>
+#include <climits>
+#include <zlib.h>
+#include <zstd.h>
+#include <brotli/encode.h>
+
+namespace {
+    const int kGzipLevel=9;
+    const int kZstdLevel=19;
+    // quality 11 每 MB 需要约一秒，更大的文件降到 9，压缩率只差几个百分点
+    const size_t kBrotliMaxQualitySize=1024*1024;
+    const int kBrotliLargeFileQuality=9;
+}
+
+const char* Precompressor::EncodingName(ContentEncoding encoding) {
+    switch(encoding) {
+    case ContentEncoding::Brotli: return "br";
+    case ContentEncoding::Zstd: return "zstd";
+    case ContentEncoding::Gzip: return "gzip";
+    default: return "identity";
+    }
+}
+
+const char* Precompressor::FileSuffix(ContentEncoding encoding) {
+    switch(encoding) {
+    case ContentEncoding::Brotli: return ".br";
+    case ContentEncoding::Zstd: return ".zst";
+    case ContentEncoding::Gzip: return ".gz";
+    default: return "";
+    }
+}
+
+bool Precompressor::Compress(ContentEncoding encoding,const unsigned char* data,size_t size,std::string& output) {
+    output.clear();
+    switch(encoding) {
+    case ContentEncoding::Brotli: return CompressBrotli(data,size,output);
+    case ContentEncoding::Zstd: return CompressZstd(data,size,output);
+    case ContentEncoding::Gzip: return CompressGzip(data,size,output);
+    default: return false;
+    }
+}
+
+bool Precompressor::IsWorthwhile(size_t originalSize,size_t compressedSize) {
+    size_t minSaving=std::max<size_t>(originalSize/10,512);
+    return compressedSize+minSaving<=originalSize;
+}
+
+bool Precompressor::CompressGzip(const unsigned char* data,size_t size,std::string& output) {
+    if(size>UINT_MAX) {
+        return false;
+    }
+    z_stream stream{};
+    // windowBits 15+16：带 gzip 头和尾，而不是 zlib 格式
+    if(deflateInit2(&stream,kGzipLevel,Z_DEFLATED,15+16,9,Z_DEFAULT_STRATEGY)!=Z_OK) {
+        return false;
+    }
+    output.resize(deflateBound(&stream,static_cast<uLong>(size)));
+    stream.next_in=const_cast<Bytef*>(data);
+    stream.avail_in=static_cast<uInt>(size);
+    stream.next_out=reinterpret_cast<Bytef*>(&output[0]);
+    stream.avail_out=static_cast<uInt>(output.size());
+    int result=deflate(&stream,Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result==Z_STREAM_END;
+}
+
+bool Precompressor::CompressZstd(const unsigned char* data,size_t size,std::string& output) {
+    output.resize(ZSTD_compressBound(size));
+    size_t written=ZSTD_compress(&output[0],output.size(),data,size,kZstdLevel);
+    if(ZSTD_isError(written)) {
+        output.clear();
+        return false;
+    }
+    output.resize(written);
+    return true;
+}
+
+bool Precompressor::CompressBrotli(const unsigned char* data,size_t size,std::string& output) {
+    size_t bound=BrotliEncoderMaxCompressedSize(size);
+    if(bound==0) {
+        return false;
+    }
+    output.resize(bound);
+    size_t written=output.size();
+    int quality=size<=kBrotliMaxQualitySize?BROTLI_MAX_QUALITY:kBrotliLargeFileQuality;
+    if(!BrotliEncoderCompress(quality,BROTLI_DEFAULT_WINDOW,BROTLI_MODE_GENERIC,size,data,
+        &written,reinterpret_cast<uint8_t*>(&output[0]))) {
+        output.clear();
+        return false;
+    }
+    output.resize(written);
+    return true;
+}
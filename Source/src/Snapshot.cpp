@@ -0,0 +1,291 @@
+﻿#include "Snapshot.h"
+#include <algorithm>
+
+Snapshot::Snapshot(std::shared_ptr<PathTable> paths)
+    : paths(paths?std::move(paths):std::make_shared<PathTable>()) {
+}
+
+// 只清空记录，路径表可能被其他快照共用，保留不动
+void Snapshot::Clear() {
+    files.clear();
+    directories.clear();
+    childIndices.clear();
+}
+
+size_t Snapshot::AddFile(PathId path) {
+    FileInfo file;
+    file.path=path;
+    files.push_back(file);
+    return files.size()-1;
+}
+
+void Snapshot::AddDirectory(PathId path) {
+    DirectoryInfo dir;
+    dir.path=path;
+    directories.push_back(dir);
+}
+
+ArrayRange<FileInfo> Snapshot::GetDirectoryFiles(const DirectoryInfo& dir) const {
+    return ArrayRange<FileInfo>(files.data()+dir.firstFile,dir.fileCount);
+}
+
+ArrayRange<uint32_t> Snapshot::GetSubdirectories(const DirectoryInfo& dir) const {
+    return ArrayRange<uint32_t>(childIndices.data()+dir.firstChild,dir.childCount);
+}
+
+// 整理布局：目录按路径排序（根目录在最前），文件按所在目录分组、组内按名称排序，
+// 子目录下标集中存放在 childIndices 中。缺失的父目录会被补齐。
+// 父子关系直接来自路径表，只有目录排序时才需要拼出完整路径。
+void Snapshot::Finalize() {
+    const PathTable& table=*paths;
+    const uint32_t kNone=UINT32_MAX;
+    std::vector<uint32_t> dirIndex(table.Size(),kNone);
+    std::vector<PathId> dirIds;
+    dirIds.reserve(directories.size()+1);
+
+    auto ensureDirectory=[&](PathId id) {
+        if(dirIndex[id]==kNone) {
+            dirIndex[id]=0;
+            dirIds.push_back(id);
+        }
+        };
+    for(const auto& dir:directories) {
+        ensureDirectory(dir.path);
+    }
+    for(const auto& file:files) {
+        ensureDirectory(table.GetParent(file.path));
+    }
+    for(size_t i=0; i<dirIds.size(); ++i) {
+        if(dirIds[i]!=kRootPath) {
+            ensureDirectory(table.GetParent(dirIds[i]));
+        }
+    }
+
+    // 与旧版本一致：空的根目录不记录
+    if(files.empty()&&dirIds.size()==1&&dirIds[0]==kRootPath) {
+        dirIndex[kRootPath]=kNone;
+        dirIds.clear();
+    }
+
+    std::vector<std::pair<std::string,PathId>> sortedDirs;
+    sortedDirs.reserve(dirIds.size());
+    for(PathId id:dirIds) {
+        sortedDirs.emplace_back(table.GetPath(id),id);
+    }
+    std::sort(sortedDirs.begin(),sortedDirs.end());
+
+    directories.assign(sortedDirs.size(),DirectoryInfo());
+    for(uint32_t i=0; i<sortedDirs.size(); ++i) {
+        directories[i].path=sortedDirs[i].second;
+        dirIndex[sortedDirs[i].second]=i;
+    }
+
+    // 文件按 (所在目录, 名称) 排序后按目录分配连续区间
+    std::vector<std::pair<uint32_t,uint32_t>> order(files.size());
+    for(uint32_t i=0; i<files.size(); ++i) {
+        order[i]={dirIndex[table.GetParent(files[i].path)],i};
+    }
+    std::sort(order.begin(),order.end(),[&](const auto& a,const auto& b) {
+        if(a.first!=b.first) return a.first<b.first;
+        return table.GetName(files[a.second].path)<table.GetName(files[b.second].path);
+        });
+
+    std::vector<FileInfo> sortedFiles;
+    sortedFiles.reserve(files.size());
+    for(const auto& [dir,index]:order) {
+        if(directories[dir].fileCount==0) {
+            directories[dir].firstFile=static_cast<uint32_t>(sortedFiles.size());
+        }
+        directories[dir].fileCount++;
+        sortedFiles.push_back(files[index]);
+    }
+    files.swap(sortedFiles);
+
+    // 子目录：先统计每个目录的子目录数，再按目录顺序（即路径顺序）回填
+    std::vector<uint32_t> parents(directories.size(),0);
+    for(uint32_t i=0; i<directories.size(); ++i) {
+        if(directories[i].path!=kRootPath) {
+            parents[i]=dirIndex[table.GetParent(directories[i].path)];
+            directories[parents[i]].childCount++;
+        }
+    }
+    uint32_t offset=0;
+    for(auto& dir:directories) {
+        dir.firstChild=offset;
+        offset+=dir.childCount;
+        dir.childCount=0;
+    }
+    childIndices.assign(offset,0);
+    for(uint32_t i=0; i<directories.size(); ++i) {
+        if(directories[i].path!=kRootPath) {
+            DirectoryInfo& parent=directories[parents[i]];
+            childIndices[parent.firstChild+parent.childCount++]=i;
+        }
+    }
+
+    ComputeTreeHashes();
+}
+
+void Snapshot::AssignLayout(std::vector<FileInfo> newFiles,std::vector<DirectoryInfo> newDirectories,
+    std::vector<uint32_t> newChildIndices) {
+    files=std::move(newFiles);
+    directories=std::move(newDirectories);
+    childIndices=std::move(newChildIndices);
+    bool complete=std::all_of(directories.begin(),directories.end(),[](const DirectoryInfo& dir) {
+        return !dir.treeHash.Empty();
+        });
+    if(!complete) {
+        ComputeTreeHashes();
+    }
+}
+
+const DirectoryInfo* Snapshot::GetRoot() const {
+    if(directories.empty()||directories.front().path!=kRootPath) {
+        return nullptr;
+    }
+    return &directories.front();
+}
+
+// 子目录的路径以父目录路径为前缀，排序后下标一定大于父目录，倒序遍历即可自底向上计算。
+// 每个条目编码为：类型('F'/'D') + 名称长度(4 字节小端) + 名称 + 摘要长度(1 字节) + 摘要
+void Snapshot::ComputeTreeHashes() {
+    HashAlgorithm algorithm=hashAlgorithm!=HashAlgorithm::Unknown?hashAlgorithm:HashAlgorithm::SHA256;
+    std::string buffer;
+    auto appendEntry=[&](char type,std::string_view name,const Digest& digest) {
+        uint32_t length=static_cast<uint32_t>(name.size());
+        buffer.push_back(type);
+        for(int shift=0; shift<32; shift+=8) {
+            buffer.push_back(static_cast<char>((length>>shift)&0xFF));
+        }
+        buffer.append(name.data(),name.size());
+        buffer.push_back(static_cast<char>(digest.length));
+        buffer.append(reinterpret_cast<const char*>(digest.bytes.data()),digest.length);
+        };
+
+    for(size_t i=directories.size(); i-->0;) {
+        DirectoryInfo& dir=directories[i];
+        buffer.clear();
+        for(const auto& file:GetDirectoryFiles(dir)) {
+            appendEntry('F',paths->GetName(file.path),file.hash);
+        }
+        for(uint32_t child:GetSubdirectories(dir)) {
+            appendEntry('D',paths->GetName(directories[child].path),directories[child].treeHash);
+        }
+
+        auto provider=HashProvider::Create(algorithm);
+        if(!provider) {
+            dir.treeHash=Digest();
+            continue;
+        }
+        provider->Update(reinterpret_cast<const unsigned char*>(buffer.data()),buffer.size());
+        dir.treeHash=provider->Finish();
+    }
+}
+
+size_t Snapshot::GetMemoryUsage() const {
+    return files.capacity()*sizeof(FileInfo)+
+        directories.capacity()*sizeof(DirectoryInfo)+
+        childIndices.capacity()*sizeof(uint32_t);
+}
+
+Json::Value Snapshot::FileToJson(const FileInfo& file) const {
+    Json::Value json;
+    json["path"]=GetPath(file.path);
+    json["hash"]=file.hash.ToHex();
+    json["hash_algorithm"]=HashProvider::AlgorithmName(file.hash.algorithm);
+    json["size"]=static_cast<Json::Int64>(file.size);
+    json["is_directory"]=false;
+    json["modified_time"]=static_cast<Json::Int64>(file.modifiedTime);
+    return json;
+}
+
+// 解析文件记录的哈希算法：优先取记录自身，其次取快照级别，最后按摘要长度推断
+// （旧版本只支持 md5/sha1/sha256，因此 64 位十六进制视为 sha256）
+static HashAlgorithm ResolveHashAlgorithm(const Json::Value& fileJson,HashAlgorithm snapshotAlgorithm) {
+    HashAlgorithm algorithm=HashProvider::ParseAlgorithm(fileJson["hash_algorithm"].asString());
+    if(algorithm!=HashAlgorithm::Unknown) {
+        return algorithm;
+    }
+    if(snapshotAlgorithm!=HashAlgorithm::Unknown) {
+        return snapshotAlgorithm;
+    }
+
+    switch(fileJson["hash"].asString().size()) {
+    case 32: return HashAlgorithm::MD5;
+    case 40: return HashAlgorithm::SHA1;
+    case 64: return HashAlgorithm::SHA256;
+    default: return HashAlgorithm::Unknown;
+    }
+}
+
+bool Snapshot::LoadFromJson(const Json::Value& json) {
+    Clear();
+
+    if(!json.isMember("files")||!json.isMember("directories")) {
+        return false;
+    }
+
+    // 快照级别的默认算法，旧快照没有记录时按哈希长度推断
+    hashAlgorithm=HashProvider::ParseAlgorithm(json["hash_algorithm"].asString());
+
+    // 只使用顶层文件列表，旧格式目录中的文件副本与之重复，忽略即可
+	//FIXME: 这里没有校验 JSON 结构的完整性和正确性，譬如缺失字段或类型错误可能导致异常或错误
+    const Json::Value& filesJson=json["files"];
+    files.reserve(filesJson.size());
+    for(const auto& fileJson:filesJson) {
+        if(fileJson["is_directory"].asBool()) {
+            continue;
+        }
+        FileInfo& file=files[AddFile(paths->Intern(fileJson["path"].asString()))];
+        file.size=fileJson["size"].asUInt64();
+        file.modifiedTime=fileJson["modified_time"].asUInt64();
+        file.hash=Digest::FromHex(fileJson["hash"].asString(),ResolveHashAlgorithm(fileJson,hashAlgorithm));
+    }
+    if(hashAlgorithm==HashAlgorithm::Unknown&&!files.empty()) {
+        hashAlgorithm=files.front().hash.algorithm;
+    }
+
+    // 子目录关系由路径推导，不依赖 subdirectories 字段
+    for(const auto& dirJson:json["directories"]) {
+        AddDirectory(paths->Intern(dirJson["path"].asString()));
+    }
+
+    Finalize();
+    return true;
+}
+
+Json::Value Snapshot::ToJson() const {
+    Json::Value json;
+    json["hash_algorithm"]=HashProvider::AlgorithmName(hashAlgorithm);
+
+    Json::Value filesJson(Json::arrayValue);
+    for(const auto& file:files) {
+        filesJson.append(FileToJson(file));
+    }
+    json["files"]=filesJson;
+
+    // 目录中仍写出文件副本，保持旧格式，旧版本服务端也能读取
+    Json::Value dirsJson(Json::arrayValue);
+    for(const auto& dir:directories) {
+        Json::Value dirJson;
+        dirJson["path"]=GetPath(dir.path);
+        dirJson["tree_hash"]=dir.treeHash.ToHex();
+
+        Json::Value dirFilesJson(Json::arrayValue);
+        for(const auto& file:GetDirectoryFiles(dir)) {
+            dirFilesJson.append(FileToJson(file));
+        }
+        dirJson["files"]=dirFilesJson;
+
+        Json::Value subdirsJson(Json::arrayValue);
+        for(uint32_t child:GetSubdirectories(dir)) {
+            subdirsJson.append(std::string(paths->GetName(directories[child].path)));
+        }
+        dirJson["subdirectories"]=subdirsJson;
+
+        dirsJson.append(dirJson);
+    }
+    json["directories"]=dirsJson;
+
+    return json;
+}
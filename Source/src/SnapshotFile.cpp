@@ -0,0 +1,380 @@
+﻿#include "SnapshotFile.h"
+#include <xxhash.h>
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include <thread>
+#include <chrono>
+
+static const char kSnapshotMagic[8]={'M','C','U','S','N','A','P','\0'};
+
+static uint64_t AlignTo8(uint64_t value) {
+    return (value+7)&~uint64_t(7);
+}
+
+static uint64_t HeaderChecksum(const SnapshotFileHeader& header) {
+    SnapshotFileHeader copy=header;
+    copy.headerChecksum=0;
+    return XXH3_64bits(&copy,sizeof(copy));
+}
+
+// 写出时同步计算载荷校验和
+class ChecksumWriter {
+public:
+    explicit ChecksumWriter(std::ofstream& out) : out(out) {
+        state=XXH3_createState();
+        XXH3_64bits_reset(state);
+    }
+    ~ChecksumWriter() { XXH3_freeState(state); }
+
+    void Write(const void* data,size_t length) {
+        out.write(static_cast<const char*>(data),static_cast<std::streamsize>(length));
+        XXH3_64bits_update(state,data,length);
+        written+=length;
+    }
+    void PadTo8() {
+        static const char zeros[8]={};
+        Write(zeros,static_cast<size_t>(AlignTo8(written)-written));
+    }
+    uint64_t GetWritten() const { return written; }
+    uint64_t GetChecksum() const { return XXH3_64bits_digest(state); }
+
+private:
+    std::ofstream& out;
+    XXH3_state_t* state;
+    uint64_t written=0;
+};
+
+bool SnapshotFile::Write(const std::string& filePath,const Snapshot& snapshot,const SnapshotMeta& meta) {
+    const PathTable& paths=snapshot.GetPathTable();
+    const auto& snapshotFiles=snapshot.GetFiles();
+    const auto& snapshotDirs=snapshot.GetDirectories();
+
+    // 字符串区：版本号，然后是各目录、各文件的完整路径
+    std::string stringBlob=meta.version;
+    std::vector<SnapshotDirectoryRecord> dirRecords(snapshotDirs.size());
+    std::vector<uint32_t> childRecords;
+    for(size_t i=0; i<snapshotDirs.size(); ++i) {
+        const DirectoryInfo& dir=snapshotDirs[i];
+        SnapshotDirectoryRecord& record=dirRecords[i];
+        std::memset(&record,0,sizeof(record));
+        record.pathOffset=static_cast<uint32_t>(stringBlob.size());
+        paths.AppendPath(dir.path,stringBlob);
+        record.pathLength=static_cast<uint32_t>(stringBlob.size()-record.pathOffset);
+        record.firstFile=dir.firstFile;
+        record.fileCount=dir.fileCount;
+        record.firstChild=static_cast<uint32_t>(childRecords.size());
+        record.childCount=dir.childCount;
+        record.treeHashAlgorithm=static_cast<uint8_t>(dir.treeHash.algorithm);
+        record.treeHashLength=dir.treeHash.length;
+        std::memcpy(record.treeHash,dir.treeHash.bytes.data(),dir.treeHash.length);
+        for(uint32_t child:snapshot.GetSubdirectories(dir)) {
+            childRecords.push_back(child);
+        }
+    }
+
+    std::vector<SnapshotFileRecord> fileRecords(snapshotFiles.size());
+    for(size_t i=0; i<snapshotFiles.size(); ++i) {
+        const FileInfo& file=snapshotFiles[i];
+        SnapshotFileRecord& record=fileRecords[i];
+        std::memset(&record,0,sizeof(record));
+        record.size=file.size;
+        record.modifiedTime=static_cast<int64_t>(file.modifiedTime);
+        record.pathOffset=static_cast<uint32_t>(stringBlob.size());
+        paths.AppendPath(file.path,stringBlob);
+        record.pathLength=static_cast<uint32_t>(stringBlob.size()-record.pathOffset);
+        record.hashAlgorithm=static_cast<uint8_t>(file.hash.algorithm);
+        record.digestLength=file.hash.length;
+        std::memcpy(record.digest,file.hash.bytes.data(),file.hash.length);
+    }
+    if(stringBlob.size()>UINT32_MAX) {
+        return false;
+    }
+
+    SnapshotFileHeader header;
+    std::memset(&header,0,sizeof(header));
+    std::memcpy(header.magic,kSnapshotMagic,sizeof(header.magic));
+    header.formatVersion=kFormatVersion;
+    header.headerSize=sizeof(SnapshotFileHeader);
+    header.hashAlgorithm=static_cast<uint8_t>(snapshot.GetHashAlgorithm());
+    header.fileCount=static_cast<uint32_t>(fileRecords.size());
+    header.directoryCount=static_cast<uint32_t>(dirRecords.size());
+    header.childCount=static_cast<uint32_t>(childRecords.size());
+    header.versionLength=static_cast<uint32_t>(meta.version.size());
+    header.timestamp=static_cast<int64_t>(meta.timestamp);
+
+    // 先写到临时文件再替换，避免正在映射旧快照的读者看到写了一半的内容
+    // 临时文件名按线程和时间区分，服务端并发转换旧快照时不会互相覆盖
+    std::string tempPath=filePath+"."+
+        std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())^
+            static_cast<size_t>(std::chrono::steady_clock::now().time_since_epoch().count()))+".tmp";
+    {
+        std::ofstream out(tempPath,std::ios::binary|std::ios::trunc);
+        if(!out) {
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header),sizeof(header));
+
+        // 偏移相对文件开头，头部大小是 8 的倍数
+        ChecksumWriter payload(out);
+        header.filesOffset=sizeof(header)+payload.GetWritten();
+        payload.Write(fileRecords.data(),fileRecords.size()*sizeof(SnapshotFileRecord));
+        payload.PadTo8();
+        header.directoriesOffset=sizeof(header)+payload.GetWritten();
+        payload.Write(dirRecords.data(),dirRecords.size()*sizeof(SnapshotDirectoryRecord));
+        payload.PadTo8();
+        header.childrenOffset=sizeof(header)+payload.GetWritten();
+        payload.Write(childRecords.data(),childRecords.size()*sizeof(uint32_t));
+        payload.PadTo8();
+        header.stringsOffset=sizeof(header)+payload.GetWritten();
+        header.stringsSize=stringBlob.size();
+        payload.Write(stringBlob.data(),stringBlob.size());
+        header.payloadChecksum=payload.GetChecksum();
+        header.headerChecksum=HeaderChecksum(header);
+
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&header),sizeof(header));
+        out.flush();
+        if(!out.good()) {
+            out.close();
+            std::filesystem::remove(tempPath);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath,filePath,ec);
+    if(ec) {
+        std::filesystem::remove(tempPath,ec);
+        return false;
+    }
+    return true;
+}
+
+bool SnapshotFile::Open(const std::string& filePath,std::string* error) {
+    Close();
+    auto fail=[&](const std::string& message) {
+        Close();
+        if(error) {
+            *error=message+": "+filePath;
+        }
+        return false;
+    };
+
+    if(!mapped.Open(filePath)) {
+        return fail("cannot map snapshot");
+    }
+    size_t size=mapped.GetSize();
+    const unsigned char* data=mapped.GetData();
+    if(size<sizeof(SnapshotFileHeader)) {
+        return fail("truncated snapshot header");
+    }
+
+    const SnapshotFileHeader* candidate=reinterpret_cast<const SnapshotFileHeader*>(data);
+    if(std::memcmp(candidate->magic,kSnapshotMagic,sizeof(kSnapshotMagic))!=0) {
+        return fail("not a binary snapshot");
+    }
+    if(candidate->formatVersion!=kFormatVersion||candidate->headerSize!=sizeof(SnapshotFileHeader)) {
+        return fail("unsupported snapshot format version "+std::to_string(candidate->formatVersion));
+    }
+    if(candidate->headerChecksum!=HeaderChecksum(*candidate)) {
+        return fail("snapshot header checksum mismatch");
+    }
+
+    // 各区段必须对齐且完整落在文件内（计数为 32 位，乘积不会溢出 64 位）
+    auto sectionFits=[&](uint64_t offset,uint64_t length,uint64_t alignment) {
+        return offset%alignment==0&&offset<=size&&length<=size-offset;
+    };
+    if(!sectionFits(candidate->filesOffset,uint64_t(candidate->fileCount)*sizeof(SnapshotFileRecord),8)||
+        !sectionFits(candidate->directoriesOffset,uint64_t(candidate->directoryCount)*sizeof(SnapshotDirectoryRecord),8)||
+        !sectionFits(candidate->childrenOffset,uint64_t(candidate->childCount)*sizeof(uint32_t),4)||
+        !sectionFits(candidate->stringsOffset,candidate->stringsSize,1)||
+        candidate->versionLength>candidate->stringsSize) {
+        return fail("snapshot sections out of range");
+    }
+
+    header=candidate;
+    files=reinterpret_cast<const SnapshotFileRecord*>(data+header->filesOffset);
+    directories=reinterpret_cast<const SnapshotDirectoryRecord*>(data+header->directoriesOffset);
+    children=reinterpret_cast<const uint32_t*>(data+header->childrenOffset);
+    strings=reinterpret_cast<const char*>(data+header->stringsOffset);
+    return true;
+}
+
+bool SnapshotFile::OpenVersion(const std::string& snapshotsDir,const std::string& version,std::string* error) {
+    return Open(snapshotsDir+"/"+version+".snap",error);
+}
+
+bool SnapshotFile::MigrateLegacy(const std::string& snapshotsDir,const std::string& version,std::string* error) {
+    std::string binaryPath=snapshotsDir+"/"+version+".snap";
+    std::string jsonPath=snapshotsDir+"/"+version+".json";
+    if(std::filesystem::exists(binaryPath)||!std::filesystem::exists(jsonPath)) {
+        return true;
+    }
+
+    // 旧版本生成的 JSON 快照：转换一次，之后直接映射
+    Snapshot snapshot;
+    SnapshotMeta meta;
+    if(!SnapshotReader::ReadFile(jsonPath,snapshot,&meta,error)) {
+        return false;
+    }
+    if(meta.version.empty()) {
+        meta.version=version;
+    }
+    if(!Write(binaryPath,snapshot,meta)) {
+        if(error) {
+            *error="cannot write "+binaryPath;
+        }
+        return false;
+    }
+    return true;
+}
+
+void SnapshotFile::Close() {
+    mapped.Close();
+    header=nullptr;
+    files=nullptr;
+    directories=nullptr;
+    children=nullptr;
+    strings=nullptr;
+}
+
+bool SnapshotFile::VerifyPayload() const {
+    const unsigned char* payload=mapped.GetData()+sizeof(SnapshotFileHeader);
+    uint64_t payloadSize=header->stringsOffset+header->stringsSize-sizeof(SnapshotFileHeader);
+    return XXH3_64bits(payload,static_cast<size_t>(payloadSize))==header->payloadChecksum;
+}
+
+SnapshotMeta SnapshotFile::GetMeta() const {
+    SnapshotMeta meta;
+    meta.version.assign(strings,header->versionLength);
+    meta.timestamp=static_cast<std::time_t>(header->timestamp);
+    return meta;
+}
+
+std::string_view SnapshotFile::GetString(uint32_t offset,uint32_t length) const {
+    if(uint64_t(offset)+length>header->stringsSize) {
+        return std::string_view();
+    }
+    return std::string_view(strings+offset,length);
+}
+
+Digest SnapshotFile::GetDigest(const SnapshotFileRecord& file) {
+    Digest digest;
+    digest.length=std::min<uint8_t>(file.digestLength,static_cast<uint8_t>(Digest::kMaxLength));
+    digest.algorithm=static_cast<HashAlgorithm>(file.hashAlgorithm);
+    std::memcpy(digest.bytes.data(),file.digest,digest.length);
+    return digest;
+}
+
+Digest SnapshotFile::GetTreeHash(const SnapshotDirectoryRecord& dir) {
+    Digest digest;
+    digest.length=std::min<uint8_t>(dir.treeHashLength,static_cast<uint8_t>(Digest::kMaxLength));
+    digest.algorithm=static_cast<HashAlgorithm>(dir.treeHashAlgorithm);
+    std::memcpy(digest.bytes.data(),dir.treeHash,digest.length);
+    return digest;
+}
+
+const SnapshotDirectoryRecord* SnapshotFile::FindDirectory(std::string_view path) const {
+    const SnapshotDirectoryRecord* first=directories;
+    const SnapshotDirectoryRecord* last=directories+header->directoryCount;
+    auto it=std::lower_bound(first,last,path,[this](const SnapshotDirectoryRecord& dir,std::string_view value) {
+        return GetPath(dir)<value;
+        });
+    return it!=last&&GetPath(*it)==path?it:nullptr;
+}
+
+// 先定位所在目录，再在目录的文件区间内二分：区间内路径前缀相同，按完整路径比较即按名称比较
+const SnapshotFileRecord* SnapshotFile::FindFile(std::string_view path) const {
+    size_t slash=path.rfind('/');
+    std::string_view dirPath=slash==std::string_view::npos?std::string_view():path.substr(0,slash);
+    const SnapshotDirectoryRecord* dir=FindDirectory(dirPath);
+    if(!dir||uint64_t(dir->firstFile)+dir->fileCount>header->fileCount) {
+        return nullptr;
+    }
+
+    const SnapshotFileRecord* first=files+dir->firstFile;
+    const SnapshotFileRecord* last=first+dir->fileCount;
+    auto it=std::lower_bound(first,last,path,[this](const SnapshotFileRecord& file,std::string_view value) {
+        return GetPath(file)<value;
+        });
+    return it!=last&&GetPath(*it)==path?it:nullptr;
+}
+
+// 文件写入时布局已经整理好（目录按路径排序、文件按目录分组、子目录下标区段、Merkle 哈希），
+// 这里原样载入，不再排序和重算哈希；只校验下标，保证后续按区间访问不会越界
+bool SnapshotFile::LoadInto(Snapshot& snapshot,std::string* error) const {
+    snapshot.Clear();
+    PathTable& paths=snapshot.GetPathTable();
+    auto fail=[&](const char* message) {
+        if(error) {
+            *error=message;
+        }
+        snapshot.Clear();
+        return false;
+        };
+
+    std::vector<FileInfo> fileInfos(header->fileCount);
+    std::vector<DirectoryInfo> dirInfos(header->directoryCount);
+    std::vector<uint32_t> childIndices(children,children+header->childCount);
+
+    // 按目录区间登记：目录路径只解析一次，文件只需登记名称
+    for(uint32_t i=0; i<header->directoryCount; ++i) {
+        const SnapshotDirectoryRecord& dir=directories[i];
+        if(uint64_t(dir.firstFile)+dir.fileCount>header->fileCount||
+            uint64_t(dir.firstChild)+dir.childCount>header->childCount) {
+            return fail("snapshot directory range out of bounds");
+        }
+        // 子目录排在父目录之后，自底向上计算哈希时依赖这一点
+        for(uint32_t j=dir.firstChild; j<dir.firstChild+dir.childCount; ++j) {
+            if(children[j]<=i||children[j]>=header->directoryCount) {
+                return fail("snapshot child index out of bounds");
+            }
+        }
+
+        std::string_view dirPath=GetPath(dir);
+        DirectoryInfo& info=dirInfos[i];
+        info.path=paths.Intern(dirPath);
+        info.firstFile=dir.firstFile;
+        info.fileCount=dir.fileCount;
+        info.firstChild=dir.firstChild;
+        info.childCount=dir.childCount;
+        info.treeHash=GetTreeHash(dir);
+
+        size_t prefixLength=dirPath.empty()?0:dirPath.size()+1;
+        for(uint32_t j=dir.firstFile; j<dir.firstFile+dir.fileCount; ++j) {
+            const SnapshotFileRecord& record=files[j];
+            std::string_view filePath=GetPath(record);
+            if(filePath.size()<=prefixLength) {
+                return fail("snapshot file path out of bounds");
+            }
+            FileInfo& file=fileInfos[j];
+            file.path=paths.InternChild(info.path,filePath.substr(prefixLength));
+            file.size=record.size;
+            file.modifiedTime=static_cast<std::time_t>(record.modifiedTime);
+            file.hash=GetDigest(record);
+        }
+    }
+
+    // 每个文件都要落在某个目录的区间内
+    for(const auto& file:fileInfos) {
+        if(file.path==kInvalidPath) {
+            return fail("snapshot file outside any directory");
+        }
+    }
+
+    snapshot.SetHashAlgorithm(GetHashAlgorithm());
+    snapshot.AssignLayout(std::move(fileInfos),std::move(dirInfos),std::move(childIndices));
+    return true;
+}
+
+bool SnapshotFile::LoadVersion(const std::string& snapshotsDir,const std::string& version,
+    Snapshot& snapshot,std::string* error) {
+    SnapshotFile file;
+    if(!file.OpenVersion(snapshotsDir,version,error)) {
+        return false;
+    }
+    return file.LoadInto(snapshot,error);
+}
@@ -0,0 +1,613 @@
+﻿#include "SnapshotStream.h"
+#include <fstream>
+#include <charconv>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// 输出缓冲：攒满后整块写入流，避免逐字段走 ostream 的格式化路径
+class OutputBuffer {
+public:
+    explicit OutputBuffer(std::ostream& out) : out(out) {
+        buffer.reserve(kFlushSize+4096);
+    }
+    ~OutputBuffer() { Flush(); }
+
+    void Append(std::string_view text) {
+        buffer.append(text.data(),text.size());
+        if(buffer.size()>=kFlushSize) {
+            Flush();
+        }
+    }
+
+    // 写出带引号的 JSON 字符串，非 ASCII 字符按 UTF-8 原样写出
+    void AppendString(std::string_view text) {
+        buffer.push_back('"');
+        for(char c:text) {
+            switch(c) {
+            case '"': buffer.append("\\\""); break;
+            case '\\': buffer.append("\\\\"); break;
+            case '\b': buffer.append("\\b"); break;
+            case '\f': buffer.append("\\f"); break;
+            case '\n': buffer.append("\\n"); break;
+            case '\r': buffer.append("\\r"); break;
+            case '\t': buffer.append("\\t"); break;
+            default:
+                if(static_cast<unsigned char>(c)<0x20) {
+                    static const char* hexDigits="0123456789abcdef";
+                    buffer.append("\\u00");
+                    buffer.push_back(hexDigits[(c>>4)&0xF]);
+                    buffer.push_back(hexDigits[c&0xF]);
+                }
+                else {
+                    buffer.push_back(c);
+                }
+            }
+        }
+        buffer.push_back('"');
+    }
+
+    void AppendInteger(int64_t value) {
+        char digits[24];
+        auto result=std::to_chars(digits,digits+sizeof(digits),value);
+        buffer.append(digits,result.ptr-digits);
+    }
+
+    void Flush() {
+        if(!buffer.empty()) {
+            out.write(buffer.data(),static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+
+private:
+    static constexpr size_t kFlushSize=256*1024;
+    std::ostream& out;
+    std::string buffer;
+};
+
+void WriteFileRecord(OutputBuffer& out,const Snapshot& snapshot,const FileInfo& file,std::string& pathBuffer) {
+    pathBuffer.clear();
+    snapshot.GetPathTable().AppendPath(file.path,pathBuffer);
+
+    out.Append("{ \"path\" : ");
+    out.AppendString(pathBuffer);
+    out.Append(", \"hash\" : ");
+    out.AppendString(file.hash.ToHex());
+    out.Append(", \"hash_algorithm\" : ");
+    out.AppendString(HashProvider::AlgorithmName(file.hash.algorithm));
+    out.Append(", \"size\" : ");
+    out.AppendInteger(static_cast<int64_t>(file.size));
+    out.Append(", \"is_directory\" : false, \"modified_time\" : ");
+    out.AppendInteger(static_cast<int64_t>(file.modifiedTime));
+    out.Append(" }");
+}
+
+// 拉取式 JSON 解析器：调用方按预期的结构逐个读取记号，不需要的值直接跳过。
+// 出错后所有读取都返回 false，错误信息通过 GetError 获取。
+class JsonPullParser {
+public:
+    explicit JsonPullParser(std::istream& in) : in(in),buffer(kBufferSize) {}
+
+    bool Failed() const { return !error.empty(); }
+    const std::string& GetError() const { return error; }
+
+    // 跳过空白后查看下一个字符，输入结束时返回 0
+    char Peek() {
+        while(true) {
+            if(position==length&&!Refill()) {
+                return 0;
+            }
+            char c=buffer[position];
+            if(c!=' '&&c!='\n'&&c!='\r'&&c!='\t') {
+                return c;
+            }
+            ++position;
+        }
+    }
+
+    bool Consume(char expected) {
+        if(Peek()==expected) {
+            ++position;
+            return true;
+        }
+        return false;
+    }
+
+    bool Expect(char expected) {
+        if(Failed()) {
+            return false;
+        }
+        if(!Consume(expected)) {
+            return Fail(std::string("expected '")+expected+"'");
+        }
+        return true;
+    }
+
+    // 遍历对象：读取下一个键，遇到 '}' 或出错时返回 false
+    bool NextKey(bool& first,std::string& key) {
+        if(Failed()||Consume('}')) {
+            return false;
+        }
+        if(!first&&!Expect(',')) {
+            return false;
+        }
+        first=false;
+        return ReadString(key)&&Expect(':');
+    }
+
+    // 遍历数组：还有元素时返回 true，遇到 ']' 或出错时返回 false
+    bool NextElement(bool& first) {
+        if(Failed()||Consume(']')) {
+            return false;
+        }
+        if(!first&&!Expect(',')) {
+            return false;
+        }
+        first=false;
+        return true;
+    }
+
+    bool ReadString(std::string& out) {
+        out.clear();
+        if(!Expect('"')) {
+            return false;
+        }
+        while(true) {
+            if(position==length&&!Refill()) {
+                return Fail("unterminated string");
+            }
+            // 连续的普通字符整段追加
+            size_t start=position;
+            while(position<length&&buffer[position]!='"'&&buffer[position]!='\\') {
+                ++position;
+            }
+            out.append(buffer.data()+start,position-start);
+            if(position==length) {
+                continue;
+            }
+            if(buffer[position++]=='"') {
+                return true;
+            }
+            if(!ReadEscape(out)) {
+                return false;
+            }
+        }
+    }
+
+    bool ReadInteger(int64_t& value) {
+        std::string token;
+        if(!ReadScalar(token)) {
+            return false;
+        }
+        char* end=nullptr;
+        if(token.find_first_of(".eE")!=std::string::npos) {
+            value=static_cast<int64_t>(std::strtod(token.c_str(),&end));
+        }
+        else {
+            value=std::strtoll(token.c_str(),&end,10);
+        }
+        if(end!=token.c_str()+token.size()) {
+            return Fail("invalid number '"+token+"'");
+        }
+        return true;
+    }
+
+    bool ReadBool(bool& value) {
+        std::string token;
+        if(!ReadScalar(token)) {
+            return false;
+        }
+        if(token!="true"&&token!="false") {
+            return Fail("invalid boolean '"+token+"'");
+        }
+        value=token=="true";
+        return true;
+    }
+
+    bool SkipValue() {
+        char c=Peek();
+        if(c=='"') {
+            return ReadString(scratch);
+        }
+        if(c=='{') {
+            ++position;
+            bool first=true;
+            std::string key;
+            while(NextKey(first,key)) {
+                if(!SkipValue()) {
+                    return false;
+                }
+            }
+            return !Failed();
+        }
+        if(c=='[') {
+            ++position;
+            bool first=true;
+            while(NextElement(first)) {
+                if(!SkipValue()) {
+                    return false;
+                }
+            }
+            return !Failed();
+        }
+        return ReadScalar(scratch);
+    }
+
+    bool Fail(const std::string& message) {
+        if(error.empty()) {
+            error=message+" at offset "+std::to_string(consumed+position);
+        }
+        return false;
+    }
+
+private:
+    static constexpr size_t kBufferSize=64*1024;
+    std::istream& in;
+    std::vector<char> buffer;
+    size_t position=0;
+    size_t length=0;
+    uint64_t consumed=0;  // 之前各块的总字节数，用于错误定位
+    std::string error;
+    std::string scratch;
+
+    bool Refill() {
+        consumed+=length;
+        position=0;
+        in.read(buffer.data(),static_cast<std::streamsize>(buffer.size()));
+        length=static_cast<size_t>(in.gcount());
+        return length>0;
+    }
+
+    bool Get(char& c) {
+        if(position==length&&!Refill()) {
+            return Fail("unexpected end of input");
+        }
+        c=buffer[position++];
+        return true;
+    }
+
+    // 数字、true/false/null 等不带引号的记号
+    bool ReadScalar(std::string& token) {
+        token.clear();
+        if(Failed()) {
+            return false;
+        }
+        Peek();
+        while(true) {
+            if(position==length&&!Refill()) {
+                break;
+            }
+            char c=buffer[position];
+            if(!((c>='0'&&c<='9')||(c>='a'&&c<='z')||c=='-'||c=='+'||c=='.'||c=='E')) {
+                break;
+            }
+            token.push_back(c);
+            ++position;
+        }
+        if(token.empty()) {
+            return Fail("unexpected character");
+        }
+        return true;
+    }
+
+    bool ReadHex4(uint32_t& value) {
+        value=0;
+        for(int i=0; i<4; ++i) {
+            char c;
+            if(!Get(c)) {
+                return false;
+            }
+            value<<=4;
+            if(c>='0'&&c<='9') value|=c-'0';
+            else if(c>='a'&&c<='f') value|=c-'a'+10;
+            else if(c>='A'&&c<='F') value|=c-'A'+10;
+            else return Fail("invalid \\u escape");
+        }
+        return true;
+    }
+
+    bool ReadEscape(std::string& out) {
+        char c;
+        if(!Get(c)) {
+            return false;
+        }
+        switch(c) {
+        case '"': out.push_back('"'); return true;
+        case '\\': out.push_back('\\'); return true;
+        case '/': out.push_back('/'); return true;
+        case 'b': out.push_back('\b'); return true;
+        case 'f': out.push_back('\f'); return true;
+        case 'n': out.push_back('\n'); return true;
+        case 'r': out.push_back('\r'); return true;
+        case 't': out.push_back('\t'); return true;
+        case 'u': break;
+        default: return Fail("invalid escape");
+        }
+
+        // jsoncpp 默认把非 ASCII 字符写成 \uXXXX（必要时为代理对），这里还原为 UTF-8
+        uint32_t codePoint;
+        if(!ReadHex4(codePoint)) {
+            return false;
+        }
+        if(codePoint>=0xD800&&codePoint<0xDC00) {
+            char backslash,u;
+            uint32_t low;
+            if(!Get(backslash)||!Get(u)||backslash!='\\'||u!='u'||!ReadHex4(low)||low<0xDC00||low>0xDFFF) {
+                return Fail("invalid surrogate pair");
+            }
+            codePoint=0x10000+((codePoint-0xD800)<<10)+(low-0xDC00);
+        }
+        if(codePoint<0x80) {
+            out.push_back(static_cast<char>(codePoint));
+        }
+        else if(codePoint<0x800) {
+            out.push_back(static_cast<char>(0xC0|(codePoint>>6)));
+            out.push_back(static_cast<char>(0x80|(codePoint&0x3F)));
+        }
+        else if(codePoint<0x10000) {
+            out.push_back(static_cast<char>(0xE0|(codePoint>>12)));
+            out.push_back(static_cast<char>(0x80|((codePoint>>6)&0x3F)));
+            out.push_back(static_cast<char>(0x80|(codePoint&0x3F)));
+        }
+        else {
+            out.push_back(static_cast<char>(0xF0|(codePoint>>18)));
+            out.push_back(static_cast<char>(0x80|((codePoint>>12)&0x3F)));
+            out.push_back(static_cast<char>(0x80|((codePoint>>6)&0x3F)));
+            out.push_back(static_cast<char>(0x80|(codePoint&0x3F)));
+        }
+        return true;
+    }
+};
+
+// 旧快照的文件记录可能没有 hash_algorithm，与 Snapshot::LoadFromJson 一致：
+// 先用快照级别的算法，再按摘要长度推断（旧版本只支持 md5/sha1/sha256）
+HashAlgorithm AlgorithmForLength(size_t length) {
+    switch(length) {
+    case 16: return HashAlgorithm::MD5;
+    case 20: return HashAlgorithm::SHA1;
+    case 32: return HashAlgorithm::SHA256;
+    default: return HashAlgorithm::Unknown;
+    }
+}
+
+bool ReadFileRecords(JsonPullParser& parser,Snapshot& snapshot) {
+    if(!parser.Expect('[')) {
+        return false;
+    }
+
+    PathTable& paths=snapshot.GetPathTable();
+    std::string key,path,hex,algorithmName;
+    bool firstRecord=true;
+    while(parser.NextElement(firstRecord)) {
+        if(!parser.Expect('{')) {
+            return false;
+        }
+        path.clear();
+        hex.clear();
+        algorithmName.clear();
+        int64_t size=0;
+        int64_t modifiedTime=0;
+        bool isDirectory=false;
+
+        // jsoncpp 按字母序写键，path 在 hash 之后，因此先收集字段，读完整条记录再登记
+        bool firstField=true;
+        while(parser.NextKey(firstField,key)) {
+            bool ok;
+            if(key=="path") ok=parser.ReadString(path);
+            else if(key=="hash") ok=parser.ReadString(hex);
+            else if(key=="hash_algorithm") ok=parser.ReadString(algorithmName);
+            else if(key=="size") ok=parser.ReadInteger(size);
+            else if(key=="modified_time") ok=parser.ReadInteger(modifiedTime);
+            else if(key=="is_directory") ok=parser.ReadBool(isDirectory);
+            else ok=parser.SkipValue();
+            if(!ok) {
+                return false;
+            }
+        }
+        if(parser.Failed()) {
+            return false;
+        }
+        if(isDirectory) {
+            continue;
+        }
+
+        FileInfo& file=snapshot.GetMutableFile(snapshot.AddFile(paths.Intern(path)));
+        file.size=static_cast<uint64_t>(size);
+        file.modifiedTime=static_cast<std::time_t>(modifiedTime);
+        file.hash=Digest::FromHex(hex,HashProvider::ParseAlgorithm(algorithmName));
+    }
+    return !parser.Failed();
+}
+
+// 目录只需要路径，文件副本、子目录列表和 tree_hash 都可由顶层文件和路径推导（Finalize 重新计算），直接跳过
+bool ReadDirectoryRecords(JsonPullParser& parser,Snapshot& snapshot) {
+    if(!parser.Expect('[')) {
+        return false;
+    }
+
+    PathTable& paths=snapshot.GetPathTable();
+    std::string key,path;
+    bool firstRecord=true;
+    while(parser.NextElement(firstRecord)) {
+        if(!parser.Expect('{')) {
+            return false;
+        }
+        bool hasPath=false;
+        bool firstField=true;
+        while(parser.NextKey(firstField,key)) {
+            bool ok;
+            if(key=="path") {
+                ok=parser.ReadString(path);
+                hasPath=true;
+            }
+            else {
+                ok=parser.SkipValue();
+            }
+            if(!ok) {
+                return false;
+            }
+        }
+        if(parser.Failed()) {
+            return false;
+        }
+        if(hasPath) {
+            snapshot.AddDirectory(paths.Intern(path));
+        }
+    }
+    return !parser.Failed();
+}
+
+}
+
+bool SnapshotWriter::WriteFile(const std::string& filePath,const Snapshot& snapshot,const SnapshotMeta& meta) {
+    std::ofstream file(filePath,std::ios::binary|std::ios::trunc);
+    if(!file) {
+        return false;
+    }
+    Write(file,snapshot,meta);
+    file.flush();
+    return file.good();
+}
+
+void SnapshotWriter::Write(std::ostream& out,const Snapshot& snapshot,const SnapshotMeta& meta) {
+    OutputBuffer buffer(out);
+    std::string pathBuffer;
+
+    buffer.Append("{\n  \"hash_algorithm\" : ");
+    buffer.AppendString(HashProvider::AlgorithmName(snapshot.GetHashAlgorithm()));
+    if(!meta.version.empty()) {
+        buffer.Append(",\n  \"version\" : ");
+        buffer.AppendString(meta.version);
+    }
+    if(meta.timestamp!=0) {
+        buffer.Append(",\n  \"timestamp\" : ");
+        buffer.AppendInteger(static_cast<int64_t>(meta.timestamp));
+    }
+
+    // 每条记录占一行，便于 diff/grep 查看
+    buffer.Append(",\n  \"files\" : [");
+    const char* separator="\n    ";
+    for(const auto& file:snapshot.GetFiles()) {
+        buffer.Append(separator);
+        WriteFileRecord(buffer,snapshot,file,pathBuffer);
+        separator=",\n    ";
+    }
+    buffer.Append(snapshot.GetFiles().empty()?"]":"\n  ]");
+
+    const auto& directories=snapshot.GetDirectories();
+    buffer.Append(",\n  \"directories\" : [");
+    separator="\n    ";
+    for(const auto& dir:directories) {
+        buffer.Append(separator);
+        buffer.Append("{\n      \"path\" : ");
+        pathBuffer.clear();
+        snapshot.GetPathTable().AppendPath(dir.path,pathBuffer);
+        buffer.AppendString(pathBuffer);
+        buffer.Append(",\n      \"tree_hash\" : ");
+        buffer.AppendString(dir.treeHash.ToHex());
+
+        buffer.Append(",\n      \"files\" : [");
+        const char* fileSeparator="\n        ";
+        for(const auto& file:snapshot.GetDirectoryFiles(dir)) {
+            buffer.Append(fileSeparator);
+            WriteFileRecord(buffer,snapshot,file,pathBuffer);
+            fileSeparator=",\n        ";
+        }
+        buffer.Append(dir.fileCount==0?"]":"\n      ]");
+
+        buffer.Append(",\n      \"subdirectories\" : [");
+        const char* childSeparator=" ";
+        for(uint32_t child:snapshot.GetSubdirectories(dir)) {
+            buffer.Append(childSeparator);
+            buffer.AppendString(snapshot.GetPathTable().GetName(directories[child].path));
+            childSeparator=", ";
+        }
+        buffer.Append(dir.childCount==0?"]\n    }":" ]\n    }");
+        separator=",\n    ";
+    }
+    buffer.Append(directories.empty()?"]\n}\n":"\n  ]\n}\n");
+}
+
+bool SnapshotReader::ReadFile(const std::string& filePath,Snapshot& snapshot,
+    SnapshotMeta* meta,std::string* error) {
+    std::ifstream file(filePath,std::ios::binary);
+    if(!file) {
+        if(error) {
+            *error="cannot open "+filePath;
+        }
+        return false;
+    }
+    return Read(file,snapshot,meta,error);
+}
+
+bool SnapshotReader::Read(std::istream& in,Snapshot& snapshot,SnapshotMeta* meta,std::string* error) {
+    snapshot.Clear();
+
+    JsonPullParser parser(in);
+    HashAlgorithm snapshotAlgorithm=HashAlgorithm::Unknown;
+    bool hasFiles=false;
+    bool hasDirectories=false;
+
+    if(parser.Expect('{')) {
+        std::string key,value;
+        bool first=true;
+        while(parser.NextKey(first,key)) {
+            bool ok;
+            if(key=="files") {
+                ok=ReadFileRecords(parser,snapshot);
+                hasFiles=true;
+            }
+            else if(key=="directories") {
+                ok=ReadDirectoryRecords(parser,snapshot);
+                hasDirectories=true;
+            }
+            else if(key=="hash_algorithm") {
+                ok=parser.ReadString(value);
+                snapshotAlgorithm=HashProvider::ParseAlgorithm(value);
+            }
+            else if(key=="version"&&meta) {
+                ok=parser.ReadString(meta->version);
+            }
+            else if(key=="timestamp"&&meta) {
+                int64_t timestamp=0;
+                ok=parser.ReadInteger(timestamp);
+                meta->timestamp=static_cast<std::time_t>(timestamp);
+            }
+            else {
+                ok=parser.SkipValue();
+            }
+            if(!ok) {
+                break;
+            }
+        }
+    }
+    if(!parser.Failed()&&(!hasFiles||!hasDirectories)) {
+        parser.Fail("missing files or directories");
+    }
+    if(parser.Failed()) {
+        if(error) {
+            *error=parser.GetError();
+        }
+        snapshot.Clear();
+        return false;
+    }
+
+    // 快照级别的算法写在文件列表之后（jsoncpp 按字母序），只能在读完后回填
+    size_t fileCount=snapshot.GetFiles().size();
+    for(size_t i=0; i<fileCount; ++i) {
+        Digest& hash=snapshot.GetMutableFile(i).hash;
+        if(hash.algorithm==HashAlgorithm::Unknown&&!hash.Empty()) {
+            hash.algorithm=snapshotAlgorithm!=HashAlgorithm::Unknown?
+                snapshotAlgorithm:AlgorithmForLength(hash.length);
+        }
+    }
+    if(snapshotAlgorithm==HashAlgorithm::Unknown&&fileCount>0) {
+        snapshotAlgorithm=snapshot.GetFiles().front().hash.algorithm;
+    }
+    snapshot.SetHashAlgorithm(snapshotAlgorithm);
+    snapshot.Finalize();
+    return true;
+}
@@ -1,13 +1,17 @@
 ﻿// UpdateGenerator.cpp - 修改GenerateFullPackage函数和CreateDirectoryPackages函数
 #include <regex>
 #include "UpdateGenerator.h"
+#include "SnapshotStream.h"
+#include "SnapshotFile.h"
 #include "Language.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include "Logger.h"
+#include "Precompressor.h"
 #include <unordered_set>
+#include <cctype>
 
 UpdateGenerator::UpdateGenerator(const Config& config)
     : config(config) {
@@ -57,11 +61,91 @@ bool UpdateGenerator::Initialize() {
     // 初始化文件扫描器（工作空间固定为public）
     scanner=std::make_unique<FileScanner>(
         config.GetWorkspace(),  // 固定为public
-        config.GetHashAlgorithm());
+        config.GetHashAlgorithm(),
+        config.GetScanThreads());
+
+    readOptions.strategy=FileReader::ParseStrategy(config.GetIoStrategy());
+    if(config.GetHashBufferKb()>0) {
+        readOptions.bufferSize=static_cast<size_t>(config.GetHashBufferKb())*1024;
+    }
+    if(config.GetMmapThresholdMb()>0) {
+        readOptions.mmapThreshold=static_cast<uint64_t>(config.GetMmapThresholdMb())*1024*1024;
+    }
+    readOptions.dropCache=config.GetDropPageCache();
+    scanner->SetReadOptions(readOptions);
+    // 扫描结果、历史快照与版本列表共用一张路径表
+    scanner->SetPathTable(versionManager->GetSharedPathTable());
+
+    // 哈希缓存位于输出目录下，--rehash 时不加载旧缓存，但仍写回本次结果
+    hashCache=std::make_unique<HashCache>(
+        config.GetOutputDir()+"/cache/hash_cache.json",
+        HashProvider::ParseAlgorithm(config.GetHashAlgorithm()));
+    if(config.GetForceRehash()) {
+        g_logger<<"[INFO] "<<LANG("info_hash_cache_rehash")<<std::endl;
+    }
+    else {
+        hashCache->Load();
+    }
+    scanner->SetHashCache(hashCache.get());
+
+    objectStore=std::make_unique<ObjectStore>(config.GetOutputDir()+"/objects");
+    chunkStore=std::make_unique<ChunkStore>(config.GetOutputDir()+"/chunks");
+    packageIndex=std::make_unique<PackageIndex>(config.GetOutputDir()+"/data");
+    packageIndex->Load();
+
+    // 旧版本生成的 JSON 快照在这里一次性转换，WebServer 只读取 .snap
+    for(const auto& version:versionManager->GetVersionList()) {
+        std::string errors;
+        if(!SnapshotFile::MigrateLegacy(config.GetOutputDir()+"/snapshots",version,&errors)) {
+            g_logger<<"[WARNING] "<<LANG("error_snapshot_invalid")<<version<<" "<<errors<<std::endl;
+        }
+    }
 
     return true;
 }
 
+UpdateGenerator::~UpdateGenerator() {
+    if(watcher) {
+        watcher->Stop();
+    }
+}
+
+bool UpdateGenerator::EnableWatch() {
+    if(!config.GetWatchWorkspace()) {
+        return false;
+    }
+    if(!watcher) {
+        watcher=std::make_unique<WorkspaceWatcher>(config.GetWorkspace());
+    }
+    if(!watcher->IsRunning()&&!watcher->Start()) {
+        watcher.reset();
+        return false;
+    }
+    return true;
+}
+
+// 有可用的监视结果时增量扫描，否则（未监视、首次扫描、事件溢出）全量扫描
+bool UpdateGenerator::ScanWorkspace() {
+    std::vector<std::string> dirtyPaths;
+    if(!watcher||!watcher->IsRunning()) {
+        return scanner->Scan();
+    }
+    // 先取走积压的事件再扫描，扫描期间的新变更留给下一轮
+    bool complete=watcher->TakeDirtyPaths(dirtyPaths);
+    if(!scanner->HasScanned()) {
+        return scanner->Scan();
+    }
+    if(!complete) {
+        g_logger<<LANG("info_watch_full_rescan")<<std::endl;
+        return scanner->Scan();
+    }
+    return scanner->ScanIncremental(dirtyPaths);
+}
+
+size_t UpdateGenerator::GetPendingChanges() const {
+    return watcher?watcher->GetPendingCount():0;
+}
+
 bool UpdateGenerator::GenerateVersion(const std::string& version,const std::string& description) {
     // 验证版本号格式
     std::regex versionPattern(R"(^\d+\.\d+\.\d+$)");
@@ -80,19 +164,21 @@ bool UpdateGenerator::GenerateVersion(const std::string& version,const std::stri
     g_logger<<LANG("info_version")<<version<<std::endl;
 
     // 扫描当前工作空间
-    if(!scanner->Scan()) {
+    if(!ScanWorkspace()) {
         g_logger<<LANG("error_scan")<<std::endl;
         return false;
     }
 
-    currentFiles=scanner->GetFiles();
-    currentDirs=scanner->GetDirectories();
-
     // 获取现有版本列表（在保存新版本之前）
     auto versions=versionManager->GetVersionList();
 
+    // 先存入对象库，失败时不产生新版本
+    if(!PublishObjects(CurrentSnapshot())) {
+        return false;
+    }
+
     // 保存版本快照
-    if(!SaveVersionSnapshot(version,currentFiles,currentDirs)) {
+    if(!SaveVersionSnapshot(version,CurrentSnapshot())) {
         return false;
     }
 
@@ -128,10 +214,13 @@ bool UpdateGenerator::GenerateVersion(const std::string& version,const std::stri
     }
 
     // 创建目录包
-    if(!CreateDirectoryPackages(version,currentDirs)) {
+    if(!CreateDirectoryPackages(version,CurrentSnapshot())) {
         g_logger<<LANG("error_package")<<": "<<LANG("info_directory")<<std::endl;
         return false;
     }
+    PruneFullPackages();
+    // 新包已写入、旧全量包已清理，更新路径规划需要看到最新的包
+    versionManager->RefreshVersionGraph();
 
     g_logger<<"[INFO] "<<LANG("info_version")<<version<<LANG("info_created_complete")<<std::endl;
     return true;
@@ -188,36 +277,71 @@ bool UpdateGenerator::GenerateIncrementalPackage(
     }
 
     // 获取旧版本文件
-    std::vector<FileInfo> oldFiles;
-    std::vector<DirectoryInfo> oldDirs;
-    if(!GetPreviousVersionFiles(fromVersion,oldFiles,oldDirs)) {
+    Snapshot oldSnapshot;
+    if(!GetPreviousVersionFiles(fromVersion,oldSnapshot)) {
         return false;
     }
 
     // 计算差异
     DiffEngine diffEngine;
-    auto changes=diffEngine.CalculateDiff(oldFiles,currentFiles,oldDirs,currentDirs);
+    diffEngine.SetContentResolver(PublishedContentResolver());
+    auto changes=diffEngine.CalculateDiff(oldSnapshot,CurrentSnapshot());
 
     if(changes.empty()) {
         g_logger<<LANG("info_no_changes")<<std::endl;
         return true;
     }
 
-    // 创建增量包
+    return BuildIncrementalPackages(fromVersion,toVersion,changes);
+}
+
+bool UpdateGenerator::BuildIncrementalPackages(const std::string& fromVersion,const std::string& toVersion,
+    const std::vector<ChangeRecord>& changes) {
+    std::string incrementalDir=config.GetOutputDir()+"/incremental";
+    std::string baseName=fromVersion+"_to_"+toVersion;
+
     PackageBuilder builder;
+    builder.SetObjectStore(objectStore.get());
     if(!builder.CreateIncrementalPackage(
         fromVersion,toVersion,changes,
-        config.GetWorkspace(),packagePath)) {
+        config.GetWorkspace(),incrementalDir+"/"+baseName+".zip")) {
         return false;
     }
+    RecordPackage("incremental/"+baseName+".zip",builder);
 
+    // 补丁包：对象库提供差分补丁所需的旧内容，一个补丁都没有时与普通包相同，不保留
+    std::string patchName=baseName+PackageBuilder::kPatchPackageSuffix;
+    std::string patchPath=incrementalDir+"/"+patchName;
+    std::error_code ec;
+    std::filesystem::remove(patchPath,ec);
+    if(!config.GetDeltaPatches()) {
+        return true;
+    }
+    PackageBuilder patchBuilder;
+    patchBuilder.SetObjectStore(objectStore.get());
+    patchBuilder.SetDeltaPatches(true);
+    if(!patchBuilder.CreateIncrementalPackage(
+        fromVersion,toVersion,changes,
+        config.GetWorkspace(),patchPath)||patchBuilder.GetLastPatchCount()==0) {
+        // 补丁包只是优化，失败时客户端仍可使用普通包
+        std::filesystem::remove(patchPath,ec);
+        packageIndex->RemoveMissing(config.GetOutputDir());
+        packageIndex->Save();
+        return true;
+    }
+    RecordPackage("incremental/"+patchName,patchBuilder);
     return true;
 }
 
 bool UpdateGenerator::GenerateFullPackage(const std::string& version) {
+    return BuildFullPackage(version,CurrentSnapshot());
+}
+
+bool UpdateGenerator::BuildFullPackage(const std::string& version,const Snapshot& snapshot) {
     g_logger<<LANG("package_building_full")<<version<<std::endl;
 
     PackageBuilder builder;
+    builder.SetObjectStore(objectStore.get());
     std::string fullDir=config.GetOutputDir()+"/full";
     std::filesystem::create_directories(fullDir);
     std::string packagePath=fullDir+"/"+version+".zip";  // 使用版本号命名
@@ -230,46 +354,49 @@ bool UpdateGenerator::GenerateFullPackage(const std::string& version) {
 
     // 传递目录信息到全量包构建器
     if(!builder.CreateFullPackage(
-        version,currentFiles,currentDirs,
+        version,snapshot,
         config.GetWorkspace(),packagePath)) {
         return false;
     }
+    RecordPackage("full/"+version+".zip",builder);
 
     g_logger<<"[INFO] "<<LANG("info_full")<<version<<LANG("info_zip_becreated")<<std::endl;
     return true;
 }
 
+void UpdateGenerator::RecordPackage(const std::string& key,const PackageBuilder& builder) {
+    const PackageRecord& record=builder.GetLastPackage();
+    if(record.hash.empty()) {
+        // 没有记录时 WebServer 会退回到请求时计算
+        packageIndex->Remove(key);
+    }
+    else {
+        packageIndex->Set(key,record);
+    }
+    // 顺便清理已被删除的包（删除版本、裁剪全量包）留下的记录
+    packageIndex->RemoveMissing(config.GetOutputDir());
+    packageIndex->Save();
+}
+
 bool UpdateGenerator::ScanAndBuild() {
-    if(!scanner->Scan()) {
+    if(!ScanWorkspace()) {
         return false;
     }
 
-    currentFiles=scanner->GetFiles();
-    currentDirs=scanner->GetDirectories();
-
     // 将当前状态保存为JSON
-    Json::Value snapshot=scanner->ToJson();
-
     std::string snapshotFile=config.GetOutputDir()+"/current_snapshot.json";
-    std::ofstream file(snapshotFile);
-    if(!file) {
+    if(!SnapshotWriter::WriteFile(snapshotFile,CurrentSnapshot(),SnapshotMeta())) {
         g_logger<<LANG("error_io")<<": "<<LANG("error_save_snapshot")<<std::endl;
         return false;
     }
 
-    Json::StreamWriterBuilder writer;
-    writer["indentation"]="  ";
-    std::string jsonString=Json::writeString(writer,snapshot);
-    file<<jsonString;
-
     g_logger<<LANG("info_snapshot_saved")<<snapshotFile<<std::endl;
     return true;
 }
 
 bool UpdateGenerator::GetPreviousVersionFiles(
     const std::string& version,
-    std::vector<FileInfo>& files,
-    std::vector<DirectoryInfo>& dirs) {
+    Snapshot& snapshot) {
 
     const VersionInfo* versionInfo=versionManager->GetVersion(version);
     if(!versionInfo) {
@@ -277,88 +404,81 @@ bool UpdateGenerator::GetPreviousVersionFiles(
         return false;
     }
 
-    std::string snapshotFile=config.GetOutputDir()+"/snapshots/"+version+".json";
-    if(!std::filesystem::exists(snapshotFile)) {
-        g_logger<<LANG("error_version_snapshot_not_exist")<<snapshotFile<<std::endl;
-        return false;
-    }
-
-    std::ifstream file(snapshotFile);
-    if(!file.is_open()) {
-        g_logger<<LANG("error_open_file")<<snapshotFile<<std::endl;
+    std::string snapshotsDir=config.GetOutputDir()+"/snapshots";
+    if(!std::filesystem::exists(snapshotsDir+"/"+version+".snap")&&
+        !std::filesystem::exists(snapshotsDir+"/"+version+".json")) {
+        g_logger<<LANG("error_version_snapshot_not_exist")<<snapshotsDir+"/"+version+".snap"<<std::endl;
         return false;
     }
 
-    Json::CharReaderBuilder reader;
+    // 二进制快照直接映射后登记到共用路径表；旧的 JSON 快照会先转换
+    snapshot=Snapshot(versionManager->GetSharedPathTable());
     std::string errors;
-    Json::Value snapshot;
-    if(!Json::parseFromStream(reader,file,&snapshot,&errors)) {
-        g_logger<<LANG("error_parse_json")<<errors<<std::endl;
+    if(!SnapshotFile::LoadVersion(snapshotsDir,version,snapshot,&errors)) {
+        g_logger<<LANG("error_snapshot_invalid")<<errors<<std::endl;
         return false;
     }
-
-    // 使用临时 FileScanner 加载快照
-    FileScanner tempScanner("");  // workspace 参数在此无关
-    if(!tempScanner.LoadFromJson(snapshot)) {
-        return false;
-    }
-    files=tempScanner.GetFiles();
-    dirs=tempScanner.GetDirectories();
     return true;
 }
 
+// 已发布版本的内容都在对象库中；对象库建立之前发布的内容只能到工作空间里找。
+// 摘要到工作空间路径的索引在第一次需要时才建立，没有相似候选的差异计算不会付出这部分开销
+DiffEngine::ContentResolver UpdateGenerator::PublishedContentResolver() const {
+    const Snapshot* snapshot=&CurrentSnapshot();
+    const ObjectStore* store=objectStore.get();
+    std::string workspace=config.GetWorkspace();
+    auto index=std::make_shared<std::unordered_map<Digest,PathId,DigestHash>>();
+    auto built=std::make_shared<bool>(false);
+    return [snapshot,store,workspace,index,built](const Digest& hash) -> std::string {
+        if(store->Contains(hash)) {
+            return store->GetObjectPath(hash);
+        }
+        if(!*built) {
+            for(const auto& file:snapshot->GetFiles()) {
+                index->emplace(file.hash,file.path);
+            }
+            *built=true;
+        }
+        auto it=index->find(hash);
+        if(it==index->end()) {
+            return std::string();
+        }
+        return workspace+"/"+snapshot->GetPath(it->second);
+    };
+}
+
 bool UpdateGenerator::SaveVersionSnapshot(
     const std::string& version,
-    const std::vector<FileInfo>& files,
-    const std::vector<DirectoryInfo>& dirs) {
+    const Snapshot& snapshot) {
 
     // 创建快照目录
     std::string snapshotsDir=config.GetOutputDir()+"/snapshots";
     std::filesystem::create_directories(snapshotsDir);
 
-    // 保存为JSON
-    std::string snapshotFile=snapshotsDir+"/"+version+".json";
-    std::ofstream file(snapshotFile);
-    if(!file) {
+    // 保存为二进制快照，需要查看内容时用 snapshot export --json 导出
+    std::string snapshotFile=snapshotsDir+"/"+version+".snap";
+    SnapshotMeta meta;
+    meta.version=version;
+    meta.timestamp=std::time(nullptr);
+    if(!SnapshotFile::Write(snapshotFile,snapshot,meta)) {
         g_logger<<LANG("error_create_file")<<snapshotFile<<std::endl;
         return false;
     }
 
-    Json::Value snapshot;
-
-    // 保存文件列表
-    Json::Value filesJson(Json::arrayValue);
-    for(const auto& fileInfo:files) {
-        filesJson.append(fileInfo.ToJson());
-    }
-    snapshot["files"]=filesJson;
-
-    // 保存目录列表
-    Json::Value dirsJson(Json::arrayValue);
-    for(const auto& dirInfo:dirs) {
-        dirsJson.append(dirInfo.ToJson());
-    }
-    snapshot["directories"]=dirsJson;
-
-    snapshot["version"]=version;
-    snapshot["timestamp"]=static_cast<Json::Int64>(std::time(nullptr));
-
-    Json::StreamWriterBuilder writer;
-    writer["indentation"]="  ";
-    std::string jsonString=Json::writeString(writer,snapshot);
-    file<<jsonString;
-
     // 添加到版本管理器
     VersionInfo versionInfo;
     versionInfo.version=version;
     versionInfo.timestamp=std::time(nullptr);
 
-    for(const auto& fileInfo:files) {
-        versionInfo.files.push_back(fileInfo.path);
+    // 版本列表与快照共用路径表时直接记录编号，否则按路径重新登记
+    PathTable& versionPaths=versionManager->GetPathTable();
+    bool samePaths=&versionPaths==&snapshot.GetPathTable();
+    for(const auto& fileInfo:snapshot.GetFiles()) {
+        versionInfo.files.push_back(samePaths?fileInfo.path:versionPaths.Intern(snapshot.GetPath(fileInfo.path)));
     }
 
-    for(const auto& dirInfo:dirs) {
-        versionInfo.directories.push_back(dirInfo.path);
+    for(const auto& dirInfo:snapshot.GetDirectories()) {
+        versionInfo.directories.push_back(samePaths?dirInfo.path:versionPaths.Intern(snapshot.GetPath(dirInfo.path)));
     }
 
     // 添加增量关系
@@ -372,19 +492,25 @@ bool UpdateGenerator::SaveVersionSnapshot(
 
 bool UpdateGenerator::CreateDirectoryPackages(
     const std::string& version,
-    const std::vector<DirectoryInfo>& dirs) {
+    const Snapshot& snapshot) {
 
+    const auto& dirs=snapshot.GetDirectories();
     PackageBuilder builder;
+    builder.SetObjectStore(objectStore.get());
     std::string packagesDir=config.GetOutputDir()+"/packages";
     std::filesystem::create_directories(packagesDir);
 
+    // 只处理顶级目录（父节点为根，根目录自身的父节点也是根）
+    const PathTable& paths=snapshot.GetPathTable();
+    auto isTopLevel=[&](const DirectoryInfo& dir) {
+        return paths.GetParent(dir.path)==kRootPath;
+        };
+
     // 1. 收集当前版本所有顶级目录对应的包名
     std::unordered_set<std::string> expectedPackages;
     for(const auto& dir:dirs) {
-        // 只处理顶级目录（路径中不含 '/' 或为空）
-        bool isTopLevel=(dir.path.find('/')==std::string::npos)||dir.path.empty();
-        if(!isTopLevel) continue;
-        std::string packageName=dir.path.empty()?"root.zip":dir.path+".zip";
+        if(!isTopLevel(dir)) continue;
+        std::string packageName=dir.path==kRootPath?"root.zip":paths.GetPath(dir.path)+".zip";
         expectedPackages.insert(packageName);
     }
 
@@ -408,19 +534,16 @@ bool UpdateGenerator::CreateDirectoryPackages(
         }
     }
 
-    // 3. 为每个当前顶级目录重新生成包
-    const auto& allFiles=currentFiles;
-    const auto& allDirs=currentDirs;
-
+    // 3. 为每个当前顶级目录重新生成包（内容取自当前工作空间的扫描结果）
     for(const auto& dir:dirs) {
-        bool isTopLevel=(dir.path.find('/')==std::string::npos)||dir.path.empty();
-        if(!isTopLevel) continue;
+        if(!isTopLevel(dir)) continue;
 
-        std::string packageName=dir.path.empty()?"root.zip":dir.path+".zip";
+        std::string dirPath=paths.GetPath(dir.path);
+        std::string packageName=dirPath.empty()?"root.zip":dirPath+".zip";
         std::string packagePath=packagesDir+"/"+packageName;
 
-        if(!builder.CreateDirectoryPackage(dir.path,allDirs,allFiles,config.GetWorkspace(),packagePath)) {
-            g_logger<<"[ERROR] "<<LANG("error_create_pathpackage")<<dir.path<<std::endl;
+        if(!builder.CreateDirectoryPackage(dirPath,snapshot,config.GetWorkspace(),packagePath)) {
+            g_logger<<"[ERROR] "<<LANG("error_create_pathpackage")<<dirPath<<std::endl;
             return false;
         }
         g_logger<<"[INFO] "<<LANG("info_createdpath_package")<<packageName<<std::endl;
@@ -467,24 +590,23 @@ bool UpdateGenerator::RollbackToVersion(const std::string& targetVersion,
         <<LANG("info_rollback_part3")<<newVersion<<std::endl;
 
     // 加载目标版本的快照
-    std::vector<FileInfo> targetFiles;
-    std::vector<DirectoryInfo> targetDirs;
-    if(!GetPreviousVersionFiles(targetVersion,targetFiles,targetDirs)) {
+    Snapshot targetSnapshot;
+    if(!GetPreviousVersionFiles(targetVersion,targetSnapshot)) {
         return false;
     }
 
     // 扫描当前工作空间（实际上我们只需要用目标版本的文件列表，但为了获取当前文件？不，我们并不需要当前文件，因为回退包是从最新版本到新版本）
     // 但为了生成增量包，我们需要最新版本的文件列表（即当前最新版本的快照）
-    std::vector<FileInfo> latestFiles;
-    std::vector<DirectoryInfo> latestDirs;
-    if(!GetPreviousVersionFiles(latestVersion,latestFiles,latestDirs)) {
+    Snapshot latestSnapshot;
+    if(!GetPreviousVersionFiles(latestVersion,latestSnapshot)) {
         return false;
     }
 
     // 计算从最新版本到目标版本的差异（即回退所需的更改）
     DiffEngine diffEngine;
+    diffEngine.SetContentResolver(PublishedContentResolver());
     // 注意：DiffEngine 期望旧文件为最新版本，新文件为目标版本
-    auto changes=diffEngine.CalculateDiff(latestFiles,targetFiles,latestDirs,targetDirs);
+    auto changes=diffEngine.CalculateDiff(latestSnapshot,targetSnapshot);
 
     // 如果没有变化（理论上不可能，因为 targetVersion != latestVersion，但以防万一）
     if(changes.empty()) {
@@ -493,12 +615,12 @@ bool UpdateGenerator::RollbackToVersion(const std::string& targetVersion,
     }
 
     // 保存新版本的快照（使用目标版本的文件和目录）
-    if(!SaveVersionSnapshot(newVersion,targetFiles,targetDirs)) {
+    if(!SaveVersionSnapshot(newVersion,targetSnapshot)) {
         return false;
     }
 
-    // 创建全量包（新版本）
-    if(!GenerateFullPackage(newVersion)) {
+    // 创建全量包（新版本），内容为目标版本的文件
+    if(!BuildFullPackage(newVersion,targetSnapshot)) {
         return false;
     }
 
@@ -513,15 +635,12 @@ bool UpdateGenerator::RollbackToVersion(const std::string& targetVersion,
         std::filesystem::remove(packagePath);
     }
 
-    PackageBuilder builder;
-    if(!builder.CreateIncrementalPackage(
-        latestVersion,newVersion,changes,
-        config.GetWorkspace(),packagePath)) {
+    if(!BuildIncrementalPackages(latestVersion,newVersion,changes)) {
         return false;
     }
 
     // 创建目录包（新版本）
-    if(!CreateDirectoryPackages(newVersion,targetDirs)) {
+    if(!CreateDirectoryPackages(newVersion,targetSnapshot)) {
         return false;
     }
 
@@ -535,6 +654,165 @@ bool UpdateGenerator::RollbackToVersion(const std::string& targetVersion,
     // 为了保险，我们可以再次更新该版本的 incrementalFrom 为 latestVersion。
     // 但 AddVersion 已经做了，所以无需额外操作。
 
+    PruneFullPackages();
+    // 新包已写入、旧全量包已清理，更新路径规划需要看到最新的包
+    versionManager->RefreshVersionGraph();
+
     g_logger<<"[INFO] "<<LANG("info_rollback_succed1")<<newVersion<<LANG("info_rollback_succed2")<<std::endl;
     return true;
+}
+
+bool UpdateGenerator::PublishObjects(const Snapshot& snapshot) {
+    ObjectStoreStats stats;
+    if(!objectStore->PutSnapshot(snapshot,config.GetWorkspace(),readOptions,&stats)) {
+        g_logger<<LANG("error_object_store_publish")<<std::endl;
+        return false;
+    }
+    std::ostringstream line;
+    line<<LANG("info_objects_stored")<<stats.stored<<" ("<<stats.storedBytes<<" B)"
+        <<LANG("info_objects_reused")<<stats.reused;
+    g_logger<<"[INFO] "<<line.str()<<std::endl;
+
+    PublishChunks(snapshot);
+    PublishPrecompressed(snapshot);
+    return true;
+}
+
+// 分块只是可选的下载方式，失败时客户端仍可下载整个文件，所以不影响版本生成
+void UpdateGenerator::PublishChunks(const Snapshot& snapshot) {
+    if(config.GetChunkThresholdMb()<=0) {
+        return;
+    }
+    uint64_t threshold=static_cast<uint64_t>(config.GetChunkThresholdMb())*1024*1024;
+    ObjectStoreStats stats;
+    size_t fileCount=0;
+    for(const auto& file:snapshot.GetFiles()) {
+        if(file.size<threshold||chunkStore->HasChunkList(file.hash)) {
+            continue;
+        }
+        MappedFile content;
+        if(!content.Open(objectStore->GetObjectPath(file.hash))||
+            !chunkStore->AddFile(file.hash,content.GetData(),content.GetSize(),&stats)) {
+            g_logger<<"[WARNING] "<<LANG("warning_chunk_store")<<snapshot.GetPath(file.path)<<std::endl;
+            continue;
+        }
+        ++fileCount;
+    }
+    if(fileCount>0) {
+        std::ostringstream line;
+        line<<LANG("info_chunks_stored")<<fileCount<<" / "<<stats.stored<<" ("<<stats.storedBytes<<" B)"
+            <<LANG("info_objects_reused")<<stats.reused;
+        g_logger<<"[INFO] "<<line.str()<<std::endl;
+    }
+}
+
+// 与分块相同，预压缩失败只影响传输大小，不影响版本生成
+void UpdateGenerator::PublishPrecompressed(const Snapshot& snapshot) {
+    if(!config.GetPrecompress()) {
+        return;
+    }
+    // 太小的文件压缩后省不了几个字节；太大的文件走分块或整包下载，也不值得在发布时花时间
+    const uint64_t kMinSize=1024;
+    const uint64_t kMaxSize=32ull*1024*1024;
+    // 本身已经压缩过的格式（Minecraft 的 .jar/.mca/.nbt 等），再压缩几乎没有收益
+    static const std::unordered_set<std::string> kCompressedExtensions={
+        ".jar",".zip",".gz",".zst",".br",".xz",".7z",".rar",".png",".jpg",".jpeg",".gif",".webp",
+        ".ogg",".mp3",".mp4",".woff2",".mca",".mcr",".nbt",".dat",".litematic",".schem"
+    };
+
+    size_t fileCount=0;
+    uint64_t savedBytes=0;
+    std::string compressed;
+    for(const auto& file:snapshot.GetFiles()) {
+        if(file.size<kMinSize||file.size>kMaxSize) {
+            continue;
+        }
+        std::string relativePath=snapshot.GetPath(file.path);
+        std::string extension=std::filesystem::path(relativePath).extension().string();
+        for(char& c:extension) {
+            c=static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        if(kCompressedExtensions.count(extension)) {
+            continue;
+        }
+        // 同一内容只处理一次：已有变体或“不值得”标记说明之前的版本处理过
+        bool processed=objectStore->HasVariant(file.hash,Precompressor::kNoVariantSuffix);
+        for(ContentEncoding encoding:Precompressor::kEncodings) {
+            processed=processed||objectStore->HasVariant(file.hash,Precompressor::FileSuffix(encoding));
+        }
+        if(processed) {
+            continue;
+        }
+
+        MappedFile content;
+        if(!content.Open(objectStore->GetObjectPath(file.hash))) {
+            g_logger<<"[WARNING] "<<LANG("warning_precompress")<<relativePath<<std::endl;
+            continue;
+        }
+        bool stored=false;
+        for(ContentEncoding encoding:Precompressor::kEncodings) {
+            if(!Precompressor::Compress(encoding,content.GetData(),content.GetSize(),compressed)||
+                !Precompressor::IsWorthwhile(content.GetSize(),compressed.size())) {
+                continue;
+            }
+            if(!objectStore->PutVariant(file.hash,Precompressor::FileSuffix(encoding),compressed.data(),compressed.size())) {
+                g_logger<<"[WARNING] "<<LANG("warning_precompress")<<relativePath<<std::endl;
+                continue;
+            }
+            if(!stored) {
+                ++fileCount;
+                savedBytes+=content.GetSize()-compressed.size();
+            }
+            stored=true;
+        }
+        if(!stored) {
+            objectStore->PutVariant(file.hash,Precompressor::kNoVariantSuffix,"",0);
+        }
+    }
+    if(fileCount>0) {
+        std::ostringstream line;
+        line<<LANG("info_precompressed")<<fileCount<<" / "<<savedBytes<<" B";
+        g_logger<<"[INFO] "<<line.str()<<std::endl;
+    }
+}
+
+void UpdateGenerator::PruneFullPackages() {
+    int keep=config.GetMaxFullPackages();
+    if(keep<=0) {
+        return;
+    }
+    auto versions=versionManager->GetVersionList();
+    if(versions.size()<=static_cast<size_t>(keep)) {
+        return;
+    }
+    std::error_code ec;
+    for(size_t i=0; i+keep<versions.size(); ++i) {
+        std::string packagePath=config.GetOutputDir()+"/full/"+versions[i]+".zip";
+        if(std::filesystem::remove(packagePath,ec)) {
+            g_logger<<"[INFO] "<<LANG("info_full_package_pruned")<<versions[i]<<std::endl;
+        }
+    }
+    if(packageIndex->RemoveMissing(config.GetOutputDir())>0) {
+        packageIndex->Save();
+    }
+}
+
+size_t UpdateGenerator::CollectUnreferencedObjects() {
+    // 收集所有保留版本引用的摘要；任一快照读不出来时不做清理，宁可多留对象
+    std::unordered_set<Digest,DigestHash> liveDigests;
+    for(const auto& version:versionManager->GetVersionList()) {
+        SnapshotFile snapshot;
+        std::string error;
+        if(!snapshot.OpenVersion(config.GetOutputDir()+"/snapshots",version,&error)) {
+            g_logger<<LANG("error_snapshot_invalid")<<error<<std::endl;
+            return 0;
+        }
+        for(size_t i=0; i<snapshot.GetFileCount(); ++i) {
+            liveDigests.insert(SnapshotFile::GetDigest(snapshot.GetFile(i)));
+        }
+    }
+    size_t removed=objectStore->RemoveUnreferenced(liveDigests);
+    removed+=chunkStore->RemoveUnreferenced(liveDigests);
+    g_logger<<"[INFO] "<<LANG("info_objects_removed")<<removed<<std::endl;
+    return removed;
 }
\ No newline at end of file
@@ -9,7 +9,7 @@
 #include "Logger.h"
 
 VersionManager::VersionManager(const std::string& dataDir)
-    : dataDir(dataDir) {
+    : dataDir(dataDir),pathTable(std::make_shared<PathTable>()) {
 }
 
 bool VersionManager::Initialize() {
@@ -19,16 +19,19 @@ bool VersionManager::Initialize() {
     return true;
 }
 
-void VersionManager::LoadVersions() {
+bool VersionManager::LoadVersions() {
     std::string versionsFile=GetVersionsFile();
     if(!std::filesystem::exists(versionsFile)) {
-        return;
+        return true;
     }
 
+    // 先取修改时间再读内容，读取期间文件被改写时下次检查仍会发现变化
+    std::error_code ec;
+    auto fileTime=std::filesystem::last_write_time(versionsFile,ec);
     std::ifstream file(versionsFile);
     if(!file.is_open()) {
         g_logger<<LANG("error_config")<<LANG("error_open_file")<<std::endl;
-        return;
+        return false;
     }
 
     Json::CharReaderBuilder reader;
@@ -38,9 +41,12 @@ void VersionManager::LoadVersions() {
     // 至少应返回错误给调用者，但 LoadVersions 被 Initialize 调用，而 Initialize 总是返回 true。这会导致失败。
     if(!Json::parseFromStream(reader,file,&json,&errors)) {
         g_logger<<LANG("error_config")<<errors<<std::endl;
-        return;
+        return false;
     }
 
+    versionsFileTime=fileTime;
+    generation=json.get("generation",0).asUInt64();
+
     if(json.isMember("versions")&&json["versions"].isArray()) {
         for(const auto& versionJson:json["versions"]) {
             VersionInfo info;
@@ -56,48 +62,91 @@ void VersionManager::LoadVersions() {
 
             if(versionJson.isMember("files")) {
                 for(const auto& file:versionJson["files"]) {
-                    info.files.push_back(file.asString());
+                    info.files.push_back(pathTable->Intern(file.asString()));
                 }
             }
 
             if(versionJson.isMember("directories")) {
                 for(const auto& dir:versionJson["directories"]) {
-                    info.directories.push_back(dir.asString());
+                    info.directories.push_back(pathTable->Intern(dir.asString()));
                 }
             }
 
             versions[info.version]=info;
         }
     }
+    return true;
 }
 
-bool VersionManager::Save() {
-    return SaveVersions();
+bool VersionManager::HasChangedOnDisk() const {
+    std::error_code ec;
+    auto fileTime=std::filesystem::last_write_time(GetVersionsFile(),ec);
+    if(ec) {
+        return false;
+    }
+    // 修改时间的精度有限，刚写过的文件可能在同一时间刻度内再次被改写，稳定之前每次都视为有变化
+    return fileTime!=versionsFileTime||
+        std::filesystem::file_time_type::clock::now()-fileTime<std::chrono::seconds(2);
 }
 
-bool VersionManager::SaveVersions() const {
-    std::string versionsFile=GetVersionsFile();
-    std::ofstream file(versionsFile);
-    if(!file.is_open()) {
-        g_logger<<LANG("error_config")<<LANG("error_open_file")<<std::endl;
+bool VersionManager::ReloadIfChanged() {
+    if(!HasChangedOnDisk()) {
         return false;
     }
+    auto previousVersions=std::move(versions);
+    uint64_t previousGeneration=generation;
+    versions.clear();
+    if(!LoadVersions()) {
+        versions=std::move(previousVersions);
+        generation=previousGeneration;
+        return false;
+    }
+    BuildVersionGraph();
+    return true;
+}
+
+bool VersionManager::Save() {
+    return SaveVersions();
+}
 
+bool VersionManager::SaveVersions() const {
     Json::Value json;
     Json::Value versionsArray(Json::arrayValue);
 
     for(const auto& [version,info]:versions) {
-        versionsArray.append(info.ToJson());
+        versionsArray.append(info.ToJson(*pathTable));
     }
 
     json["versions"]=versionsArray;
+    json["generation"]=static_cast<Json::UInt64>(generation);
 
     Json::StreamWriterBuilder writer;
     writer["indentation"]="  ";
     std::string jsonString=Json::writeString(writer,json);
-	//FIXME:写入可能部分失败（如磁盘满），但函数仍返回 true。
-    file<<jsonString;
 
+    // 写临时文件后改名，serve 进程不会读到写了一半的版本列表
+    std::string versionsFile=GetVersionsFile();
+    std::string tempFile=versionsFile+".tmp";
+    {
+        std::ofstream file(tempFile,std::ios::trunc);
+        if(!file.is_open()) {
+            g_logger<<LANG("error_config")<<LANG("error_open_file")<<std::endl;
+            return false;
+        }
+        file<<jsonString;
+        file.flush();
+        if(!file.good()) {
+            g_logger<<LANG("error_config")<<LANG("error_open_file")<<std::endl;
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempFile,versionsFile,ec);
+    if(ec) {
+        std::filesystem::remove(tempFile,ec);
+        g_logger<<LANG("error_config")<<LANG("error_open_file")<<std::endl;
+        return false;
+    }
     return true;
 }
 //TIP:版本号格式在UpdateGenerator已经验证
@@ -108,6 +157,7 @@ bool VersionManager::AddVersion(const VersionInfo& version) {
     }
 
     versions[version.version]=version;
+    ++generation;
     BuildVersionGraph();
     return SaveVersions();
 }
@@ -119,6 +169,7 @@ bool VersionManager::RemoveVersion(const std::string& version) {
     }
 
     versions.erase(it);
+    ++generation;
     BuildVersionGraph();
     return SaveVersions();
 }
@@ -145,70 +196,94 @@ std::vector<std::string> VersionManager::GetVersionList() const {
 
     return result;
 }
-//FIXME: BFS 逻辑有误
-/*错误的方向：toInfo->incrementalFrom 表示可以从哪些版本升级到 toVersion，即 incrementalFrom 是来源版本。但在 BFS 中，q 中存放当前版本，然后从 currentInfo->incrementalFrom 中找下一个版本，这实际上是在反向搜索：incrementalFrom 是依赖的旧版本，所以从旧版本到新版本应该是 old -> new，而 incrementalFrom 存储的是旧版本列表，因此要到达 toVersion，应该从 fromVersion 开始，不断查找哪些版本可以通过增量包升级到当前版本？不，我们需要正向路径：从 fromVersion 开始，找可以升级到的下一个版本（即 fromVersion 出现在某个版本的 incrementalFrom 中）。因此，正确的正向搜索应该维护一个映射：版本 A 可以通过增量包升级到哪些版本。但现有数据结构只有 incrementalFrom（反向索引）。若要正向搜索，需要构建反向索引或使用 BFS 从目标版本反向搜索到源版本（逆向路径），然后将路径反转。当前代码尝试正向搜索但使用了错误的方向，导致无法找到正确路径。
-
-可达性检查有误：if(std::find(currentInfo->incrementalFrom.begin(), currentInfo->incrementalFrom.end(), current) != ...) 是在检查当前版本是否在 currentInfo->incrementalFrom 中？这实际上是检查 current 能否升级到 currentInfo？但 currentInfo 是当前版本，current 也是当前版本，逻辑混乱。
-
-实际运行时，GetUpdatePath 可能返回空路径或错误路径，导致客户端无法正确获取更新链。*/
 std::vector<std::string> VersionManager::GetUpdatePath(
     const std::string& fromVersion,
     const std::string& toVersion) const {
-
     std::vector<std::string> path;
-
-    // 确保目标版本存在
-    const VersionInfo* toInfo=GetVersion(toVersion);
-    if(!toInfo) {
-        return path;
+    uint64_t totalSize=0;
+    if(!FindCheapestPath(fromVersion,toVersion,path,totalSize)) {
+        path.clear();
     }
+    return path;
+}
 
-    // 检查是否可以直达
-    if(std::find(toInfo->incrementalFrom.begin(),
-        toInfo->incrementalFrom.end(),
-        fromVersion)!=toInfo->incrementalFrom.end()) {
-        path.push_back(toVersion);
-        return path;
+UpdatePlan VersionManager::PlanUpdate(
+    const std::string& fromVersion,
+    const std::string& toVersion) const {
+    UpdatePlan plan;
+    if(fromVersion==toVersion||!GetVersion(toVersion)) {
+        return plan;
     }
 
-    // 使用BFS查找路径
-    std::queue<std::pair<std::string,std::vector<std::string>>> q;
-    std::unordered_set<std::string> visited;
-
-    q.push({fromVersion,{}});
-    visited.insert(fromVersion);
+    std::vector<std::string> path;
+    uint64_t incrementalSize=0;
+    bool hasPath=FindCheapestPath(fromVersion,toVersion,path,incrementalSize);
+    auto full=fullPackageSizes.find(toVersion);
+    // 增量链不比全量包小时没有必要逐个应用增量包
+    if(full!=fullPackageSizes.end()&&(!hasPath||full->second<=incrementalSize)) {
+        plan.reachable=true;
+        plan.useFullPackage=true;
+        plan.steps.push_back(toVersion);
+        plan.totalSize=full->second;
+    }
+    else if(hasPath) {
+        plan.reachable=true;
+        plan.steps=std::move(path);
+        plan.totalSize=incrementalSize;
+    }
+    return plan;
+}
 
-    while(!q.empty()) {
-        auto [current,currentPath]=q.front();
-        q.pop();
+bool VersionManager::FindCheapestPath(const std::string& fromVersion,const std::string& toVersion,
+    std::vector<std::string>& path,uint64_t& totalSize) const {
+    path.clear();
+    totalSize=0;
+    if(fromVersion==toVersion) {
+        return false;
+    }
 
-        // 检查当前版本是否可以升级到目标版本
-        const VersionInfo* currentInfo=GetVersion(current);
-        if(!currentInfo) {
-            continue;
+    using QueueItem=std::pair<uint64_t,std::string>;
+    std::priority_queue<QueueItem,std::vector<QueueItem>,std::greater<QueueItem>> queue;
+    std::unordered_map<std::string,uint64_t> distance;
+    std::unordered_map<std::string,std::string> previous;
+    distance[fromVersion]=0;
+    queue.push({0,fromVersion});
+    while(!queue.empty()) {
+        auto [cost,current]=queue.top();
+        queue.pop();
+        if(cost!=distance[current]) {
+            continue;  // 已有更短的路径
         }
-
-        // 找到直达路径
-        if(std::find(currentInfo->incrementalFrom.begin(),
-            currentInfo->incrementalFrom.end(),
-            current)!=currentInfo->incrementalFrom.end()) {
-            currentPath.push_back(toVersion);
-            return currentPath;
+        if(current==toVersion) {
+            break;
         }
-
-        // 查找下一个可升级的版本
-        for(const auto& nextVersion:currentInfo->incrementalFrom) {
-            if(visited.find(nextVersion)==visited.end()) {
-                visited.insert(nextVersion);
-                std::vector<std::string> newPath=currentPath;
-                newPath.push_back(nextVersion);
-                q.push({nextVersion,newPath});
+        auto edges=forwardEdges.find(current);
+        if(edges==forwardEdges.end()) {
+            continue;
+        }
+        for(const auto& edge:edges->second) {
+            uint64_t next=cost+edge.size;
+            auto it=distance.find(edge.to);
+            if(it==distance.end()||next<it->second) {
+                distance[edge.to]=next;
+                previous[edge.to]=current;
+                queue.push({next,edge.to});
             }
         }
     }
 
-    return path;
+    auto target=distance.find(toVersion);
+    if(target==distance.end()) {
+        return false;
+    }
+    totalSize=target->second;
+    for(std::string version=toVersion; version!=fromVersion; version=previous[version]) {
+        path.push_back(version);
+    }
+    std::reverse(path.begin(),path.end());
+    return true;
 }
+
 //FIXME:版本号字符串比较不是语义比较，且“较小的版本”不一定是共同祖先。
 std::string VersionManager::FindCommonAncestor(
     const std::string& version1,
@@ -218,9 +293,47 @@ std::string VersionManager::FindCommonAncestor(
     return version1<version2?version1:version2;
 }
 
+bool VersionManager::RefreshVersionGraph() {
+    BuildVersionGraph();
+    ++generation;
+    return SaveVersions();
+}
+
 void VersionManager::BuildVersionGraph() {
-    // 这里可以构建版本依赖关系的图结构
-    // 暂时使用简单的实现
+    forwardEdges.clear();
+    fullPackageSizes.clear();
+
+    // 包位于 dataDir 的父目录（输出目录）下，与 DeleteVersion 一致
+    std::filesystem::path outDir=std::filesystem::path(dataDir).parent_path();
+    std::error_code ec;
+
+    // 只有实际存在的增量包才是可走的边，incrementalFrom 中记录但已被删除的包不算
+    for(const auto& entry:std::filesystem::directory_iterator(outDir/"incremental",ec)) {
+        if(!entry.is_regular_file(ec)||entry.path().extension()!=".zip") {
+            continue;
+        }
+        std::string name=entry.path().stem().u8string();
+        uint64_t size=entry.file_size(ec);
+        if(ec) {
+            continue;
+        }
+        // 版本号本身可能含有 "_to_"，逐个位置尝试，两边都是已知版本才算
+        for(size_t pos=name.find("_to_"); pos!=std::string::npos; pos=name.find("_to_",pos+1)) {
+            std::string from=name.substr(0,pos);
+            std::string to=name.substr(pos+4);
+            if(versions.count(from)&&versions.count(to)) {
+                forwardEdges[from].push_back({to,size});
+                break;
+            }
+        }
+    }
+
+    for(const auto& [version,_]:versions) {
+        uint64_t size=std::filesystem::file_size(outDir/"full"/(version+".zip"),ec);
+        if(!ec) {
+            fullPackageSizes[version]=size;
+        }
+    }
 }
 
 std::string VersionManager::GetVersionsFile() const {
@@ -254,6 +367,8 @@ bool VersionManager::DeleteVersion(const std::string& version) {
 
     // 删除该版本
     versions.erase(version);
+    ++generation;
+    BuildVersionGraph();
 
     // 保存更新后的 versions.json
     if(!SaveVersions())
@@ -262,7 +377,8 @@ bool VersionManager::DeleteVersion(const std::string& version) {
     // 获取输出目录（dataDir 的父目录）
     std::filesystem::path outDir=std::filesystem::path(dataDir).parent_path();
 	//FIXME: 删除文件时未检查返回值
-    // 删除快照文件
+    // 删除快照文件（二进制快照及旧版本/导出的 JSON）
+    std::filesystem::remove(outDir/"snapshots"/(version+".snap"));
     std::filesystem::remove(outDir/"snapshots"/(version+".json"));
 
     // 删除全量包
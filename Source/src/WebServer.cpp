@@ -1,4 +1,8 @@
 ﻿#include "WebServer.h"
+#include "SnapshotFile.h"
+#include "PackageIndex.h"
+#include "PackageBuilder.h"
+#include <unordered_set>
 #include "Language.h"
 #include <fstream>
 #include <iostream>
@@ -7,6 +11,9 @@
 #include "Logger.h"
 #include <windows.h>
 #include <cctype>
+#include <ctime>
+#include <cstdlib>
+#include <algorithm>
 /*
 未处理 + 号：应解码为空格，但当前未做。
 
@@ -54,25 +61,181 @@ static std::string UrlEncode(const std::string& value) {
     return escaped.str();
 }
 
-static std::wstring Utf8ToWide(const std::string& utf8) {
-    if(utf8.empty()) return L"";
-    int wlen=MultiByteToWideChar(CP_UTF8,0,utf8.c_str(),-1,nullptr,0);
-    if(wlen<=0) return L"";
-    std::wstring wstr(wlen-1,0);
-    MultiByteToWideChar(CP_UTF8,0,utf8.c_str(),-1,&wstr[0],wlen);
-    return wstr;
+// RFC 9110 的 HTTP-date（IMF-fixdate），如 "Sun, 06 Nov 1994 08:49:37 GMT"
+static std::string FormatHttpDate(std::time_t time) {
+    std::tm gmt{};
+#ifdef _WIN32
+    gmtime_s(&gmt,&time);
+#else
+    gmtime_r(&time,&gmt);
+#endif
+    std::ostringstream ss;
+    ss.imbue(std::locale::classic());
+    ss<<std::put_time(&gmt,"%a, %d %b %Y %H:%M:%S GMT");
+    return ss.str();
+}
+
+// 客户端缓存是否仍然有效。有 If-None-Match 时只看它（弱比较，支持 * 和逗号分隔的列表）；
+// 否则 If-Modified-Since 与 Last-Modified 完全一致才算未修改（客户端总是回传服务器给出的值）
+static bool IsNotModified(const crow::request& req,const std::string& etag,const std::string& lastModified) {
+    std::string ifNoneMatch=req.get_header_value("If-None-Match");
+    if(!ifNoneMatch.empty()) {
+        std::istringstream tags(ifNoneMatch);
+        std::string tag;
+        while(std::getline(tags,tag,',')) {
+            size_t begin=tag.find_first_not_of(" \t");
+            size_t end=tag.find_last_not_of(" \t");
+            if(begin==std::string::npos) {
+                continue;
+            }
+            tag=tag.substr(begin,end-begin+1);
+            if(tag.compare(0,2,"W/")==0) {
+                tag.erase(0,2);
+            }
+            if(tag=="*"||tag==etag) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return !lastModified.empty()&&req.get_header_value("If-Modified-Since")==lastModified;
+}
+
+static crow::response NotModified(const std::string& etag,const std::string& lastModified,const std::string& cacheControl) {
+    crow::response res(304);
+    // 304 没有响应体，也不能带 Content-Length: 0
+    res.manual_length_header=true;
+    res.set_header("ETag",etag);
+    if(!lastModified.empty()) {
+        res.set_header("Last-Modified",lastModified);
+    }
+    res.set_header("Cache-Control",cacheControl);
+    return res;
+}
+
+// Accept-Encoding 中某个编码的 q 值；未列出时取 * 的值，都没有时返回 -1（不可接受）
+static double AcceptEncodingQuality(const std::string& header,const std::string& name) {
+    double wildcard=-1;
+    std::istringstream items(header);
+    std::string item;
+    while(std::getline(items,item,',')) {
+        size_t params=item.find(';');
+        std::string token=item.substr(0,params);
+        token.erase(std::remove_if(token.begin(),token.end(),[](unsigned char c) { return std::isspace(c); }),token.end());
+        for(char& c:token) {
+            c=static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        double quality=1;
+        size_t q=params==std::string::npos?std::string::npos:item.find("q=",params);
+        if(q!=std::string::npos) {
+            quality=std::strtod(item.c_str()+q+2,nullptr);
+        }
+        if(token==name) {
+            return quality;
+        }
+        if(token=="*") {
+            wildcard=quality;
+        }
+    }
+    return wildcard;
+}
+
+enum class RangeRequest {
+    None,           // 没有 Range 或格式无法识别：按规范忽略，返回完整内容
+    Single,         // 单个可满足的区间
+    Multiple,       // 多个区间：不支持 multipart/byteranges，直接拒绝
+    Unsatisfiable   // 区间起点超出文件大小
+};
+
+static bool ParseRangeNumber(const std::string& text,uint64_t& value) {
+    if(text.empty()||text.size()>19) {
+        return false;
+    }
+    value=0;
+    for(char c:text) {
+        if(c<'0'||c>'9') {
+            return false;
+        }
+        value=value*10+static_cast<uint64_t>(c-'0');
+    }
+    return true;
+}
+
+// 解析 "bytes=first-last" / "bytes=first-" / "bytes=-suffix"，结果裁剪到文件范围内
+static RangeRequest ParseRangeHeader(const std::string& header,uint64_t size,uint64_t& offset,uint64_t& length) {
+    std::string spec;
+    for(char c:header) {
+        if(c!=' '&&c!='\t') {
+            spec+=c;
+        }
+    }
+    if(spec.size()<6||spec.compare(0,6,"bytes=")!=0) {
+        return RangeRequest::None;
+    }
+    spec.erase(0,6);
+    if(spec.find(',')!=std::string::npos) {
+        return RangeRequest::Multiple;
+    }
+    size_t dash=spec.find('-');
+    if(dash==std::string::npos) {
+        return RangeRequest::None;
+    }
+    std::string firstText=spec.substr(0,dash);
+    std::string lastText=spec.substr(dash+1);
+    uint64_t first=0,last=0;
+    if(firstText.empty()) {
+        // 后缀形式：最后 N 个字节
+        if(!ParseRangeNumber(lastText,last)) {
+            return RangeRequest::None;
+        }
+        if(last==0||size==0) {
+            return RangeRequest::Unsatisfiable;
+        }
+        length=std::min(last,size);
+        offset=size-length;
+        return RangeRequest::Single;
+    }
+    if(!ParseRangeNumber(firstText,first)) {
+        return RangeRequest::None;
+    }
+    if(lastText.empty()) {
+        last=UINT64_MAX;
+    }
+    else if(!ParseRangeNumber(lastText,last)||last<first) {
+        return RangeRequest::None;
+    }
+    if(first>=size) {
+        return RangeRequest::Unsatisfiable;
+    }
+    offset=first;
+    length=std::min(last,size-1)-first+1;
+    return RangeRequest::Single;
 }
 
 WebServer::WebServer(const Config& config,
     VersionManager& versionManager,
     const std::string& workspace)
-    : config(config),versionManager(versionManager),workspace(workspace) {
+    : config(config),versionManager(versionManager),workspace(workspace),
+    objectStore(config.GetOutputDir()+"/objects"),chunkStore(config.GetOutputDir()+"/chunks") {
     app=std::make_unique<crow::SimpleApp>();
 }
 
 bool WebServer::Start() {
     SetupRoutes();
 
+    // 启动时先生成最新版本的更新信息，客户端的第一次请求也不用等待
+    auto versions=versionManager.GetVersionList();
+    if(!versions.empty()) {
+        GetUpdateInfoDocument(versions.back());
+    }
+
+    if(config.GetWatchWorkspace()) {
+        watcher=std::make_unique<WorkspaceWatcher>(workspace);
+        if(!watcher->Start()) {
+            watcher.reset();
+        }
+    }
+
     g_logger<<LANG("server_start_at")
         <<config.GetServerHost()<<":"
         <<config.GetServerPort()<<std::endl;
@@ -92,6 +255,9 @@ bool WebServer::Start() {
 
 void WebServer::Stop() {
     g_logger<<LANG("server_stop")<<std::endl;
+    if(watcher) {
+        watcher->Stop();
+    }
     // Crow没有正式的stop方法，可以通过其他方式停止
 }
 
@@ -106,6 +272,11 @@ void WebServer::SetupRoutes() {
         return this->HandleVersionList(req);
             });
 
+    CROW_ROUTE((*app),"/api/delta")
+        .methods("GET"_method,"POST"_method)([this](const crow::request& req) {
+        return this->HandleDelta(req);
+            });
+
     CROW_ROUTE((*app),"/api/status")
         .methods("GET"_method)([this](const crow::request& req) {
         return this->HandleStatus(req);
@@ -121,6 +292,11 @@ void WebServer::SetupRoutes() {
         return this->HandlePackageDownload(req,package);
             });
 
+    CROW_ROUTE((*app),"/chunks/<string>")
+        .methods("GET"_method)([this](const crow::request& req,const std::string& digest) {
+        return this->HandleChunkDownload(req,digest);
+            });
+
     // 静态文件服务
     CROW_ROUTE((*app),"/")
         ([]() {
@@ -130,6 +306,7 @@ void WebServer::SetupRoutes() {
 
 crow::response WebServer::HandleUpdateInfo(const crow::request& req) {
     g_logger<<LANG("request_update")<<std::endl;
+    auto versionLock=LockVersions();
 
     // 获取目标版本
     std::string version="latest";
@@ -139,7 +316,6 @@ crow::response WebServer::HandleUpdateInfo(const crow::request& req) {
     }
 
     // 如果请求最新版本，获取最新的版本号
-    //FIXME:若指定版本不存在，应返回 404。当前代码未处理指定版本不存在的情况
     if(version=="latest") {
         auto versions=versionManager.GetVersionList();
         if(!versions.empty()) {
@@ -152,12 +328,28 @@ crow::response WebServer::HandleUpdateInfo(const crow::request& req) {
         }
     }
 
-    // 生成更新信息
-    Json::Value updateInfo=GenerateUpdateInfo(version);
+    // 未知版本直接 404，不生成可缓存的 null 文档
+    const VersionInfo* versionInfo=versionManager.GetVersion(version);
+    if(!versionInfo) {
+        crow::response res(404);
+        res.write(LANG("error_version_not_exist")+version);
+        return res;
+    }
+
+    // 版本列表不变时同一版本的更新信息不变：ETag 由版本代数和版本号组成，命中时不再生成 JSON
+    // 版本号取自版本记录而不是请求参数，请求文本不进入响应头
+    std::string etag="\""+std::to_string(versionManager.GetGeneration())+"-"+versionInfo->version+"\"";
+    if(IsNotModified(req,etag,std::string())) {
+        return NotModified(etag,std::string(),"no-cache");
+    }
+
+    std::shared_ptr<const std::string> document=GetUpdateInfoDocument(versionInfo->version);
 
     crow::response res;
     res.set_header("Content-Type","application/json");
-    res.write(Json::FastWriter().write(updateInfo));
+    res.set_header("ETag",etag);
+    res.set_header("Cache-Control","no-cache");
+    res.write(*document);
     return res;
 }
 //FIXME:攻击者可构造 ../ 跳出工作空间目录，访问系统任意文件。例如 /files/../../etc/passwd。crow 不会自动清理路径参数..
@@ -165,46 +357,43 @@ crow::response WebServer::HandleFileDownload(const crow::request& req,const std:
     // 先进行 URL 解码
     std::string decodedPath=UrlDecode(filepath);
     g_logger<<LANG("request_download")<<": "<<decodedPath<<std::endl;
+    auto versionLock=LockVersions();
 
-    std::string fullPath=workspace+"/"+decodedPath;
-    g_logger<<"[DEBUG] FullPath: "<<fullPath<<std::endl;
-
-#ifdef _WIN32
-    std::wstring wFullPath=Utf8ToWide(fullPath);
-    FILE* file=_wfopen(wFullPath.c_str(),L"rb");
-#else
-    FILE* file=fopen(fullPath.c_str(),"rb");
-#endif
-
-    if(!file) {
-        g_logger<<"[ERROR] Failed to open file: "<<fullPath<<std::endl;
+    std::string version;
+    auto versionParam=req.url_params.get("version");
+    if(versionParam) {
+        version=versionParam;
+    }
+    Digest digest;
+    std::string fullPath=ResolveFilePath(decodedPath,version,&digest);
+    if(fullPath.empty()) {
         crow::response res(404);
         res.write(LANG("info_file_not_found_simple")+": "+decodedPath);
         return res;
     }
 
-    // 获取文件大小
-    fseek(file,0,SEEK_END);
-    long fileSize=ftell(file);
-    fseek(file,0,SEEK_SET);
-
-    // 读取文件内容
-    //FIXME:未处理大文件内存问题
-    std::vector<char> buffer(fileSize);
-    size_t bytesRead=fread(buffer.data(),1,fileSize,file);
-    fclose(file);
-
-    if(bytesRead!=static_cast<size_t>(fileSize)) {
-        crow::response res(500);
-        res.write(LANG("error_read_file")+": "+decodedPath);
-        return res;
+    // 来自对象库的文件以内容摘要作为 ETag；同一路径在不同版本间内容可能变化，需要客户端重新验证。
+    // 有预压缩变体时直接返回变体，不同编码是不同的表示，ETag 也要区分
+    std::string etag;
+    ContentEncoding encoding=ContentEncoding::Identity;
+    if(!digest.Empty()) {
+        etag="\""+digest.ToHex()+"\"";
+        encoding=SelectEncoding(req.get_header_value("Accept-Encoding"),digest);
+        if(encoding!=ContentEncoding::Identity) {
+            fullPath=objectStore.GetVariantPath(digest,Precompressor::FileSuffix(encoding));
+            etag="\""+digest.ToHex()+"-"+Precompressor::EncodingName(encoding)+"\"";
+        }
     }
+    g_logger<<"[DEBUG] FullPath: "<<fullPath<<std::endl;
 
-    crow::response res;
-    res.set_header("Content-Type",GetMimeType(decodedPath));
-    res.set_header("Content-Disposition","attachment; filename=\""+
-        std::filesystem::path(decodedPath).filename().string()+"\"");
-    res.write(std::string(buffer.data(),buffer.size()));
+    crow::response res=ServeFile(req,fullPath,GetMimeType(decodedPath),
+        std::filesystem::u8path(decodedPath).filename().u8string(),decodedPath,etag,false);
+    if(!digest.Empty()) {
+        res.set_header("Vary","Accept-Encoding");
+    }
+    if(encoding!=ContentEncoding::Identity&&(res.code==200||res.code==206)) {
+        res.set_header("Content-Encoding",Precompressor::EncodingName(encoding));
+    }
     return res;
 }
 
@@ -225,7 +414,6 @@ crow::response WebServer::HandlePackageDownload(const crow::request& req,const s
         // 先尝试 full 目录
         fullPath=config.GetOutputDir()+"/full/"+decodedPackage;
         // 如果不存在，再尝试 packages 目录（目录包）
-        // 直接使用文件打开尝试，不依赖 FileExists
     }
     else {
         crow::response res(400);
@@ -233,64 +421,173 @@ crow::response WebServer::HandlePackageDownload(const crow::request& req,const s
         return res;
     }
 
-    // 3. 尝试打开文件（先尝试 full 路径，若失败再试 packages 路径）
-    FILE* file=nullptr;
-#ifdef _WIN32
-    std::wstring wFullPath=Utf8ToWide(fullPath);
-    file=_wfopen(wFullPath.c_str(),L"rb");
-#else
-    file=fopen(fullPath.c_str(),"rb");
-#endif
-
-    // 如果第一次打开失败，且包名可能是目录包，则尝试 packages 目录
+    // 3. 先尝试 full 路径，若不存在且包名可能是目录包，则尝试 packages 目录
     /*
     路径遍历漏洞：未对用户输入进行充分校验，可能允许恶意路径访问（如 ../）。
 
     回退逻辑缺陷：当 /packages/full/1.0.0.zip 不存在时，错误地回退到 /packages/1.0.0.zip，可能返回同名的目录包（如 /packages/dir/1.0.0.zip），导致客户端下载错误内容。
 
     */
-    if(!file&&decodedPackage.find("_to_")==std::string::npos&&decodedPackage!="root.zip") {
-        // 尝试 packages 目录
-        std::string altPath=config.GetOutputDir()+"/packages/"+decodedPackage;
-#ifdef _WIN32
-        std::wstring wAltPath=Utf8ToWide(altPath);
-        file=_wfopen(wAltPath.c_str(),L"rb");
-#else
-        file=fopen(altPath.c_str(),"rb");
-#endif
-        if(file) fullPath=altPath;
+    std::error_code ec;
+    if(!std::filesystem::is_regular_file(std::filesystem::u8path(fullPath),ec)&&
+        decodedPackage.find("_to_")==std::string::npos&&decodedPackage!="root.zip") {
+        fullPath=config.GetOutputDir()+"/packages/"+decodedPackage;
     }
 
-    if(!file) {
-        g_logger<<"[ERROR] Failed to open package: "<<decodedPackage<<std::endl;
+    // 4. 流式返回
+    return ServeFile(req,fullPath,"application/zip",decodedPackage,decodedPackage,std::string(),false);
+}
+
+// 分块以摘要命名，路径完全由十六进制摘要决定，不存在路径穿越问题。
+// URL 中只有十六进制，按摘要长度依次尝试可能的算法
+crow::response WebServer::HandleChunkDownload(const crow::request& req,const std::string& digest) {
+    static const HashAlgorithm kAlgorithms[]={
+        HashAlgorithm::SHA256,HashAlgorithm::BLAKE3,HashAlgorithm::SHA1,HashAlgorithm::MD5,HashAlgorithm::XXH3_128
+    };
+    g_logger<<LANG("request_chunk")<<": "<<digest<<std::endl;
+
+    std::string chunkPath;
+    Digest chunkDigest;
+    for(HashAlgorithm algorithm:kAlgorithms) {
+        chunkDigest=Digest::FromHex(digest,algorithm);
+        if(chunkDigest.Empty()||digest.size()!=HashProvider::DigestLength(algorithm)*2) {
+            continue;
+        }
+        if(chunkStore.ContainsChunk(chunkDigest)) {
+            chunkPath=chunkStore.GetChunkPath(chunkDigest);
+            break;
+        }
+    }
+    if(chunkPath.empty()) {
         crow::response res(404);
-        res.write(LANG("info_file_not_found_simple")+": "+decodedPackage);
+        res.write(LANG("info_file_not_found_simple")+": "+digest);
         return res;
     }
 
-    // 4. 读取文件内容
-    fseek(file,0,SEEK_END);
-    long fileSize=ftell(file);
-    fseek(file,0,SEEK_SET);
-    std::vector<char> buffer(fileSize);
-    size_t bytesRead=fread(buffer.data(),1,fileSize,file);
-    fclose(file);
+    // 分块的 URL 就是内容摘要，内容永远不会变化
+    return ServeFile(req,chunkPath,"application/octet-stream",std::string(),digest,
+        "\""+chunkDigest.ToHex()+"\"",true);
+}
+
+// GET /api/delta?from=&to=：两个已发布版本之间的变更，结果按版本对缓存。
+// POST /api/delta?to=：请求体为客户端当前的文件列表
+//   {"hash_algorithm":"sha256","files":[{"path":"...","hash":"...","size":0}],"directories":["..."]}，
+// 返回从客户端现状到目标版本的变更。客户端的文件可能被改动过，这种结果不缓存
+crow::response WebServer::HandleDelta(const crow::request& req) {
+    g_logger<<LANG("request_delta")<<std::endl;
+    auto versionLock=LockVersions();
 
-    if(bytesRead!=static_cast<size_t>(fileSize)) {
-        crow::response res(500);
-        res.write(LANG("error_read_file")+": "+decodedPackage);
+    std::string toVersion="latest";
+    auto toParam=req.url_params.get("to");
+    if(toParam) {
+        toVersion=toParam;
+    }
+    if(toVersion=="latest") {
+        auto versions=versionManager.GetVersionList();
+        if(versions.empty()) {
+            crow::response res(404);
+            res.write(LANG("error_no_versions"));
+            return res;
+        }
+        toVersion=versions.back();
+    }
+    if(!versionManager.GetVersion(toVersion)) {
+        crow::response res(404);
+        res.write(LANG("error_version_not_exist")+toVersion);
         return res;
     }
 
-    // 5. 返回响应
+    // 相似度配对需要比较内容时从对象库读取
+    auto resolver=[this](const Digest& hash) {
+        return objectStore.Contains(hash)?objectStore.GetObjectPath(hash):std::string();
+    };
+    // 每次比较使用独立的路径表，并发请求之间互不影响
+    auto paths=std::make_shared<PathTable>();
+
+    if(req.method==crow::HTTPMethod::Post) {
+        Snapshot targetSnapshot(paths);
+        if(!LoadVersionSnapshot(toVersion,paths,targetSnapshot)) {
+            crow::response res(500);
+            res.write(LANG("error_snapshot_invalid")+toVersion);
+            return res;
+        }
+        Json::Value body;
+        Json::CharReaderBuilder reader;
+        std::unique_ptr<Json::CharReader> parser(reader.newCharReader());
+        std::string error;
+        Snapshot clientSnapshot(paths);
+        if(!parser->parse(req.body.data(),req.body.data()+req.body.size(),&body,&error)||
+            !BuildClientSnapshot(body,targetSnapshot.GetHashAlgorithm(),paths,clientSnapshot,error)) {
+            crow::response res(400);
+            res.write(error);
+            return res;
+        }
+
+        DiffEngine diffEngine;
+        diffEngine.SetVerbose(false);
+        diffEngine.SetContentResolver(resolver);
+        auto changes=diffEngine.CalculateDiff(clientSnapshot,targetSnapshot);
+
+        crow::response res;
+        res.set_header("Content-Type","application/json");
+        res.set_header("Cache-Control","no-store");
+        res.write(Json::FastWriter().write(DeltaToJson(std::string(),toVersion,targetSnapshot.GetHashAlgorithm(),changes)));
+        return res;
+    }
+
+    auto fromParam=req.url_params.get("from");
+    if(!fromParam) {
+        crow::response res(400);
+        res.write("from is required");
+        return res;
+    }
+    std::string fromVersion=fromParam;
+    if(!versionManager.GetVersion(fromVersion)) {
+        crow::response res(404);
+        res.write(LANG("error_version_not_exist")+fromVersion);
+        return res;
+    }
+
+    uint64_t generation=versionManager.GetGeneration();
+    std::string etag="\""+std::to_string(generation)+"-"+fromVersion+"-"+toVersion+"\"";
+    if(IsNotModified(req,etag,std::string())) {
+        return NotModified(etag,std::string(),"no-cache");
+    }
+
+    std::string key=fromVersion+"\n"+toVersion;
+    std::shared_ptr<const std::string> document=deltaCache.Find(key,generation);
+    if(!document) {
+        Snapshot fromSnapshot(paths);
+        Snapshot toSnapshot(paths);
+        if(!LoadVersionSnapshot(fromVersion,paths,fromSnapshot)||!LoadVersionSnapshot(toVersion,paths,toSnapshot)) {
+            crow::response res(500);
+            res.write(LANG("error_snapshot_invalid")+fromVersion+" / "+toVersion);
+            return res;
+        }
+        DiffEngine diffEngine;
+        diffEngine.SetVerbose(false);
+        diffEngine.SetContentResolver(resolver);
+        auto changes=diffEngine.CalculateDiff(fromSnapshot,toSnapshot);
+        document=std::make_shared<const std::string>(
+            Json::FastWriter().write(DeltaToJson(fromVersion,toVersion,toSnapshot.GetHashAlgorithm(),changes)));
+        deltaCache.Insert(key,generation,document);
+    }
+
     crow::response res;
-    res.set_header("Content-Type","application/zip");
-    res.set_header("Content-Disposition","attachment; filename=\""+decodedPackage+"\"");
-    res.write(std::string(buffer.data(),buffer.size()));
+    res.set_header("Content-Type","application/json");
+    res.set_header("ETag",etag);
+    res.set_header("Cache-Control","no-cache");
+    res.write(*document);
     return res;
 }
 
 crow::response WebServer::HandleVersionList(const crow::request& req) {
+    auto versionLock=LockVersions();
+    std::string etag="\""+std::to_string(versionManager.GetGeneration())+"\"";
+    if(IsNotModified(req,etag,std::string())) {
+        return NotModified(etag,std::string(),"no-cache");
+    }
+
     auto versions=versionManager.GetVersionList();
 
     Json::Value json;
@@ -302,19 +599,29 @@ crow::response WebServer::HandleVersionList(const crow::request& req) {
 
     crow::response res;
     res.set_header("Content-Type","application/json");
+    res.set_header("ETag",etag);
+    res.set_header("Cache-Control","no-cache");
     res.write(Json::FastWriter().write(json));
     return res;
 }
 
 crow::response WebServer::HandleStatus(const crow::request& req) {
+    auto versionLock=LockVersions();
     Json::Value json;
     json["status"]=LANG("info_running");
     json["workspace"]=workspace;
     json["output_dir"]=config.GetOutputDir();
     json["versions_count"]=(int)versionManager.GetVersionList().size();
+    json["watching"]=watcher!=nullptr;
+    if(watcher) {
+        json["pending_changes"]=(Json::UInt64)watcher->GetPendingCount();
+        json["pending_full_rescan"]=watcher->IsOverflowed();
+    }
 
+    // 状态随工作空间变化，不允许缓存
     crow::response res;
     res.set_header("Content-Type","application/json");
+    res.set_header("Cache-Control","no-store");
     res.write(Json::FastWriter().write(json));
     return res;
 }
@@ -325,85 +632,114 @@ Json::Value WebServer::GenerateUpdateInfo(const std::string& version) const {
         return Json::Value();
     }
 
-    // 加载版本快照
-    std::string snapshotFile=config.GetOutputDir()+"/snapshots/"+version+".json";
-    std::ifstream snapshotStream(snapshotFile);
-    Json::Value snapshot;
-    if(snapshotStream.is_open()) {
-        Json::CharReaderBuilder reader;
-        std::string errors;
-        Json::parseFromStream(reader,snapshotStream,&snapshot,&errors);
+    // 映射版本快照，直接遍历文件中的记录，不再构建内存中的 Snapshot
+    SnapshotFile snapshot;
+    std::string errors;
+    if(!snapshot.OpenVersion(config.GetOutputDir()+"/snapshots",version,&errors)) {
+        g_logger<<LANG("error_snapshot_invalid")<<errors<<std::endl;
     }
+    size_t fileCount=snapshot.IsOpen()?snapshot.GetFileCount():0;
+    size_t directoryCount=snapshot.IsOpen()?snapshot.GetDirectoryCount():0;
+    HashAlgorithm algorithm=snapshot.IsOpen()?snapshot.GetHashAlgorithm():HashAlgorithm::Unknown;
 
     Json::Value updateInfo;
     updateInfo["version"]=versionInfo->version;
     updateInfo["update_mode"]="hash";
+    // 旧快照没有记录算法时沿用默认的 sha256
+    updateInfo["hash_algorithm"]=algorithm!=HashAlgorithm::Unknown?
+        HashProvider::AlgorithmName(algorithm):"sha256";
+    // 带 chunks 的文件可以按分块增量下载：chunk_url + 分块摘要，分块按顺序拼接即为完整文件
+    updateInfo["chunk_url"]=config.GetBaseUrl()+"/chunks/";
+    uint64_t chunkThreshold=config.GetChunkThresholdMb()>0?
+        static_cast<uint64_t>(config.GetChunkThresholdMb())*1024*1024:UINT64_MAX;
+    std::vector<ChunkRef> chunks;
+    // 文件地址固定到本文档的版本，发布新版本后客户端下载到的仍是这里列出的内容
+    std::string versionQuery="?version="+UrlEncode(versionInfo->version);
 
     // 文件列表
     Json::Value filesArray(Json::arrayValue);
-    if(snapshot.isMember("files")) {
-        for(const auto& fileJson:snapshot["files"]) {
-            if(!fileJson["is_directory"].asBool()) {
-                Json::Value fileInfo;
-                fileInfo["path"]=fileJson["path"];
-                fileInfo["hash"]=fileJson["hash"];
-                std::string encodedPath=UrlEncode(fileJson["path"].asString());
-                fileInfo["url"]=config.GetBaseUrl()+"/files/"+encodedPath;
-                fileInfo["size"]=fileJson["size"];
-                filesArray.append(fileInfo);
+    for(size_t i=0; i<fileCount; ++i) {
+        const SnapshotFileRecord& file=snapshot.GetFile(i);
+        std::string path(snapshot.GetPath(file));
+        Digest hash=SnapshotFile::GetDigest(file);
+        Json::Value fileInfo;
+        fileInfo["path"]=path;
+        fileInfo["hash"]=hash.ToHex();
+        fileInfo["hash_algorithm"]=HashProvider::AlgorithmName(hash.algorithm);
+        fileInfo["url"]=config.GetBaseUrl()+"/files/"+UrlEncode(path)+versionQuery;
+        fileInfo["size"]=static_cast<Json::Int64>(file.size);
+        if(file.size>=chunkThreshold&&chunkStore.LoadChunkList(hash,chunks)) {
+            Json::Value chunksArray(Json::arrayValue);
+            for(const auto& chunk:chunks) {
+                Json::Value chunkInfo;
+                chunkInfo["hash"]=chunk.hash.ToHex();
+                chunkInfo["size"]=chunk.size;
+                chunksArray.append(chunkInfo);
             }
+            fileInfo["chunks"]=chunksArray;
         }
+        filesArray.append(fileInfo);
     }
     updateInfo["files"]=filesArray;
 
     // 目录列表
     Json::Value dirsArray(Json::arrayValue);
-    if(snapshot.isMember("directories")) {
-        for(const auto& dirJson:snapshot["directories"]) {
-            Json::Value dirInfo;
-            dirInfo["path"]=dirJson["path"];
-
-            // 检查空目录
-            bool isEmpty=true;
-            if(dirJson.isMember("files")) {
-                for(const auto& fileJson:dirJson["files"]) {
-                    if(!fileJson["is_directory"].asBool()) {
-                        isEmpty=false;
-                        break;
-                    }
-                }
-            }
-            if(isEmpty&&dirJson.isMember("subdirectories")&&!dirJson["subdirectories"].empty()) {
-                isEmpty=false;
-            }
-            dirInfo["is_empty"]=isEmpty;
+    for(size_t i=0; i<directoryCount; ++i) {
+        const SnapshotDirectoryRecord& dir=snapshot.GetDirectory(i);
+        std::string dirPath(snapshot.GetPath(dir));
+        Json::Value dirInfo;
+        dirInfo["path"]=dirPath;
+        dirInfo["is_empty"]=dir.fileCount==0&&dir.childCount==0;
+        // 子树哈希与本地一致时客户端可以跳过整个目录
+        dirInfo["tree_hash"]=SnapshotFile::GetTreeHash(dir).ToHex();
 
-            // 目录包（位于 packages/ 下）
-            std::string packageName=dirJson["path"].asString().empty()?"root.zip":dirJson["path"].asString()+".zip";
-            std::string packagePath=config.GetOutputDir()+"/packages/"+packageName;
-            if(std::filesystem::exists(packagePath)) {
-                std::string encodedPackageName=UrlEncode(packageName);
-                dirInfo["url"]=config.GetBaseUrl()+"/packages/"+encodedPackageName;
-            }
+        // 目录包（位于 packages/ 下）
+        std::string packageName=dirPath.empty()?"root.zip":dirPath+".zip";
+        std::string packagePath=config.GetOutputDir()+"/packages/"+packageName;
+        if(std::filesystem::exists(packagePath)) {
+            std::string encodedPackageName=UrlEncode(packageName);
+            dirInfo["url"]=config.GetBaseUrl()+"/packages/"+encodedPackageName;
+        }
 
-            // 目录内容
-            Json::Value contentsArray(Json::arrayValue);
-            if(dirJson.isMember("files")) {
-                for(const auto& fileJson:dirJson["files"]) {
-                    if(!fileJson["is_directory"].asBool()) {
-                        Json::Value content;
-                        content["path"]=fileJson["path"];
-                        content["hash"]=fileJson["hash"];
-                        contentsArray.append(content);
-                    }
-                }
-            }
-            dirInfo["contents"]=contentsArray;
-            dirsArray.append(dirInfo);
+        // 目录内容
+        Json::Value contentsArray(Json::arrayValue);
+        for(uint32_t j=dir.firstFile; j<dir.firstFile+dir.fileCount&&j<fileCount; ++j) {
+            const SnapshotFileRecord& file=snapshot.GetFile(j);
+            Json::Value content;
+            content["path"]=std::string(snapshot.GetPath(file));
+            content["hash"]=SnapshotFile::GetDigest(file).ToHex();
+            contentsArray.append(content);
         }
+        dirInfo["contents"]=contentsArray;
+        dirsArray.append(dirInfo);
     }
     updateInfo["directories"]=dirsArray;
 
+    // 包的摘要取自打包时写入的包索引；旧包没有记录或大小对不上时才读取整个包计算
+    PackageIndex packageIndex(config.GetOutputDir()+"/data");
+    packageIndex.Load();
+    auto packageHash=[&](const std::string& key,const std::string& packagePath) {
+        const PackageRecord* record=packageIndex.Find(key);
+        std::error_code ec;
+        if(record&&record->hashAlgorithm=="md5"&&std::filesystem::file_size(packagePath,ec)==record->size&&!ec) {
+            return record->hash;
+        }
+        return FileScanner::CalculateFileHash(packagePath,"md5");
+    };
+    // 补丁格式的增量包只对支持 update_patches.txt 的客户端有意义，以附加字段公布，旧客户端会忽略
+    auto addPatchArchive=[&](Json::Value& info,const std::string& baseName) {
+        std::string patchName=baseName+PackageBuilder::kPatchPackageSuffix;
+        std::string patchPath=config.GetOutputDir()+"/incremental/"+patchName;
+        std::error_code ec;
+        uint64_t patchSize=std::filesystem::file_size(patchPath,ec);
+        if(ec) {
+            return;
+        }
+        info["patch_archive"]=config.GetBaseUrl()+"/packages/"+patchName;
+        info["patch_hash"]=packageHash("incremental/"+patchName,patchPath);
+        info["patch_size"]=static_cast<Json::UInt64>(patchSize);
+    };
+
     // 增量包列表（位于 incremental/ 下）
     Json::Value incrementalArray(Json::arrayValue);
     auto versions=versionManager.GetVersionList();
@@ -417,9 +753,10 @@ Json::Value WebServer::GenerateUpdateInfo(const std::string& version) const {
                 Json::Value packageInfo;
                 packageInfo["from_version"]=fromVersion;
                 packageInfo["to_version"]=version;
-                packageInfo["hash"]=FileScanner::CalculateFileHash(packagePath,"md5");
+                packageInfo["hash"]=packageHash("incremental/"+packageName,packagePath);
                 packageInfo["archive"]=config.GetBaseUrl()+"/packages/"+packageName; // 注意：URL 仍使用 /packages/ 前缀
                 packageInfo["manifest"]="update_manifest.txt";
+                addPatchArchive(packageInfo,fromVersion+"_to_"+version);
                 incrementalArray.append(packageInfo);
             }
         }
@@ -432,7 +769,7 @@ Json::Value WebServer::GenerateUpdateInfo(const std::string& version) const {
     if(std::filesystem::exists(fullPackagePath)) {
         Json::Value fullPackageInfo;
         fullPackageInfo["version"]=version;
-        fullPackageInfo["hash"]=FileScanner::CalculateFileHash(fullPackagePath,"md5");
+        fullPackageInfo["hash"]=packageHash("full/"+fullPackageName,fullPackagePath);
         fullPackageInfo["archive"]=config.GetBaseUrl()+"/packages/"+fullPackageName; // URL 仍使用 /packages/
         fullPackageInfo["manifest"]="update_manifest.txt";
         updateInfo["full_package"]=fullPackageInfo;
@@ -447,6 +784,43 @@ Json::Value WebServer::GenerateUpdateInfo(const std::string& version) const {
     }
     updateInfo["package_hashes"]=packageHashes;
 
+    // 各旧版本的更新方案：按下载字节数最少的增量链与全量包比较，落后多个版本的客户端按 steps 依次下载
+    Json::Value updatePlans(Json::objectValue);
+    for(const auto& fromVersion:versions) {
+        if(fromVersion==version) {
+            continue;
+        }
+        UpdatePlan plan=versionManager.PlanUpdate(fromVersion,version);
+        if(!plan.reachable) {
+            continue;
+        }
+        Json::Value planInfo;
+        planInfo["mode"]=plan.useFullPackage?"full":"incremental";
+        Json::Value stepsArray(Json::arrayValue);
+        std::string stepFrom=fromVersion;
+        for(const auto& stepTo:plan.steps) {
+            std::string key=plan.useFullPackage?"full/"+stepTo+".zip":"incremental/"+stepFrom+"_to_"+stepTo+".zip";
+            std::string packagePath=config.GetOutputDir()+"/"+key;
+            std::error_code ec;
+            Json::Value step;
+            step["from_version"]=stepFrom;
+            step["to_version"]=stepTo;
+            step["archive"]=config.GetBaseUrl()+"/packages/"+key.substr(key.find('/')+1);
+            step["hash"]=packageHash(key,packagePath);
+            uint64_t size=std::filesystem::file_size(packagePath,ec);
+            step["size"]=static_cast<Json::UInt64>(ec?0:size);
+            if(!plan.useFullPackage) {
+                addPatchArchive(step,stepFrom+"_to_"+stepTo);
+            }
+            stepsArray.append(step);
+            stepFrom=stepTo;
+        }
+        planInfo["steps"]=stepsArray;
+        planInfo["total_size"]=static_cast<Json::UInt64>(plan.totalSize);
+        updatePlans[fromVersion]=planInfo;
+    }
+    updateInfo["update_plans"]=updatePlans;
+
     // 启动器信息（可配置）
     Json::Value launcher;
     launcher["version"]="0.0.8";
@@ -466,6 +840,299 @@ Json::Value WebServer::GenerateUpdateInfo(const std::string& version) const {
     return updateInfo;
 }
 
+std::shared_lock<std::shared_mutex> WebServer::LockVersions() {
+    int64_t now=std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t last=lastVersionCheck.load();
+    // 只有一个请求负责检查，其余请求直接使用当前数据
+    if(now-last>=1000&&lastVersionCheck.compare_exchange_strong(last,now)) {
+        bool changed=false;
+        {
+            std::shared_lock<std::shared_mutex> lock(versionMutex);
+            changed=versionManager.HasChangedOnDisk();
+        }
+        if(changed) {
+            std::unique_lock<std::shared_mutex> lock(versionMutex);
+            uint64_t generation=versionManager.GetGeneration();
+            // 代数变化后缓存的更新信息、差异和 ETag 随之失效
+            if(versionManager.ReloadIfChanged()&&versionManager.GetGeneration()!=generation) {
+                g_logger<<"[INFO] "<<LANG("info_versions_reloaded")<<versionManager.GetGeneration()<<std::endl;
+            }
+        }
+    }
+    return std::shared_lock<std::shared_mutex>(versionMutex);
+}
+
+std::shared_ptr<const std::string> WebServer::DocumentCache::Find(const std::string& key,uint64_t currentGeneration) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(generation!=currentGeneration) {
+        entries.clear();
+        generation=currentGeneration;
+    }
+    auto it=entries.find(key);
+    if(it==entries.end()) {
+        return nullptr;
+    }
+    it->second.lastUsed=++clock;
+    return it->second.body;
+}
+
+void WebServer::DocumentCache::Insert(const std::string& key,uint64_t currentGeneration,
+    const std::shared_ptr<const std::string>& document) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // 生成期间版本列表已经变化，结果可能过时
+    if(generation!=currentGeneration) {
+        return;
+    }
+    if(entries.size()>=capacity&&entries.find(key)==entries.end()) {
+        auto oldest=std::min_element(entries.begin(),entries.end(),
+            [](const auto& a,const auto& b) { return a.second.lastUsed<b.second.lastUsed; });
+        entries.erase(oldest);
+    }
+    Entry& entry=entries[key];
+    entry.body=document;
+    entry.lastUsed=++clock;
+}
+
+std::shared_ptr<const std::string> WebServer::GetUpdateInfoDocument(const std::string& version) {
+    uint64_t generation=versionManager.GetGeneration();
+    std::shared_ptr<const std::string> document=updateInfoCache.Find(version,generation);
+    if(document) {
+        return document;
+    }
+
+    // 生成时不持有锁，其他版本的请求不受影响；同一版本被并发生成时结果相同，后写入的覆盖即可
+    document=std::make_shared<const std::string>(Json::FastWriter().write(GenerateUpdateInfo(version)));
+    if(!versionManager.GetVersion(version)) {
+        // 不存在的版本不缓存，避免任意版本号占满缓存
+        return document;
+    }
+    g_logger<<"[INFO] "<<LANG("info_update_info_built")<<version<<std::endl;
+    updateInfoCache.Insert(version,generation,document);
+    return document;
+}
+
+bool WebServer::LoadVersionSnapshot(const std::string& version,const std::shared_ptr<PathTable>& paths,Snapshot& snapshot) const {
+    snapshot=Snapshot(paths);
+    std::string errors;
+    if(!SnapshotFile::LoadVersion(config.GetOutputDir()+"/snapshots",version,snapshot,&errors)) {
+        g_logger<<LANG("error_snapshot_invalid")<<errors<<std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool WebServer::BuildClientSnapshot(const Json::Value& json,HashAlgorithm algorithm,
+    const std::shared_ptr<PathTable>& paths,Snapshot& snapshot,std::string& error) {
+    if(!json.isObject()||!json["files"].isArray()) {
+        error="\"files\" array is required";
+        return false;
+    }
+    // 客户端的摘要必须与目标版本使用同一种算法，否则所有文件都会被当成修改
+    if(json.isMember("hash_algorithm")&&
+        HashProvider::ParseAlgorithm(json["hash_algorithm"].asString())!=algorithm) {
+        error="hash_algorithm must be "+std::string(HashProvider::AlgorithmName(algorithm));
+        return false;
+    }
+
+    snapshot=Snapshot(paths);
+    snapshot.SetHashAlgorithm(algorithm);
+    std::unordered_set<PathId> seen;
+    for(const auto& fileJson:json["files"]) {
+        std::string path=fileJson["path"].asString();
+        Digest hash=Digest::FromHex(fileJson["hash"].asString(),algorithm);
+        if(path.empty()||hash.Empty()) {
+            error="invalid file entry: "+path;
+            return false;
+        }
+        PathId id=paths->Intern(path);
+        if(!seen.insert(id).second) {
+            continue;
+        }
+        FileInfo& file=snapshot.GetMutableFile(snapshot.AddFile(id));
+        file.hash=hash;
+        file.size=fileJson.get("size",0).asUInt64();
+    }
+    for(const auto& dirJson:json["directories"]) {
+        std::string path=dirJson.asString();
+        if(!path.empty()) {
+            snapshot.AddDirectory(paths->Intern(path));
+        }
+    }
+    snapshot.Finalize();
+    return true;
+}
+
+Json::Value WebServer::DeltaToJson(const std::string& fromVersion,const std::string& toVersion,
+    HashAlgorithm algorithm,const std::vector<ChangeRecord>& changes) const {
+    Json::Value delta;
+    if(!fromVersion.empty()) {
+        delta["from_version"]=fromVersion;
+    }
+    delta["to_version"]=toVersion;
+    delta["hash_algorithm"]=algorithm!=HashAlgorithm::Unknown?
+        HashProvider::AlgorithmName(algorithm):"sha256";
+
+    Json::Value changesArray(Json::arrayValue);
+    uint64_t downloadSize=0;
+    for(const auto& change:changes) {
+        Json::Value changeJson=change.ToJson();
+        if(change.type==ChangeType::ADDED||change.type==ChangeType::MODIFIED||change.type==ChangeType::MOVED) {
+            // 固定版本的地址，下载到的一定是目标版本的内容
+            changeJson["url"]=config.GetBaseUrl()+"/files/"+UrlEncode(change.path)+"?version="+UrlEncode(toVersion);
+            downloadSize+=change.size;
+        }
+        changesArray.append(changeJson);
+    }
+    delta["changes"]=changesArray;
+    delta["download_size"]=static_cast<Json::UInt64>(downloadSize);
+    return delta;
+}
+
+std::string WebServer::ResolveFilePath(const std::string& relativePath,const std::string& version,Digest* digest) const {
+    std::string targetVersion=version;
+    bool latest=targetVersion.empty()||targetVersion=="latest";
+    if(latest) {
+        auto versions=versionManager.GetVersionList();
+        targetVersion=versions.empty()?std::string():versions.back();
+    }
+    else if(!versionManager.GetVersion(targetVersion)) {
+        // 版本号来自请求，只接受已登记的版本，不能拼进快照路径
+        return std::string();
+    }
+    if(!targetVersion.empty()) {
+        SnapshotFile snapshot;
+        if(snapshot.OpenVersion(config.GetOutputDir()+"/snapshots",targetVersion)) {
+            const SnapshotFileRecord* file=snapshot.FindFile(relativePath);
+            if(file) {
+                Digest fileDigest=SnapshotFile::GetDigest(*file);
+                if(objectStore.Contains(fileDigest)) {
+                    if(digest) {
+                        *digest=fileDigest;
+                    }
+                    return objectStore.GetObjectPath(fileDigest);
+                }
+            }
+        }
+    }
+    if(!latest) {
+        return std::string();
+    }
+    return workspace+"/"+relativePath;
+}
+
+crow::response WebServer::ServeFile(const crow::request& req,const std::string& path,const std::string& contentType,
+    const std::string& downloadName,const std::string& displayName,
+    const std::string& etag,bool immutable) const {
+    // 在这里打开文件并从同一个句柄取大小，不读内容：响应体由 crow 在发送时按 16KB 缓冲从该句柄流式读出，
+    // 每个连接的内存占用与文件大小无关。工作空间中的文件可能随时被改写，
+    // 先 stat 再由 crow 重新打开会让 Content-Length 与实际发送的内容对不上
+    std::error_code ec;
+    std::filesystem::path filePath=std::filesystem::u8path(path);
+    uint64_t fileSize=0;
+    std::filesystem::file_time_type modifiedTime;
+    auto stream=std::make_shared<std::ifstream>();
+    if(std::filesystem::is_regular_file(filePath,ec)) {
+        stream->open(filePath,std::ios::in|std::ios::binary);
+        if(stream->is_open()&&stream->seekg(0,std::ios::end)) {
+            fileSize=static_cast<uint64_t>(static_cast<std::streamoff>(stream->tellg()));
+            stream->seekg(0,std::ios::beg);
+            modifiedTime=std::filesystem::last_write_time(filePath,ec);
+        }
+        else {
+            ec=std::make_error_code(std::errc::io_error);
+        }
+    }
+    else if(!ec) {
+        ec=std::make_error_code(std::errc::no_such_file_or_directory);
+    }
+    if(ec) {
+        g_logger<<"[ERROR] Failed to open file: "<<path<<std::endl;
+        crow::response res(404);
+        res.write(LANG("info_file_not_found_simple")+": "+displayName);
+        return res;
+    }
+
+    // 缓存和断点续传的校验器：没有内容摘要时用大小和修改时间，
+    // 文件被替换后 ETag 随之变化，If-None-Match / If-Range 不再匹配
+    std::string validator=etag;
+    if(validator.empty()) {
+        std::ostringstream ss;
+        ss<<'"'<<std::hex<<fileSize<<'-'<<static_cast<uint64_t>(modifiedTime.time_since_epoch().count())<<'"';
+        validator=ss.str();
+    }
+    std::string cacheControl=immutable?"public, max-age=31536000, immutable":"no-cache";
+    auto systemTime=std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+        modifiedTime-std::filesystem::file_time_type::clock::now()+
+        std::chrono::system_clock::now());
+    std::string lastModified=FormatHttpDate(std::chrono::system_clock::to_time_t(systemTime));
+    if(IsNotModified(req,validator,lastModified)) {
+        return NotModified(validator,lastModified,cacheControl);
+    }
+
+    uint64_t offset=0;
+    uint64_t length=fileSize;
+    RangeRequest range=RangeRequest::None;
+    std::string rangeHeader=req.get_header_value("Range");
+    if(!rangeHeader.empty()) {
+        // If-Range 只做强比较：ETag 或 Last-Modified 完全一致才按区间返回，否则返回完整内容
+        std::string ifRange=req.get_header_value("If-Range");
+        if(ifRange.empty()||ifRange==validator||ifRange==lastModified) {
+            range=ParseRangeHeader(rangeHeader,fileSize,offset,length);
+        }
+    }
+    if(range==RangeRequest::Multiple||range==RangeRequest::Unsatisfiable) {
+        crow::response res(416);
+        res.set_header("Content-Range","bytes */"+std::to_string(fileSize));
+        res.set_header("Accept-Ranges","bytes");
+        return res;
+    }
+
+    crow::response res;
+    if(length>0) {
+        res.set_static_file_range(path,stream,offset,length,contentType);
+    }
+    else {
+        // 空文件：crow 把长度 0 当作"读到文件末尾"，这里直接给出空的响应体
+        res.set_header("Content-Type",contentType);
+    }
+    if(range==RangeRequest::Single) {
+        res.code=206;
+        res.set_header("Content-Range","bytes "+std::to_string(offset)+"-"+
+            std::to_string(offset+length-1)+"/"+std::to_string(fileSize));
+    }
+    res.set_header("Accept-Ranges","bytes");
+    res.set_header("ETag",validator);
+    res.set_header("Last-Modified",lastModified);
+    res.set_header("Cache-Control",cacheControl);
+    if(!downloadName.empty()) {
+        // 文件名来自请求路径：去掉控制字符、引号和反斜杠，避免拆分或截断响应头
+        std::string safeName;
+        for(unsigned char c:downloadName) {
+            if(c>=0x20&&c!=0x7f&&c!='"'&&c!='\\') safeName.push_back(static_cast<char>(c));
+        }
+        res.set_header("Content-Disposition","attachment; filename=\""+safeName+"\"");
+    }
+    return res;
+}
+
+ContentEncoding WebServer::SelectEncoding(const std::string& acceptEncoding,const Digest& digest) const {
+    if(acceptEncoding.empty()) {
+        return ContentEncoding::Identity;
+    }
+    // q 值相同时按服务器的优先顺序（压缩率高的在前）
+    ContentEncoding selected=ContentEncoding::Identity;
+    double selectedQuality=0;
+    for(ContentEncoding encoding:Precompressor::kEncodings) {
+        double quality=AcceptEncodingQuality(acceptEncoding,Precompressor::EncodingName(encoding));
+        if(quality>selectedQuality&&objectStore.HasVariant(digest,Precompressor::FileSuffix(encoding))) {
+            selected=encoding;
+            selectedQuality=quality;
+        }
+    }
+    return selected;
+}
+
 bool WebServer::FileExists(const std::string& filepath) const {
     return std::filesystem::exists(filepath);
 }
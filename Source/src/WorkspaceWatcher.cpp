@@ -0,0 +1,350 @@
+﻿#include "WorkspaceWatcher.h"
+#include "Language.h"
+#include "Logger.h"
+#include <filesystem>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+static std::wstring Utf8ToWide(const std::string& utf8) {
+    if(utf8.empty()) return L"";
+    int wlen=MultiByteToWideChar(CP_UTF8,0,utf8.c_str(),-1,nullptr,0);
+    if(wlen<=0) return L"";
+    std::wstring wstr(wlen-1,0);
+    MultiByteToWideChar(CP_UTF8,0,utf8.c_str(),-1,&wstr[0],wlen);
+    return wstr;
+}
+
+static std::string WideToUtf8(const wchar_t* wide,int length) {
+    if(length<=0) return "";
+    int len=WideCharToMultiByte(CP_UTF8,0,wide,length,nullptr,0,nullptr,nullptr);
+    if(len<=0) return "";
+    std::string str(len,0);
+    WideCharToMultiByte(CP_UTF8,0,wide,length,&str[0],len,nullptr,nullptr);
+    return str;
+}
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+WorkspaceWatcher::WorkspaceWatcher(const std::string& workspace)
+    : workspace(workspace) {
+}
+
+WorkspaceWatcher::~WorkspaceWatcher() {
+    Stop();
+}
+
+void WorkspaceWatcher::MarkDirty(const std::string& relativePath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    dirtyPaths.insert(relativePath);
+}
+
+void WorkspaceWatcher::MarkOverflow() {
+    std::lock_guard<std::mutex> lock(mutex);
+    overflowed=true;
+    dirtyPaths.clear();
+}
+
+void WorkspaceWatcher::MarkFailed() {
+    g_logger<<"[WARNING] "<<LANG("warning_watch_unavailable")<<workspace<<std::endl;
+    MarkOverflow();
+    failed=true;
+}
+
+bool WorkspaceWatcher::TakeDirtyPaths(std::vector<std::string>& paths) {
+    std::lock_guard<std::mutex> lock(mutex);
+    paths.assign(dirtyPaths.begin(),dirtyPaths.end());
+    dirtyPaths.clear();
+    bool complete=!overflowed;
+    overflowed=false;
+    // 排序后父目录总在其子路径之前，便于调用方去掉被覆盖的子路径
+    std::sort(paths.begin(),paths.end());
+    return complete;
+}
+
+size_t WorkspaceWatcher::GetPendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return dirtyPaths.size();
+}
+
+bool WorkspaceWatcher::IsOverflowed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return overflowed;
+}
+
+#ifdef _WIN32
+
+bool WorkspaceWatcher::Start() {
+    if(running&&!failed) {
+        return true;
+    }
+    // 上一个监视线程已因错误退出，先回收再重新启动
+    Stop();
+
+    HANDLE handle=CreateFileW(Utf8ToWide(workspace).c_str(),FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,nullptr,OPEN_EXISTING,
+        FILE_FLAG_BACKUP_SEMANTICS|FILE_FLAG_OVERLAPPED,nullptr);
+    if(handle==INVALID_HANDLE_VALUE) {
+        g_logger<<"[WARNING] "<<LANG("warning_watch_unavailable")<<workspace<<std::endl;
+        return false;
+    }
+
+    directoryHandle=handle;
+    stopEvent=CreateEventW(nullptr,TRUE,FALSE,nullptr);
+    stopping=false;
+    failed=false;
+    running=true;
+    worker=std::thread(&WorkspaceWatcher::WatchLoop,this);
+    g_logger<<"[INFO] "<<LANG("info_watch_started")<<workspace<<std::endl;
+    return true;
+}
+
+void WorkspaceWatcher::Stop() {
+    if(!running) {
+        return;
+    }
+    stopping=true;
+    SetEvent(static_cast<HANDLE>(stopEvent));
+    if(worker.joinable()) {
+        worker.join();
+    }
+    CloseHandle(static_cast<HANDLE>(directoryHandle));
+    CloseHandle(static_cast<HANDLE>(stopEvent));
+    directoryHandle=nullptr;
+    stopEvent=nullptr;
+    running=false;
+}
+
+// ReadDirectoryChangesW 可以直接监视整棵子树，缓冲区溢出时返回 0 字节
+void WorkspaceWatcher::WatchLoop() {
+    HANDLE handle=static_cast<HANDLE>(directoryHandle);
+    std::vector<DWORD> buffer(16*1024);  // 64KB，ReadDirectoryChangesW 要求 DWORD 对齐
+    OVERLAPPED overlapped={};
+    overlapped.hEvent=CreateEventW(nullptr,TRUE,FALSE,nullptr);
+    const DWORD filter=FILE_NOTIFY_CHANGE_FILE_NAME|FILE_NOTIFY_CHANGE_DIR_NAME|
+        FILE_NOTIFY_CHANGE_SIZE|FILE_NOTIFY_CHANGE_LAST_WRITE;
+
+    while(!stopping) {
+        ResetEvent(overlapped.hEvent);
+        if(!ReadDirectoryChangesW(handle,buffer.data(),static_cast<DWORD>(buffer.size()*sizeof(DWORD)),TRUE,filter,nullptr,&overlapped,nullptr)) {
+            MarkFailed();
+            break;
+        }
+
+        HANDLE events[2]={overlapped.hEvent,static_cast<HANDLE>(stopEvent)};
+        DWORD wait=WaitForMultipleObjects(2,events,FALSE,INFINITE);
+        if(wait!=WAIT_OBJECT_0) {
+            CancelIoEx(handle,&overlapped);
+            WaitForSingleObject(overlapped.hEvent,INFINITE);
+            break;
+        }
+
+        DWORD bytes=0;
+        if(!GetOverlappedResult(handle,&overlapped,&bytes,FALSE)||bytes==0) {
+            // ERROR_NOTIFY_ENUM_DIR 或缓冲区不足，事件已丢失
+            MarkOverflow();
+            continue;
+        }
+
+        const unsigned char* current=reinterpret_cast<const unsigned char*>(buffer.data());
+        while(true) {
+            const FILE_NOTIFY_INFORMATION* info=reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(current);
+            std::string relativePath=WideToUtf8(info->FileName,static_cast<int>(info->FileNameLength/sizeof(WCHAR)));
+            std::replace(relativePath.begin(),relativePath.end(),'\\','/');
+            if(!relativePath.empty()) {
+                MarkDirty(relativePath);
+            }
+            if(info->NextEntryOffset==0) {
+                break;
+            }
+            current+=info->NextEntryOffset;
+        }
+    }
+
+    CloseHandle(overlapped.hEvent);
+}
+
+#else
+
+bool WorkspaceWatcher::Start() {
+    if(running&&!failed) {
+        return true;
+    }
+    // 上一个监视线程已因错误退出，先回收再重新启动
+    Stop();
+
+    inotifyFd=inotify_init1(IN_NONBLOCK|IN_CLOEXEC);
+    if(inotifyFd<0) {
+        g_logger<<"[WARNING] "<<LANG("warning_watch_unavailable")<<workspace<<" - "<<std::strerror(errno)<<std::endl;
+        return false;
+    }
+    if(pipe(stopPipe)!=0) {
+        close(inotifyFd);
+        inotifyFd=-1;
+        g_logger<<"[WARNING] "<<LANG("warning_watch_unavailable")<<workspace<<" - "<<std::strerror(errno)<<std::endl;
+        return false;
+    }
+
+    // 重新启动前丢失的事件要保留溢出标记，但不能当作本次添加监视失败
+    bool eventsLost=false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        eventsLost=overflowed;
+        overflowed=false;
+    }
+    AddWatchRecursive("");
+    {
+        // 启动阶段添加监视失败（如超过 max_user_watches）时不可靠，直接放弃
+        std::lock_guard<std::mutex> lock(mutex);
+        if(overflowed) {
+            overflowed=false;
+            close(inotifyFd);
+            close(stopPipe[0]);
+            close(stopPipe[1]);
+            inotifyFd=-1;
+            stopPipe[0]=stopPipe[1]=-1;
+            watchPaths.clear();
+            return false;
+        }
+    }
+    if(eventsLost) {
+        MarkOverflow();
+    }
+
+    stopping=false;
+    failed=false;
+    running=true;
+    worker=std::thread(&WorkspaceWatcher::WatchLoop,this);
+    g_logger<<"[INFO] "<<LANG("info_watch_started")<<workspace<<std::endl;
+    return true;
+}
+
+void WorkspaceWatcher::Stop() {
+    if(!running) {
+        return;
+    }
+    stopping=true;
+    char signal=1;
+    (void)write(stopPipe[1],&signal,1);
+    if(worker.joinable()) {
+        worker.join();
+    }
+    close(inotifyFd);
+    close(stopPipe[0]);
+    close(stopPipe[1]);
+    inotifyFd=-1;
+    stopPipe[0]=stopPipe[1]=-1;
+    watchPaths.clear();
+    running=false;
+}
+
+void WorkspaceWatcher::AddWatchRecursive(const std::string& relativePath) {
+    std::string fullPath=relativePath.empty()?workspace:workspace+"/"+relativePath;
+    const uint32_t mask=IN_CREATE|IN_DELETE|IN_MODIFY|IN_CLOSE_WRITE|IN_ATTRIB|
+        IN_MOVED_FROM|IN_MOVED_TO|IN_DELETE_SELF|IN_ONLYDIR;
+
+    int wd=inotify_add_watch(inotifyFd,fullPath.c_str(),mask);
+    if(wd<0) {
+        // 目录在添加前已被删除属于正常竞争，其他错误（ENOSPC 等）意味着会漏掉事件
+        if(errno!=ENOENT&&errno!=ENOTDIR) {
+            g_logger<<"[WARNING] "<<LANG("warning_watch_overflow")<<fullPath<<" - "<<std::strerror(errno)<<std::endl;
+            MarkOverflow();
+        }
+        return;
+    }
+    watchPaths[wd]=relativePath;
+
+    std::error_code ec;
+    for(const auto& entry:std::filesystem::directory_iterator(fullPath,ec)) {
+        if(entry.is_directory(ec)&&!entry.is_symlink(ec)) {
+            std::string name=entry.path().filename().string();
+            AddWatchRecursive(relativePath.empty()?name:relativePath+"/"+name);
+        }
+    }
+}
+
+void WorkspaceWatcher::RemoveWatchRecursive(const std::string& relativePath) {
+    std::string prefix=relativePath+"/";
+    for(auto it=watchPaths.begin(); it!=watchPaths.end();) {
+        if(it->second==relativePath||it->second.compare(0,prefix.size(),prefix)==0) {
+            inotify_rm_watch(inotifyFd,it->first);
+            it=watchPaths.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void WorkspaceWatcher::WatchLoop() {
+    alignas(struct inotify_event) char buffer[64*1024];
+
+    while(!stopping) {
+        pollfd fds[2]={{inotifyFd,POLLIN,0},{stopPipe[0],POLLIN,0}};
+        if(poll(fds,2,-1)<0) {
+            if(errno==EINTR) continue;
+            MarkFailed();
+            break;
+        }
+        if(fds[1].revents&POLLIN) {
+            break;
+        }
+
+        while(true) {
+            ssize_t length=read(inotifyFd,buffer,sizeof(buffer));
+            if(length<=0) {
+                break;
+            }
+
+            for(char* current=buffer; current<buffer+length;) {
+                const inotify_event* event=reinterpret_cast<const inotify_event*>(current);
+                current+=sizeof(inotify_event)+event->len;
+
+                if(event->mask&IN_Q_OVERFLOW) {
+                    g_logger<<"[WARNING] "<<LANG("warning_watch_overflow")<<workspace<<std::endl;
+                    MarkOverflow();
+                    continue;
+                }
+                if(event->mask&IN_IGNORED) {
+                    watchPaths.erase(event->wd);
+                    continue;
+                }
+
+                auto it=watchPaths.find(event->wd);
+                if(it==watchPaths.end()) {
+                    continue;
+                }
+                const std::string& dirPath=it->second;
+                if(event->len==0) {
+                    // 被监视的目录自身被删除，交给父目录的 IN_DELETE 事件处理
+                    if(!dirPath.empty()) {
+                        MarkDirty(dirPath);
+                    }
+                    continue;
+                }
+
+                std::string relativePath=dirPath.empty()?
+                    std::string(event->name):
+                    dirPath+"/"+event->name;
+                MarkDirty(relativePath);
+
+                // 新建或移入的目录需要补充监视，其内容由整棵子树的重扫覆盖
+                if((event->mask&IN_ISDIR)&&(event->mask&(IN_CREATE|IN_MOVED_TO))) {
+                    AddWatchRecursive(relativePath);
+                }
+                // 移出的目录的监视仍然有效但路径已过时，移除整棵子树的监视
+                else if((event->mask&IN_ISDIR)&&(event->mask&IN_MOVED_FROM)) {
+                    RemoveWatchRecursive(relativePath);
+                }
+            }
+        }
+    }
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include <string>
 #include <filesystem>
 #include <vector>
+#include <sstream>
 #include <algorithm>
 #include <cstdlib>
 #include "Config.h"
@@ -10,6 +11,8 @@
 #include "WebServer.h"
 #include "Language.h"
 #include "VersionManager.h"
+#include "Benchmark.h"
+#include "SnapshotFile.h"
 #include <windows.h>
 #include <locale>
 #include <codecvt>
@@ -63,6 +66,11 @@ void PrintHelp() {
     g_logger<<"  incremental <from> <to>  创建增量更新包"<<std::endl;
     g_logger<<"  full <ver>        创建全量更新包"<<std::endl;
     g_logger<<"  init              初始化配置文件"<<std::endl;
+    g_logger<<"  daemon            常驻监视工作空间，按指令增量生成版本"<<std::endl;
+    g_logger<<"  snapshot export --json <ver> [file]  导出二进制快照为JSON（默认写到快照目录）"<<std::endl;
+    g_logger<<"  bench hash        哈希读取策略基准测试"<<std::endl;
+    g_logger<<"  bench moves       移动检测基准测试（5 万个文件同时重命名）"<<std::endl;
+    g_logger<<"  bench patch       差分补丁生成与回放校验"<<std::endl;
     g_logger<<"  help              显示帮助"<<std::endl;
     g_logger<<std::endl;
     g_logger<<"选项:"<<std::endl;
@@ -70,6 +78,7 @@ void PrintHelp() {
     g_logger<<"  --output <path>   指定输出目录"<<std::endl;
     g_logger<<"  --host <host>     指定服务器主机 (默认: 127.0.0.1)"<<std::endl;
     g_logger<<"  --port <port>     指定服务器端口 (默认: 8080)"<<std::endl;
+    g_logger<<"  --rehash          忽略哈希缓存，重新计算所有文件哈希"<<std::endl;
     g_logger<<std::endl;
     g_logger<<LANG("info_put_game_files")<<std::endl;
 }
@@ -200,6 +209,7 @@ int InteractiveMenu(Config& config) {
                 if(config.CreateDirectories()) {
                     g_logger<<"[INFO] "<<LANG("info_directories_created")<<std::endl;
                     g_logger<<"[INFO] "<<LANG("info_put_game_files")<<std::endl;
+                    g_logger<<"[INFO] "<<LANG("info_delta_patches_note")<<std::endl;
                 }
 
                 g_logger<<LANG("info_enter_continue")<<std::endl;
@@ -230,18 +240,25 @@ int InteractiveMenu(Config& config) {
                 std::string fullDir=config.GetOutputDir()+"/full";
                 std::string incrementalDir=config.GetOutputDir()+"/incremental";
                 std::string packagesDir=config.GetOutputDir()+"/packages"; // 新增
+                // 对象库和分块只被已删除的版本引用，一并清空，否则会永远留在磁盘上
+                std::string objectsDir=config.GetOutputDir()+"/objects";
+                std::string chunksDir=config.GetOutputDir()+"/chunks";
 
                 std::filesystem::remove_all(dataDir);
                 std::filesystem::remove_all(snapshotsDir);
                 std::filesystem::remove_all(fullDir);
                 std::filesystem::remove_all(incrementalDir);
                 std::filesystem::remove_all(packagesDir); // 删除目录包
+                std::filesystem::remove_all(objectsDir);
+                std::filesystem::remove_all(chunksDir);
 
                 std::filesystem::create_directories(dataDir);
                 std::filesystem::create_directories(snapshotsDir);
                 std::filesystem::create_directories(fullDir);
                 std::filesystem::create_directories(incrementalDir);
                 std::filesystem::create_directories(packagesDir); // 重新创建
+                std::filesystem::create_directories(objectsDir);
+                std::filesystem::create_directories(chunksDir);
 
                 g_logger<<"[INFO] 版本系统已重置"<<std::endl;
             }
@@ -319,16 +336,17 @@ int InteractiveMenu(Config& config) {
                 g_logger<<"[ERROR] 无法初始化生成器"<<std::endl;
                 break;
             }
-            std::vector<FileInfo> targetFiles;
-            std::vector<DirectoryInfo> targetDirs;
-            if(!generator.GetPreviousVersionFiles(targetVersion,targetFiles,targetDirs)) {
+            Snapshot targetSnapshot;
+            if(!generator.GetPreviousVersionFiles(targetVersion,targetSnapshot)) {
                 g_logger<<"[ERROR] 无法加载目标版本的快照"<<std::endl;
                 break;
             }
-            if(!generator.CreateDirectoryPackages(targetVersion,targetDirs)) {
+            if(!generator.CreateDirectoryPackages(targetVersion,targetSnapshot)) {
                 g_logger<<"[ERROR] 重新生成目录包失败"<<std::endl;
                 break;
             }
+            // 被删除版本独有的内容不再需要
+            generator.CollectUnreferencedObjects();
 
             g_logger<<"[INFO] 已成功回退到版本 "<<targetVersion<<"，后续版本已删除"<<std::endl;
             break;
@@ -468,6 +486,7 @@ int ExecuteCommand(const std::string& command,const std::vector<std::string>& co
             std::cin.get();
             return 1;
         }
+        generator.RefreshVersionGraph();
 
         g_logger<<"[INFO] "<<LANG("info_incremental")<<fromVersion<<" -> "<<toVersion<<LANG("info_created_complete")<<std::endl;
         g_logger<<LANG("info_enter_exit")<<std::endl;
@@ -505,6 +524,7 @@ int ExecuteCommand(const std::string& command,const std::vector<std::string>& co
             std::cin.get();
             return 1;
         }
+        generator.RefreshVersionGraph();
 
         g_logger<<"[INFO] "<<LANG("info_full")<<version<<LANG("info_created_complete")<<std::endl;
         g_logger<<LANG("info_enter_exit")<<std::endl;
@@ -520,6 +540,7 @@ int ExecuteCommand(const std::string& command,const std::vector<std::string>& co
             if(config.CreateDirectories()) {
                 g_logger<<"[INFO] "<<LANG("info_directories_created")<<std::endl;
                 g_logger<<"[INFO] "<<LANG("info_put_game_files")<<std::endl;
+                g_logger<<"[INFO] "<<LANG("info_delta_patches_note")<<std::endl;
             }
 
             g_logger<<LANG("info_enter_exit")<<std::endl;
@@ -533,6 +554,107 @@ int ExecuteCommand(const std::string& command,const std::vector<std::string>& co
             return 1;
         }
     }
+    else if(command=="daemon") {
+        // 常驻生成器：持续监视工作空间，生成版本时只重扫变更过的路径
+        UpdateGenerator generator(config);
+        if(!generator.Initialize()) {
+            g_logger<<LANG("info_enter_exit")<<std::endl;
+            std::cin.get();
+            return 1;
+        }
+        generator.EnableWatch();
+        if(!generator.ScanWorkspace()) {
+            return 1;
+        }
+        g_logger<<"[INFO] "<<LANG("info_daemon_ready")<<std::endl;
+
+        std::string line;
+        while(std::getline(std::cin,line)) {
+            std::istringstream input(line);
+            std::string action;
+            input>>action;
+            if(action.empty()) {
+                continue;
+            }
+            if(action=="exit"||action=="quit") {
+                break;
+            }
+            else if(action=="status") {
+                g_logger<<"[INFO] "<<LANG("info_daemon_pending")<<generator.GetPendingChanges()<<std::endl;
+            }
+            else if(action=="version") {
+                std::string version;
+                std::string description;
+                input>>version;
+                std::getline(input>>std::ws,description);
+                if(generator.GenerateVersion(version,description)) {
+                    g_logger<<"[INFO] "<<LANG("info_version")<<version<<LANG("info_created_complete")<<std::endl;
+                }
+            }
+            else {
+                g_logger<<"[ERROR] "<<LANG("info_daemon_unknown")<<action<<std::endl;
+            }
+        }
+        return 0;
+    }
+    else if(command=="snapshot") {
+        // 快照调试工具：snapshot export --json <ver> [file]
+        std::vector<std::string> args;
+        bool json=false;
+        for(const auto& arg:commandArgs) {
+            if(arg=="--json") {
+                json=true;
+            }
+            else {
+                args.push_back(arg);
+            }
+        }
+        if(args.size()<2||args[0]!="export"||!json) {
+            PrintHelp();
+            return 1;
+        }
+
+        std::string version=args[1];
+        std::string snapshotsDir=config.GetOutputDir()+"/snapshots";
+        std::string outputFile=args.size()>2?args[2]:snapshotsDir+"/"+version+".json";
+
+        SnapshotFile snapshotFile;
+        std::string errors;
+        Snapshot snapshot;
+        if(!snapshotFile.OpenVersion(snapshotsDir,version,&errors)||
+            !snapshotFile.VerifyPayload()||
+            !snapshotFile.LoadInto(snapshot,&errors)) {
+            g_logger<<"[ERROR] "<<LANG("error_snapshot_invalid")<<version<<" "<<errors<<std::endl;
+            return 1;
+        }
+        if(!SnapshotWriter::WriteFile(outputFile,snapshot,snapshotFile.GetMeta())) {
+            g_logger<<"[ERROR] "<<LANG("error_create_file")<<outputFile<<std::endl;
+            return 1;
+        }
+        g_logger<<"[INFO] "<<LANG("info_snapshot_exported")<<outputFile<<std::endl;
+        return 0;
+    }
+    else if(command=="bench") {
+        // 性能基准测试
+        std::string target=commandArgs.empty()?"hash":commandArgs[0];
+        bool ok=false;
+        if(target=="hash") {
+            ok=Benchmark::RunHashBenchmark(config.GetOutputDir()+"/cache/bench",config.GetHashAlgorithm());
+        }
+        else if(target=="moves") {
+            ok=Benchmark::RunMoveBenchmark(50000);
+        }
+        else if(target=="patch") {
+            ok=Benchmark::RunPatchBenchmark(config.GetHashAlgorithm());
+        }
+        else {
+            PrintHelp();
+        }
+
+        g_logger<<LANG("info_enter_exit")<<std::endl;
+        std::cin.get();
+        return ok?0:1;
+    }
     else if(command=="help"||command=="--help"||command=="-h") {
         PrintHelp();
         g_logger<<LANG("info_enter_exit")<<std::endl;
@@ -554,6 +676,7 @@ int main(int argc,char* argv[]) {
     std::string hostOverride;
     std::string portStr;
     int portOverride=0;
+    bool rehash=false;
 
     std::vector<std::string> commandArgs;
 
@@ -591,6 +714,13 @@ int main(int argc,char* argv[]) {
                 i++;
             }
         }
+        else if(arg=="--rehash") {
+            rehash=true;
+        }
+        else if(arg=="--json") {
+            // 子命令的格式参数，原样交给命令处理
+            commandArgs.push_back(arg);
+        }
         else if(arg=="help"||arg=="--help"||arg=="-h") {
             PrintHelp();
             g_logger<<LANG("info_enter_exit")<<std::endl;
@@ -636,6 +766,7 @@ int main(int argc,char* argv[]) {
 
         g_logger<<"[INFO] "<<LANG("info_default_config_created")<<std::endl;
         g_logger<<"[INFO] "<<LANG("info_put_game_files")<<std::endl;
+        g_logger<<"[INFO] "<<LANG("info_delta_patches_note")<<std::endl;
         g_logger<<"[INFO] "<<LANG("info_run_server")<<std::endl;
         g_logger<<"[INFO] "<<LANG("info_enter_exit")<<std::endl;
         std::cin.get();
@@ -660,6 +791,7 @@ int main(int argc,char* argv[]) {
     if(portOverride>0) {
         config.SetServerPort(portOverride);
     }
+    config.SetForceRehash(rehash);
 
     // 确保必要目录存在（包括public目录）
     if(!config.CreateDirectories()) {